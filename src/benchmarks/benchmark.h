@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Result {
+    std::string name;
+    size_t iterations;
+    size_t ops_per_iteration;
+    double best_ns;     // Лучшее время одной итерации
+    double median_ns;   // Медианное время одной итерации
+    std::optional<double> counter_per_op;   // Дополнительный счетчик в пересчете на операцию, например просмотренные вершины
+};
+
+/**
+ * Запускает `func` `iterations` раз и возвращает лучшее и медианное время одной итерации.
+ * `ops_per_iteration` - количество операций (запросов) за итерацию, используется для пересчета времени на операцию
+ */
+template <typename Func>
+Result Measure(std::string name, size_t iterations, size_t ops_per_iteration, Func&& func) {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    for (size_t i = 0; i < iterations; ++i) {
+        const auto start = Clock::now();
+        func();
+        const auto finish = Clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(finish - start).count());
+    }
+
+    std::sort(samples.begin(), samples.end());
+    return {
+        .name = std::move(name),
+        .iterations = iterations,
+        .ops_per_iteration = std::max<size_t>(1, ops_per_iteration),
+        .best_ns = samples.front(),
+        .median_ns = samples[samples.size() / 2],
+        .counter_per_op = std::nullopt
+    };
+}
+
+inline void PrintHeader(std::ostream& out) {
+    out << std::left << std::setw(48) << "Benchmark"
+        << std::right << std::setw(16) << "Median/op, us"
+        << std::setw(16) << "Best/op, us"
+        << std::setw(12) << "Iterations"
+        << std::setw(14) << "Counter/op" << '\n'
+        << std::string(106, '-') << '\n';
+}
+
+inline void PrintResult(std::ostream& out, const Result& result) {
+    const double ops = static_cast<double>(result.ops_per_iteration);
+    out << std::left << std::setw(48) << result.name
+        << std::right << std::fixed << std::setprecision(3)
+        << std::setw(16) << result.median_ns / ops / 1000.0
+        << std::setw(16) << result.best_ns / ops / 1000.0
+        << std::setw(12) << result.iterations
+        << std::setw(14);
+    if (result.counter_per_op) {
+        out << std::setprecision(1) << *result.counter_per_op;
+    } else {
+        out << '-';
+    }
+    out << '\n';
+    out.unsetf(std::ios_base::floatfield);
+}
+
+// Поток, отбрасывающий весь вывод, чтобы в замер не попадала запись результата
+class NullBuffer final : public std::streambuf {
+protected:
+    int_type overflow(int_type ch) override {
+        return ch;
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        return count;
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,933 @@
+#include "checks.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "binary_protocol.h"
+#include "binary_reader.h"
+#include "city_generator.h"
+#include "compression.h"
+#include "connection_scan.h"
+#include "json.h"
+#include "json_reader.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+using namespace std;
+using domain::dto::RouteResponse;
+using domain::dto::RoutingStrategy;
+using requests::StatRequestType;
+
+namespace bench {
+
+namespace {
+
+constexpr double kTimeEpsilon = 1e-6;
+
+string ToString(const json::Document& doc) {
+    ostringstream out;
+    json::Print(doc, out);
+    return out.str();
+}
+
+// Результат одной проверки. Выводятся только первые kMaxReported расхождений, остальные лишь считаются
+class Check {
+public:
+    Check(ostream& out, string name) : out_(out), name_(move(name)) {}
+
+    void Expect(bool condition, const string& message) {
+        ++assertions_;
+        if (condition) {
+            return;
+        }
+        if (failures_ < kMaxReported) {
+            out_ << "  "s << name_ << ": "s << message << '\n';
+        }
+        ++failures_;
+    }
+
+    // Выводит итог и возвращает true, если расхождений нет
+    bool Finish() {
+        out_ << (failures_ == 0 ? "ok      "s : "FAILED  "s) << name_ << " ("s << assertions_ << " assertions, "s
+             << failures_ << " failures)"s << endl;
+        return failures_ == 0;
+    }
+
+private:
+    static constexpr size_t kMaxReported = 10;
+
+    ostream& out_;
+    string name_;
+    size_t assertions_ = 0;
+    size_t failures_ = 0;
+};
+
+bool SameTime(optional<double> lhs, optional<double> rhs) {
+    if (lhs.has_value() != rhs.has_value()) {
+        return false;
+    }
+    return !lhs || abs(*lhs - *rhs) <= kTimeEpsilon * max(1.0, abs(*lhs));
+}
+
+optional<double> TotalTime(const optional<RouteResponse>& route) {
+    return route ? optional(route->total_time) : nullopt;
+}
+
+double SumItemTimes(const RouteResponse& route) {
+    double result = 0.0;
+    for (const auto& item : route.items) {
+        result += visit([](const auto& value) { return value.time; }, item);
+    }
+    return result;
+}
+
+string PairName(string_view from, string_view to) {
+    return "\""s + string(from) + "\" -> \""s + string(to) + "\""s;
+}
+
+vector<pair<string, string>> RandomStopPairs(const City& city, size_t count, uint64_t seed) {
+    mt19937_64 rng(seed);
+    uniform_int_distribution<size_t> stop_dist(0, city.stops.size() - 1);
+    vector<pair<string, string>> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const string& from = city.stops[stop_dist(rng)].name;
+        // Каждая десятая пара - маршрут из остановки в нее же
+        result.emplace_back(from, i % 10 == 0 ? from : city.stops[stop_dist(rng)].name);
+    }
+    return result;
+}
+
+// ---------- Стратегии роутера ------------------
+
+struct StrategyCase {
+    string name;
+    RoutingStrategy value;
+};
+
+/**
+ * Все стратегии, ответы из одной остановки во многие цели и Matrix сравниваются с поиском Дейкстры без предобработки.
+ * Время маршрута должно совпадать с суммой времени его шагов
+ */
+void CheckRouterStrategies(Check& check, const City& city) {
+    TransportCatalogue db;
+    FillCatalogue(city, db);
+    const TransportRouter reference(db, {.velocity = 40.0, .wait_time = 6, .strategy = RoutingStrategy::kDijkstra});
+
+    const auto pairs = RandomStopPairs(city, 300, 11);
+    vector<optional<RouteResponse>> expected;
+    expected.reserve(pairs.size());
+    for (const auto& [from, to] : pairs) {
+        expected.push_back(reference.GetRoute(from, to));
+        if (expected.back()) {
+            check.Expect(SameTime(expected.back()->total_time, SumItemTimes(*expected.back())),
+                         "total_time differs from the sum of item times for "s + PairName(from, to));
+        }
+    }
+
+    // Цели для GetRoutesFrom и Matrix - правые остановки первых пар, источники - левые
+    constexpr size_t kSide = 12;
+    vector<string_view> sources;
+    vector<string_view> targets;
+    for (size_t i = 0; i < kSide; ++i) {
+        sources.push_back(pairs[i].first);
+        targets.push_back(pairs[i].second);
+    }
+    vector<vector<optional<double>>> expected_matrix(kSide);
+    for (size_t i = 0; i < kSide; ++i) {
+        for (const auto target : targets) {
+            expected_matrix[i].push_back(TotalTime(reference.GetRoute(sources[i], target)));
+        }
+    }
+
+    const vector<StrategyCase> strategies = {
+        {"all_pairs", RoutingStrategy::kAllPairs},
+        {"contraction_hierarchy", RoutingStrategy::kContractionHierarchy},
+        {"dijkstra", RoutingStrategy::kDijkstra},
+        {"bidirectional_dijkstra", RoutingStrategy::kBidirectionalDijkstra},
+        {"a_star", RoutingStrategy::kAStar},
+    };
+    for (const auto& strategy : strategies) {
+        const TransportRouter router(db, {.velocity = 40.0, .wait_time = 6, .strategy = strategy.value});
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            const auto& [from, to] = pairs[i];
+            const auto route = router.GetRoute(from, to);
+            check.Expect(SameTime(TotalTime(route), TotalTime(expected[i])),
+                         strategy.name + " route differs from dijkstra for "s + PairName(from, to));
+            if (route) {
+                check.Expect(SameTime(route->total_time, SumItemTimes(*route)),
+                             strategy.name + " total_time differs from the sum of item times for "s + PairName(from, to));
+            }
+        }
+
+        for (size_t i = 0; i < kSide; ++i) {
+            const auto routes = router.GetRoutesFrom(sources[i], targets);
+            check.Expect(routes.has_value(), strategy.name + " found no routes from \""s + string(sources[i]) + "\""s);
+            for (size_t j = 0; routes && j < kSide; ++j) {
+                check.Expect(SameTime(TotalTime((*routes)[j]), expected_matrix[i][j]),
+                             strategy.name + " one-to-many route differs from dijkstra for "s
+                             + PairName(sources[i], targets[j]));
+            }
+        }
+
+        const auto times = router.GetTravelTimes(sources, targets);
+        check.Expect(times.has_value(), strategy.name + " matrix is empty"s);
+        for (size_t i = 0; times && i < kSide; ++i) {
+            for (size_t j = 0; j < kSide; ++j) {
+                check.Expect(SameTime((*times)[i][j], expected_matrix[i][j]),
+                             strategy.name + " matrix cell differs from dijkstra for "s + PairName(sources[i], targets[j]));
+            }
+        }
+    }
+}
+
+void CheckRouterStrategies(Check& check) {
+    const City small = GenerateCity({.stop_count = 100, .bus_count = 20, .min_route_stops = 3, .max_route_stops = 15});
+    CheckRouterStrategies(check, small);
+
+    City medium = GenerateCity({.stop_count = 300, .bus_count = 60, .min_route_stops = 5, .max_route_stops = 25,
+                                .seed = 7});
+    CheckRouterStrategies(check, medium);
+    AddRoutingOverrides(medium);
+    CheckRouterStrategies(check, medium);
+}
+
+// ---------- Connection Scan ------------------
+
+/**
+ * Случайное расписание: рейсы - случайные последовательности остановок со случайным временем перегонов.
+ * Эталон самого раннего прибытия - релаксация перегонов всех рейсов в порядке движения до неподвижной точки,
+ * без сортировки перегонов по времени. Найденный путь проверяется по перегонам рейсов
+ */
+void CheckConnectionScan(Check& check) {
+    constexpr size_t kStopCount = 60;
+    constexpr size_t kTripCount = 200;
+    constexpr size_t kQueryCount = 500;
+
+    mt19937_64 rng(13);
+    uniform_int_distribution<uint32_t> stop_dist(0, kStopCount - 1);
+    vector<vector<transit::Connection>> trips(kTripCount);
+    vector<transit::Connection> connections;
+    for (transit::TripId trip = 0; trip < kTripCount; ++trip) {
+        const size_t span_count = uniform_int_distribution<size_t>(1, 10)(rng);
+        // Целые минуты, чтобы у разных рейсов совпадали времена отправления и прибытия
+        double time = static_cast<double>(uniform_int_distribution<int>(0, 600)(rng));
+        transit::StopId stop = stop_dist(rng);
+        for (uint32_t position = 0; position < span_count; ++position) {
+            transit::StopId next = stop_dist(rng);
+            while (next == stop) {
+                next = stop_dist(rng);
+            }
+            const double arrival = time + uniform_int_distribution<int>(1, 15)(rng);
+            trips[trip].push_back({stop, next, trip, position, time, arrival});
+            stop = next;
+            time = arrival;
+        }
+        connections.insert(connections.end(), trips[trip].begin(), trips[trip].end());
+    }
+    shuffle(connections.begin(), connections.end(), rng);
+    const transit::ConnectionScan scan(kStopCount, kTripCount, move(connections));
+
+    for (size_t query = 0; query < kQueryCount; ++query) {
+        const transit::StopId from = stop_dist(rng);
+        const transit::StopId to = stop_dist(rng);
+        const double departure = static_cast<double>(uniform_int_distribution<int>(0, 700)(rng));
+        const string query_name = to_string(from) + " -> "s + to_string(to) + " at "s + to_string(departure);
+
+        vector<double> earliest(kStopCount, numeric_limits<double>::infinity());
+        earliest[from] = departure;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto& trip : trips) {
+                bool on_board = false;
+                for (const auto& connection : trip) {
+                    on_board = on_board || earliest[connection.from] <= connection.departure;
+                    if (on_board && connection.arrival < earliest[connection.to]) {
+                        earliest[connection.to] = connection.arrival;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        const auto journey = scan.FindEarliestArrival(from, to, departure);
+        check.Expect(journey.has_value() == isfinite(earliest[to]), "reachability differs for "s + query_name);
+        if (!journey) {
+            continue;
+        }
+        check.Expect(journey->arrival == earliest[to], "arrival is not the earliest for "s + query_name);
+
+        // Участки идут подряд, посадка не раньше прибытия на остановку, участок - span_count перегонов одного рейса
+        transit::StopId stop = from;
+        double time = departure;
+        for (const auto& leg : journey->legs) {
+            check.Expect(leg.trip < kTripCount, "unknown trip in journey for "s + query_name);
+            if (leg.trip >= kTripCount) {
+                break;
+            }
+            check.Expect(leg.from == stop && time <= leg.departure, "legs are not connected for "s + query_name);
+            const auto& trip = trips[leg.trip];
+            const auto board = find_if(trip.begin(), trip.end(), [&leg](const transit::Connection& connection) {
+                return connection.from == leg.from && connection.departure == leg.departure;
+            });
+            const auto board_idx = static_cast<size_t>(board - trip.begin());
+            const bool valid_leg = board != trip.end() && leg.span_count > 0 && board_idx + leg.span_count <= trip.size()
+                                   && trip[board_idx + leg.span_count - 1].to == leg.to
+                                   && trip[board_idx + leg.span_count - 1].arrival == leg.arrival;
+            check.Expect(valid_leg, "leg does not follow its trip for "s + query_name);
+            stop = leg.to;
+            time = leg.arrival;
+        }
+        check.Expect(stop == to && time == journey->arrival, "journey does not end at the target for "s + query_name);
+    }
+}
+
+/**
+ * Route с временем отправления в городе с расписаниями: время маршрута - сумма шагов, а более позднее отправление
+ * не дает более раннего прибытия
+ */
+void CheckTimetableRoutes(Check& check) {
+    City city = GenerateCity({.stop_count = 300, .bus_count = 60, .min_route_stops = 5, .max_route_stops = 25});
+    AddTimetables(city, 10.0);
+    TransportCatalogue db;
+    FillCatalogue(city, db);
+    const TransportRouter router(db, {.velocity = 40.0, .wait_time = 6, .strategy = RoutingStrategy::kDijkstra});
+
+    mt19937_64 rng(17);
+    uniform_real_distribution<double> time_dist(6 * 60.0, 21 * 60.0);
+    for (const auto& [from, to] : RandomStopPairs(city, 300, 17)) {
+        const double departure = time_dist(rng);
+        const auto route = router.GetRouteAt(from, to, departure);
+        const auto later_route = router.GetRouteAt(from, to, departure + 7.5);
+        if (route) {
+            check.Expect(SameTime(route->total_time, SumItemTimes(*route)),
+                         "timetable total_time differs from the sum of item times for "s + PairName(from, to));
+        }
+        if (later_route) {
+            check.Expect(route && departure + route->total_time <= departure + 7.5 + later_route->total_time + kTimeEpsilon,
+                         "later departure arrives earlier for "s + PairName(from, to));
+        }
+    }
+}
+
+// ---------- DEFLATE и base64 ------------------
+
+/**
+ * Распаковщик DEFLATE (RFC 1951) для проверки кодировщика: блоки без сжатия, с фиксированными и динамическими кодами.
+ * Коды Хаффмана декодируются побитно по количеству кодов каждой длины
+ */
+class Inflater {
+public:
+    explicit Inflater(string_view data) : data_(data) {}
+
+    string Run() {
+        for (bool final = false; !final;) {
+            final = ReadBits(1) != 0;
+            switch (ReadBits(2)) {
+                case 0:
+                    ReadStoredBlock();
+                    break;
+                case 1:
+                    ReadFixedBlock();
+                    break;
+                case 2:
+                    ReadDynamicBlock();
+                    break;
+                default:
+                    throw runtime_error("Invalid DEFLATE block type");
+            }
+        }
+        return move(output_);
+    }
+
+private:
+    static constexpr int kMaxCodeLength = 15;
+
+    struct Huffman {
+        vector<uint16_t> counts;    // Количество кодов каждой длины
+        vector<uint16_t> symbols;   // Символы по возрастанию кода
+    };
+
+    string_view data_;
+    size_t pos_ = 0;
+    uint32_t bit_buffer_ = 0;
+    int bit_count_ = 0;
+    string output_;
+
+    uint32_t ReadBits(int count) {
+        while (bit_count_ < count) {
+            if (pos_ == data_.size()) {
+                throw runtime_error("Unexpected end of DEFLATE stream");
+            }
+            bit_buffer_ |= static_cast<uint32_t>(static_cast<uint8_t>(data_[pos_++])) << bit_count_;
+            bit_count_ += 8;
+        }
+        const uint32_t result = bit_buffer_ & ((1u << count) - 1);
+        bit_buffer_ >>= count;
+        bit_count_ -= count;
+        return result;
+    }
+
+    static Huffman MakeHuffman(const vector<uint8_t>& lengths) {
+        Huffman result{vector<uint16_t>(kMaxCodeLength + 1, 0), vector<uint16_t>(lengths.size(), 0)};
+        for (const uint8_t length : lengths) {
+            ++result.counts[length];
+        }
+        result.counts[0] = 0;
+
+        vector<uint16_t> offsets(kMaxCodeLength + 1, 0);
+        for (int length = 1; length < kMaxCodeLength; ++length) {
+            offsets[length + 1] = offsets[length] + result.counts[length];
+        }
+        for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+            if (lengths[symbol] != 0) {
+                result.symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+            }
+        }
+        return result;
+    }
+
+    int Decode(const Huffman& huffman) {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int length = 1; length <= kMaxCodeLength; ++length) {
+            code |= static_cast<int>(ReadBits(1));
+            const int count = huffman.counts[length];
+            if (code - first < count) {
+                return huffman.symbols[index + code - first];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw runtime_error("Invalid Huffman code in DEFLATE stream");
+    }
+
+    void ReadStoredBlock() {
+        // Остаток текущего байта пропускается, в буфере не бывает больше одного начатого байта
+        bit_buffer_ = 0;
+        bit_count_ = 0;
+        if (data_.size() - pos_ < 4) {
+            throw runtime_error("Unexpected end of DEFLATE stream");
+        }
+        auto read_u16 = [this](size_t at) {
+            return static_cast<uint16_t>(static_cast<uint8_t>(data_[at]) | (static_cast<uint8_t>(data_[at + 1]) << 8));
+        };
+        const uint16_t length = read_u16(pos_);
+        if (static_cast<uint16_t>(~length) != read_u16(pos_ + 2) || data_.size() - pos_ - 4 < length) {
+            throw runtime_error("Invalid stored DEFLATE block");
+        }
+        output_.append(data_.substr(pos_ + 4, length));
+        pos_ += 4 + length;
+    }
+
+    void ReadFixedBlock() {
+        vector<uint8_t> literal_lengths(288, 8);
+        fill(literal_lengths.begin() + 144, literal_lengths.begin() + 256, 9);
+        fill(literal_lengths.begin() + 256, literal_lengths.begin() + 280, 7);
+        ReadCodes(MakeHuffman(literal_lengths), MakeHuffman(vector<uint8_t>(30, 5)));
+    }
+
+    void ReadDynamicBlock() {
+        static constexpr int kOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        const size_t literal_count = ReadBits(5) + 257;
+        const size_t distance_count = ReadBits(5) + 1;
+        const size_t code_length_count = ReadBits(4) + 4;
+
+        vector<uint8_t> code_lengths(19, 0);
+        for (size_t i = 0; i < code_length_count; ++i) {
+            code_lengths[kOrder[i]] = static_cast<uint8_t>(ReadBits(3));
+        }
+        const Huffman code_length_huffman = MakeHuffman(code_lengths);
+
+        vector<uint8_t> lengths;
+        while (lengths.size() < literal_count + distance_count) {
+            const int symbol = Decode(code_length_huffman);
+            if (symbol < 16) {
+                lengths.push_back(static_cast<uint8_t>(symbol));
+                continue;
+            }
+            uint8_t value = 0;
+            size_t repeat = 0;
+            if (symbol == 16) {
+                if (lengths.empty()) {
+                    throw runtime_error("Repeat without previous code length in DEFLATE stream");
+                }
+                value = lengths.back();
+                repeat = 3 + ReadBits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + ReadBits(3);
+            } else {
+                repeat = 11 + ReadBits(7);
+            }
+            lengths.insert(lengths.end(), repeat, value);
+        }
+        if (lengths.size() != literal_count + distance_count) {
+            throw runtime_error("Too many code lengths in DEFLATE stream");
+        }
+
+        ReadCodes(MakeHuffman(vector<uint8_t>(lengths.begin(), lengths.begin() + literal_count)),
+                  MakeHuffman(vector<uint8_t>(lengths.begin() + literal_count, lengths.end())));
+    }
+
+    void ReadCodes(const Huffman& literals, const Huffman& distances) {
+        static constexpr uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                     35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr uint16_t kDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                       257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                       8193, 12289, 16385, 24577};
+        static constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                       7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        while (true) {
+            const int symbol = Decode(literals);
+            if (symbol < 256) {
+                output_.push_back(static_cast<char>(symbol));
+                continue;
+            }
+            if (symbol == 256) {
+                return;
+            }
+            const int length_code = symbol - 257;
+            if (length_code >= 29) {
+                throw runtime_error("Invalid length code in DEFLATE stream");
+            }
+            const size_t length = kLengthBase[length_code] + ReadBits(kLengthExtra[length_code]);
+            const int distance_code = Decode(distances);
+            if (distance_code >= 30) {
+                throw runtime_error("Invalid distance code in DEFLATE stream");
+            }
+            const size_t distance = kDistanceBase[distance_code] + ReadBits(kDistanceExtra[distance_code]);
+            if (distance > output_.size()) {
+                throw runtime_error("Distance is too far back in DEFLATE stream");
+            }
+            // Повтор может перекрываться с самим собой, поэтому копируется побайтно
+            for (size_t i = 0; i < length; ++i) {
+                output_.push_back(output_[output_.size() - distance]);
+            }
+        }
+    }
+};
+
+string DecodeBase64(string_view data) {
+    auto value = [](char c) -> uint32_t {
+        if (c >= 'A' && c <= 'Z') {
+            return c - 'A';
+        }
+        if (c >= 'a' && c <= 'z') {
+            return c - 'a' + 26;
+        }
+        if (c >= '0' && c <= '9') {
+            return c - '0' + 52;
+        }
+        if (c == '+') {
+            return 62;
+        }
+        if (c == '/') {
+            return 63;
+        }
+        throw runtime_error("Invalid base64 character");
+    };
+    if (data.size() % 4 != 0) {
+        throw runtime_error("Invalid base64 length");
+    }
+
+    string result;
+    for (size_t i = 0; i < data.size(); i += 4) {
+        const size_t padding = (data[i + 3] == '=') + (data[i + 2] == '=');
+        uint32_t bits = 0;
+        for (size_t j = 0; j < 4; ++j) {
+            bits = (bits << 6) | (j < 4 - padding ? value(data[i + j]) : 0);
+        }
+        for (size_t j = 0; j < 3 - padding; ++j) {
+            result.push_back(static_cast<char>((bits >> (16 - 8 * j)) & 0xFF));
+        }
+    }
+    return result;
+}
+
+string Deflate(string_view data, size_t chunk_size) {
+    string result;
+    compression::DeflateEncoder encoder(result);
+    for (size_t pos = 0; pos < data.size(); pos += chunk_size) {
+        encoder.Write(data.substr(pos, chunk_size));
+    }
+    encoder.Finish();
+    return result;
+}
+
+/**
+ * Данные разного вида, включая повторы дальше окна 32 КиБ и длиннее наибольшей длины повтора, сжимаются частями разного
+ * размера и распаковываются обратно. Карта сжимается через DeflateBuffer, как в ответе на Map
+ */
+void CheckDeflate(Check& check) {
+    mt19937_64 rng(19);
+    vector<pair<string, string>> inputs;
+    inputs.emplace_back("empty"s, ""s);
+    inputs.emplace_back("one byte"s, "a"s);
+
+    string random_bytes(100'000, '\0');
+    for (char& c : random_bytes) {
+        c = static_cast<char>(rng() & 0xFF);
+    }
+    inputs.emplace_back("random bytes"s, move(random_bytes));
+    inputs.emplace_back("one repeated byte"s, string(300'000, 'z'));
+
+    string text;
+    uniform_int_distribution<int> word_dist(0, 99);
+    while (text.size() < 400'000) {
+        text += "word"s + to_string(word_dist(rng)) + (word_dist(rng) < 10 ? "\n"s : " "s);
+    }
+    inputs.emplace_back("text"s, text);
+
+    // Один и тот же случайный блок с разрывами больше окна
+    string far_repeats;
+    const string block = inputs[2].second.substr(0, 20'000);
+    for (int i = 0; i < 6; ++i) {
+        far_repeats += block;
+        far_repeats += string(i * 9'000, static_cast<char>('0' + i));
+    }
+    inputs.emplace_back("far repeats"s, move(far_repeats));
+
+    for (const auto& [name, data] : inputs) {
+        for (const size_t chunk_size : {size_t{1}, size_t{7}, size_t{4096}, max<size_t>(1, data.size())}) {
+            if (chunk_size == 1 && data.size() > 50'000) {
+                continue;
+            }
+            const string compressed = Deflate(data, chunk_size);
+            check.Expect(Inflater(compressed).Run() == data,
+                         name + " does not round-trip with chunk size "s + to_string(chunk_size));
+        }
+    }
+
+    // Карта сжимается потоком прямо при выводе svg
+    const City city = GenerateCity({.stop_count = 300, .bus_count = 60, .min_route_stops = 5, .max_route_stops = 25});
+    istringstream input(ToString(MakeInputDocument(city, {})));
+    ostringstream output;
+    JsonReader reader(input, output);
+    reader.ParseBaseRequests();
+    const RequestHandler& handler = reader.GetRequestHandler();
+    const string map = handler.RenderMap();
+    const string compressed_map = handler.RenderCompressedMap();
+    check.Expect(Inflater(compressed_map).Run() == map, "compressed map differs from the svg map"s);
+    check.Expect(compressed_map.size() < map.size() / 2, "compressed map is not smaller than half of the svg"s);
+
+    for (size_t size = 0; size < 10; ++size) {
+        const string data = inputs[2].second.substr(0, size);
+        check.Expect(DecodeBase64(compression::EncodeBase64(data)) == data,
+                     "base64 does not round-trip "s + to_string(size) + " bytes"s);
+    }
+    check.Expect(DecodeBase64(compression::EncodeBase64(compressed_map)) == compressed_map,
+                 "base64 does not round-trip the compressed map"s);
+}
+
+// ---------- Двоичный протокол ------------------
+
+template <typename Func>
+bool Throws(Func&& func) {
+    try {
+        func();
+    } catch (const exception&) {
+        return true;
+    }
+    return false;
+}
+
+bool SameRequest(const binary::StatRequest& lhs, const binary::StatRequest& rhs) {
+    return lhs.id == rhs.id && lhs.type == rhs.type && lhs.name == rhs.name && lhs.from == rhs.from && lhs.to == rhs.to
+           && lhs.departure_time == rhs.departure_time && lhs.compress_map == rhs.compress_map;
+}
+
+// Значения на границах varint и zigzag, запросы всех поддерживаемых видов и испорченные кадры
+void CheckBinaryCodec(Check& check) {
+    const vector<uint64_t> unsigned_values = {0, 1, 127, 128, 16383, 16384, uint64_t{1} << 35, UINT64_MAX - 1, UINT64_MAX};
+    const vector<int64_t> signed_values = {0, -1, 1, 63, -64, 64, INT_MIN, INT_MAX, INT64_MIN, INT64_MAX};
+    const vector<double> double_values = {0.0, -0.0, 1.5, -1e300, numeric_limits<double>::denorm_min(),
+                                          numeric_limits<double>::infinity()};
+    binary::Writer writer;
+    for (const uint64_t value : unsigned_values) {
+        writer.WriteVarint(value);
+    }
+    for (const int64_t value : signed_values) {
+        writer.WriteSigned(value);
+    }
+    for (const double value : double_values) {
+        writer.WriteDouble(value);
+    }
+    writer.WriteString(""sv);
+    writer.WriteString("Остановка"sv);
+
+    binary::Reader reader(writer.GetData());
+    for (const uint64_t value : unsigned_values) {
+        check.Expect(reader.ReadVarint() == value, "varint "s + to_string(value) + " does not round-trip"s);
+    }
+    for (const int64_t value : signed_values) {
+        check.Expect(reader.ReadSigned() == value, "signed "s + to_string(value) + " does not round-trip"s);
+    }
+    for (const double value : double_values) {
+        const double decoded = reader.ReadDouble();
+        check.Expect(decoded == value && signbit(decoded) == signbit(value), "double does not round-trip"s);
+    }
+    check.Expect(reader.ReadString().empty() && reader.ReadString() == "Остановка"sv && reader.IsEnd(),
+                 "strings do not round-trip"s);
+
+    vector<binary::StatRequest> requests(6);
+    requests[0].name = "A"sv;
+    requests[1].id = INT_MIN;
+    requests[1].type = StatRequestType::kBus;
+    requests[2].id = INT_MAX;
+    requests[2].type = StatRequestType::kRoute;
+    requests[2].from = "A"sv;
+    requests[2].to = "B"sv;
+    requests[3].id = -5;
+    requests[3].type = StatRequestType::kRoute;
+    requests[3].from = "Длинное название"sv;
+    requests[3].to = "B"sv;
+    requests[3].departure_time = 601.25;
+    requests[4].id = 7;
+    requests[4].type = StatRequestType::kMap;
+    requests[5].id = 8;
+    requests[5].type = StatRequestType::kMap;
+    requests[5].compress_map = true;
+    stringstream frames;
+    for (const auto& request : requests) {
+        writer.Clear();
+        binary::EncodeRequest(request, writer);
+        binary::WriteFrame(frames, writer.GetData());
+    }
+    string payload;
+    for (const auto& request : requests) {
+        check.Expect(binary::ReadFrame(frames, payload), "frame is missing"s);
+        binary::Reader request_reader(payload);
+        check.Expect(SameRequest(binary::DecodeRequest(request_reader), request) && request_reader.IsEnd(),
+                     "request "s + to_string(request.id) + " does not round-trip"s);
+    }
+    check.Expect(!binary::ReadFrame(frames, payload), "unexpected frame after the last one"s);
+
+    auto read_frame = [](const string& data) {
+        istringstream input(data);
+        string frame_payload;
+        binary::ReadFrame(input, frame_payload);
+    };
+    auto decode = [](const binary::Writer& request_writer) {
+        binary::Reader request_reader(request_writer.GetData());
+        binary::DecodeRequest(request_reader);
+    };
+
+    binary::Writer bad;
+    bad.WriteVarint(binary::kMaxFrameSize + 1);
+    check.Expect(Throws([&] { read_frame(string(bad.GetData())); }), "oversized frame is accepted"s);
+    bad.Clear();
+    bad.WriteVarint(10);
+    check.Expect(Throws([&] { read_frame(string(bad.GetData()) + "abc"s); }), "truncated frame is accepted"s);
+    check.Expect(Throws([&] { read_frame(string(11, '\xFF')); }), "overlong frame length is accepted"s);
+
+    bad.Clear();
+    bad.WriteSigned(int64_t{INT_MAX} + 1);
+    bad.WriteVarint(static_cast<uint64_t>(StatRequestType::kMap));
+    check.Expect(Throws([&] { decode(bad); }), "request id outside int range is accepted"s);
+    bad.Clear();
+    bad.WriteSigned(1);
+    bad.WriteVarint(static_cast<uint64_t>(StatRequestType::kCount));
+    check.Expect(Throws([&] { decode(bad); }), "unknown request type is accepted"s);
+    bad.Clear();
+    bad.WriteSigned(1);
+    bad.WriteVarint(static_cast<uint64_t>(StatRequestType::kStop));
+    bad.WriteVarint(5);
+    check.Expect(Throws([&] { decode(bad); }), "truncated string is accepted"s);
+}
+
+/**
+ * Кадры запросов проходят через BinaryReader, а ответы декодируются здесь и сравниваются с ответами RequestHandler.
+ * Повторные Route должны отвечаться из кэша ответов
+ */
+void CheckBinaryResponses(Check& check) {
+    City city = GenerateCity({.stop_count = 300, .bus_count = 60, .min_route_stops = 5, .max_route_stops = 25});
+    AddTimetables(city, 10.0);
+    istringstream setup(ToString(MakeInputDocument(city, {}, "contraction_hierarchy"s)));
+    ostringstream setup_output;
+    JsonReader json_reader(setup, setup_output);
+    json_reader.ParseBaseRequests();
+    const RequestHandler& handler = json_reader.GetRequestHandler();
+
+    // Строки запросов ссылаются на `names`
+    mt19937_64 rng(23);
+    vector<string> names;
+    vector<binary::StatRequest> requests;
+    auto random_stop = [&] {
+        return city.stops[uniform_int_distribution<size_t>(0, city.stops.size() - 1)(rng)].name;
+    };
+    names.reserve(1000);
+    for (int id = 0; id < 300; ++id) {
+        binary::StatRequest& request = requests.emplace_back();
+        request.id = id % 2 == 0 ? id : -id;
+        switch (id % 5) {
+            case 0:
+                request.type = StatRequestType::kStop;
+                request.name = names.emplace_back(id % 20 == 0 ? "unknown"s : random_stop());
+                break;
+            case 1:
+                request.type = StatRequestType::kBus;
+                request.name = names.emplace_back(
+                    id % 21 == 1 ? "unknown"s : city.buses[uniform_int_distribution<size_t>(0, city.buses.size() - 1)(rng)].name);
+                break;
+            case 4:
+                request.departure_time = uniform_real_distribution<double>(6 * 60.0, 21 * 60.0)(rng);
+                [[fallthrough]];
+            default:
+                // Неизвестная остановка отправления или назначения - ответ kNotFound, а не ошибка
+                request.type = StatRequestType::kRoute;
+                request.from = names.emplace_back(id % 20 == 3 ? "Nowhere"s : random_stop());
+                request.to = names.emplace_back(id % 20 == 4 ? "Nowhere2"s : random_stop());
+                break;
+        }
+    }
+    // Повторы уже заданных Route без времени отправления
+    for (size_t i = 0; i < 50; ++i) {
+        binary::StatRequest repeat = requests[5 * i + 2];
+        repeat.id = 1000 + static_cast<int>(i);
+        requests.push_back(repeat);
+    }
+    binary::StatRequest& map_request = requests.emplace_back();
+    map_request.id = 2000;
+    map_request.type = StatRequestType::kMap;
+    map_request.compress_map = true;
+
+    stringstream input;
+    binary::Writer writer;
+    for (const auto& request : requests) {
+        writer.Clear();
+        binary::EncodeRequest(request, writer);
+        binary::WriteFrame(input, writer.GetData());
+    }
+    stringstream output;
+    BinaryReader(handler, input, output).ParseStatRequests();
+    const uint64_t cache_hits = handler.GetRouteCacheStats().hits;
+
+    string payload;
+    for (const auto& request : requests) {
+        const string request_name = "binary request "s + to_string(request.id);
+        if (!binary::ReadFrame(output, payload)) {
+            check.Expect(false, request_name + " has no response"s);
+            break;
+        }
+        binary::Reader reader(payload);
+        check.Expect(reader.ReadSigned() == request.id, request_name + " response has another id"s);
+        const auto status = static_cast<binary::ResponseStatus>(reader.ReadByte());
+
+        switch (request.type) {
+            case StatRequestType::kStop: {
+                const auto expected = handler.GetStopStat(request.name);
+                check.Expect((status == binary::ResponseStatus::kOk) == expected.has_value(),
+                             request_name + " status differs"s);
+                if (!expected || status != binary::ResponseStatus::kOk) {
+                    break;
+                }
+                vector<string_view> expected_buses;
+                for (const auto* bus : *expected) {
+                    expected_buses.push_back(bus->name);
+                }
+                sort(expected_buses.begin(), expected_buses.end());
+                vector<string_view> buses(reader.ReadVarint());
+                for (auto& bus : buses) {
+                    bus = reader.ReadString();
+                }
+                check.Expect(buses == expected_buses, request_name + " buses differ"s);
+                break;
+            }
+            case StatRequestType::kBus: {
+                const auto expected = handler.GetBusStat(request.name);
+                check.Expect((status == binary::ResponseStatus::kOk) == expected.has_value(),
+                             request_name + " status differs"s);
+                if (!expected || status != binary::ResponseStatus::kOk) {
+                    break;
+                }
+                const uint64_t route_length = reader.ReadVarint();
+                const double curvature = reader.ReadDouble();
+                const uint64_t stop_count = reader.ReadVarint();
+                const uint64_t unique_stop_count = reader.ReadVarint();
+                check.Expect(route_length == static_cast<uint64_t>(expected->road_distance)
+                             && curvature == expected->road_distance / expected->geo_distance
+                             && stop_count == static_cast<uint64_t>(expected->stop_count)
+                             && unique_stop_count == static_cast<uint64_t>(expected->uniq_stops),
+                             request_name + " bus stat differs"s);
+                break;
+            }
+            case StatRequestType::kRoute: {
+                const auto expected = handler.BuildRoute(request.from, request.to, request.departure_time);
+                check.Expect((status == binary::ResponseStatus::kOk) == expected.has_value(),
+                             request_name + " status differs"s);
+                if (!expected || status != binary::ResponseStatus::kOk) {
+                    break;
+                }
+                bool same = reader.ReadDouble() == expected->total_time && reader.ReadVarint() == expected->items.size();
+                for (size_t i = 0; same && i < expected->items.size(); ++i) {
+                    const auto kind = static_cast<binary::RouteItemKind>(reader.ReadByte());
+                    if (const auto* wait = get_if<domain::dto::Waiting>(&expected->items[i])) {
+                        same = kind == binary::RouteItemKind::kWait && reader.ReadString() == wait->stop_name
+                               && reader.ReadDouble() == wait->time;
+                    } else {
+                        const auto& trip = get<domain::dto::Trip>(expected->items[i]);
+                        same = kind == binary::RouteItemKind::kBus && reader.ReadString() == trip.bus
+                               && reader.ReadDouble() == trip.time
+                               && reader.ReadVarint() == static_cast<uint64_t>(trip.span_count);
+                    }
+                }
+                check.Expect(same, request_name + " route differs"s);
+                break;
+            }
+            case StatRequestType::kMap:
+                check.Expect(status == binary::ResponseStatus::kOk
+                             && Inflater(reader.ReadString()).Run() == handler.RenderMap(),
+                             request_name + " compressed map differs from the svg map"s);
+                break;
+            default:
+                break;
+        }
+        check.Expect(reader.IsEnd(), request_name + " response has trailing bytes"s);
+    }
+    check.Expect(!binary::ReadFrame(output, payload), "unexpected binary response after the last one"s);
+    check.Expect(cache_hits >= 50, "repeated binary Route requests are not answered from the cache"s);
+}
+
+} // namespace
+
+bool RunChecks(ostream& out) {
+    const vector<pair<string, void (*)(Check&)>> checks = {
+        {"router_strategies"s, CheckRouterStrategies},
+        {"connection_scan"s, CheckConnectionScan},
+        {"timetable_routes"s, CheckTimetableRoutes},
+        {"deflate"s, CheckDeflate},
+        {"binary_codec"s, CheckBinaryCodec},
+        {"binary_responses"s, CheckBinaryResponses},
+    };
+
+    bool success = true;
+    for (const auto& [name, func] : checks) {
+        Check check(out, name);
+        try {
+            func(check);
+        } catch (const exception& e) {
+            check.Expect(false, "exception: "s + e.what());
+        }
+        success = check.Finish() && success;
+    }
+    return success;
+}
+
+} // namespace bench
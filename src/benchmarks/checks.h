@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+
+namespace bench {
+
+/**
+ * Проверки корректности на синтетических городах, запускаются ключом --check и из ctest. Ответы каталога, роутера
+ * и протоколов сравниваются с эталонами, реализованными здесь независимо от проверяемого кода.
+ * По каждой проверке выводится строка с результатом. false - хотя бы одна проверка не прошла
+ */
+bool RunChecks(std::ostream& out);
+
+} // namespace bench
@@ -0,0 +1,379 @@
+#include "city_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string_view>
+
+using namespace std;
+using namespace json;
+
+namespace bench {
+
+namespace {
+
+// Границы города примерно соответствуют Москве
+constexpr double kMinLat = 55.55;
+constexpr double kMaxLat = 55.90;
+constexpr double kMinLng = 37.35;
+constexpr double kMaxLng = 37.85;
+
+// Количество источников и целей в запросе Matrix
+constexpr size_t kMatrixSide = 20;
+
+// Бюджет времени запроса Isochrone в минутах
+constexpr double kIsochroneMaxTime = 30.0;
+
+// Границы расписания AddTimetables в минутах от начала суток
+constexpr double kFirstDeparture = 6 * 60.0;
+constexpr double kLastDeparture = 22 * 60.0;
+
+// Переопределения AddRoutingOverrides
+constexpr double kExpressVelocity = 60.0;
+constexpr int kHubWaitTime = 2;
+
+string StopName(size_t idx) {
+    return "Stop "s + to_string(idx);
+}
+
+string BusName(size_t idx) {
+    return "Bus "s + to_string(idx);
+}
+
+// Случайное блуждание по сетке side x side без немедленного возврата на предыдущий узел
+vector<size_t> RandomWalk(size_t start, size_t length, size_t side, size_t stop_count, mt19937_64& rng) {
+    vector<size_t> result;
+    result.reserve(length);
+    result.push_back(start);
+
+    size_t prev = start;
+    while (result.size() < length) {
+        const size_t current = result.back();
+        const size_t row = current / side;
+        const size_t col = current % side;
+
+        vector<size_t> neighbours;
+        if (row > 0) neighbours.push_back(current - side);
+        if (col > 0) neighbours.push_back(current - 1);
+        if (col + 1 < side && current + 1 < stop_count) neighbours.push_back(current + 1);
+        if (current + side < stop_count) neighbours.push_back(current + side);
+
+        if (neighbours.size() > 1) {
+            erase(neighbours, prev);
+        }
+        if (neighbours.empty()) {
+            break;
+        }
+
+        prev = current;
+        result.push_back(neighbours[uniform_int_distribution<size_t>(0, neighbours.size() - 1)(rng)]);
+    }
+
+    return result;
+}
+
+Node MakeRenderSettings() {
+    return Dict{
+        {"width"s, 1200.0},
+        {"height"s, 1200.0},
+        {"padding"s, 50.0},
+        {"line_width"s, 14.0},
+        {"stop_radius"s, 5.0},
+        {"bus_label_font_size"s, 20},
+        {"bus_label_offset"s, Array{7.0, 15.0}},
+        {"stop_label_font_size"s, 20},
+        {"stop_label_offset"s, Array{7.0, -3.0}},
+        {"underlayer_color"s, Array{255, 255, 255, 0.85}},
+        {"underlayer_width"s, 3.0},
+        {"color_palette"s, Array{"green"s, Array{255, 160, 0}, "red"s}},
+    };
+}
+
+Node MakeRoutingSettings(string strategy, optional<int> route_cache_capacity) {
+    Dict result{
+        {"bus_wait_time"s, 6},
+        {"bus_velocity"s, 40.0},
+        {"strategy"s, move(strategy)},
+    };
+    if (route_cache_capacity) {
+        result.emplace("route_cache_capacity"s, *route_cache_capacity);
+    }
+    return result;
+}
+
+} // namespace
+
+City GenerateCity(const CityParams& params) {
+    mt19937_64 rng(params.seed);
+    uniform_real_distribution<double> jitter(-0.3, 0.3);
+    uniform_real_distribution<double> probability(0.0, 1.0);
+
+    City city;
+    city.stops.reserve(params.stop_count);
+
+    const size_t side = max<size_t>(1, static_cast<size_t>(ceil(sqrt(static_cast<double>(params.stop_count)))));
+    const double lat_step = (kMaxLat - kMinLat) / side;
+    const double lng_step = (kMaxLng - kMinLng) / side;
+
+    for (size_t i = 0; i < params.stop_count; ++i) {
+        const double row = static_cast<double>(i / side) + 0.5 + jitter(rng);
+        const double col = static_cast<double>(i % side) + 0.5 + jitter(rng);
+        city.stops.push_back({StopName(i), {kMinLat + row * lat_step, kMinLng + col * lng_step}, {}, nullopt});
+    }
+
+    if (params.stop_count < 2) {
+        return city;
+    }
+
+    uniform_int_distribution<size_t> stop_dist(0, params.stop_count - 1);
+    uniform_int_distribution<size_t> length_dist(max<size_t>(2, params.min_route_stops),
+                                                 max<size_t>(2, max(params.min_route_stops, params.max_route_stops)));
+    uniform_real_distribution<double> road_factor(1.05, 1.6);
+
+    city.buses.reserve(params.bus_count);
+    for (size_t i = 0; i < params.bus_count; ++i) {
+        const bool is_roundtrip = probability(rng) < params.roundtrip_ratio;
+        vector<size_t> route = RandomWalk(stop_dist(rng), length_dist(rng), side, params.stop_count, rng);
+        if (is_roundtrip) {
+            // Кольцевой маршрут в исходных данных заканчивается той же остановкой, с которой начинается
+            route.push_back(route.front());
+        }
+
+        for (size_t j = 1; j < route.size(); ++j) {
+            auto& from = city.stops[route[j - 1]];
+            const auto& to = city.stops[route[j]];
+            if (from.name == to.name || probability(rng) >= params.road_distance_density) {
+                continue;
+            }
+            const double geo_distance = geo::ComputeDistance(from.coordinates, to.coordinates);
+            from.road_distances.emplace(to.name, static_cast<int>(geo_distance * road_factor(rng)) + 1);
+        }
+
+        City::BusData bus{BusName(i), {}, is_roundtrip, nullopt, nullopt};
+        bus.stops.reserve(route.size());
+        for (size_t idx : route) {
+            bus.stops.push_back(city.stops[idx].name);
+        }
+        city.buses.push_back(move(bus));
+    }
+
+    return city;
+}
+
+void AddTimetables(City& city, double headway) {
+    for (size_t i = 0; i < city.buses.size(); ++i) {
+        const double shift = fmod(static_cast<double>(i), headway);
+        city.buses[i].timetable = City::Timetable{kFirstDeparture + shift, kLastDeparture, headway};
+    }
+}
+
+void AddRoutingOverrides(City& city) {
+    for (size_t i = 0; i < city.buses.size(); i += 3) {
+        city.buses[i].velocity = kExpressVelocity;
+    }
+    for (size_t i = 0; i < city.stops.size(); i += 5) {
+        city.stops[i].wait_time = kHubWaitTime;
+    }
+}
+
+void FillCatalogue(const City& city, TransportCatalogue& db) {
+    vector<domain::dto::StopDescription> stops;
+    stops.reserve(city.stops.size());
+    for (const auto& stop : city.stops) {
+        stops.push_back({stop.name, stop.coordinates, stop.wait_time});
+    }
+    db.AddStops(stops);
+
+    for (const auto& stop : city.stops) {
+        for (const auto& [to, distance] : stop.road_distances) {
+            db.SetRoadDistance(stop.name, to, distance);
+        }
+    }
+
+    vector<domain::dto::BusDescription> buses;
+    buses.reserve(city.buses.size());
+    for (const auto& bus : city.buses) {
+        vector<double> departures;
+        if (bus.timetable) {
+            for (double time = bus.timetable->first_departure; time <= bus.timetable->last_departure;
+                 time += bus.timetable->headway) {
+                departures.push_back(time);
+            }
+        }
+        buses.push_back({bus.name, vector<string_view>(bus.stops.begin(), bus.stops.end()), bus.is_roundtrip,
+                         move(departures), bus.velocity});
+    }
+    db.AddBuses(buses);
+}
+
+Array GenerateStatRequests(const City& city, requests::StatRequestType type, size_t count, uint64_t seed) {
+    using requests::StatRequestType;
+
+    mt19937_64 rng(seed);
+    auto random_stop = [&]() -> const string& {
+        return city.stops[uniform_int_distribution<size_t>(0, city.stops.size() - 1)(rng)].name;
+    };
+    auto random_bus = [&]() -> const string& {
+        return city.buses[uniform_int_distribution<size_t>(0, city.buses.size() - 1)(rng)].name;
+    };
+
+    Array result;
+    result.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        Dict request{{"id"s, static_cast<int>(i + 1)}};
+        switch (type) {
+            case StatRequestType::kStop:
+                request.emplace("type"s, "Stop"s);
+                request.emplace("name"s, random_stop());
+                break;
+            case StatRequestType::kBus:
+                request.emplace("type"s, "Bus"s);
+                request.emplace("name"s, random_bus());
+                break;
+            case StatRequestType::kMap:
+                request.emplace("type"s, "Map"s);
+                break;
+            case StatRequestType::kRoute:
+                request.emplace("type"s, "Route"s);
+                request.emplace("from"s, random_stop());
+                request.emplace("to"s, random_stop());
+                break;
+            case StatRequestType::kMatrix: {
+                Array sources;
+                Array targets;
+                for (size_t j = 0; j < kMatrixSide; ++j) {
+                    sources.emplace_back(random_stop());
+                    targets.emplace_back(random_stop());
+                }
+                request.emplace("type"s, "Matrix"s);
+                request.emplace("sources"s, move(sources));
+                request.emplace("targets"s, move(targets));
+                break;
+            }
+            case StatRequestType::kIsochrone:
+                request.emplace("type"s, "Isochrone"s);
+                request.emplace("from"s, random_stop());
+                request.emplace("max_time"s, kIsochroneMaxTime);
+                break;
+            case StatRequestType::kBusSegment: {
+                const auto& bus = city.buses[uniform_int_distribution<size_t>(0, city.buses.size() - 1)(rng)];
+                uniform_int_distribution<size_t> position(0, bus.stops.size() - 1);
+                request.emplace("type"s, "BusSegment"s);
+                request.emplace("bus"s, bus.name);
+                request.emplace("from"s, bus.stops[position(rng)]);
+                request.emplace("to"s, bus.stops[position(rng)]);
+                break;
+            }
+            case StatRequestType::kParetoRoute:
+                request.emplace("type"s, "ParetoRoute"s);
+                request.emplace("from"s, random_stop());
+                request.emplace("to"s, random_stop());
+                break;
+            case StatRequestType::kAlternatives:
+                request.emplace("type"s, "Alternatives"s);
+                request.emplace("from"s, random_stop());
+                request.emplace("to"s, random_stop());
+                break;
+            case StatRequestType::kMemory:
+                request.emplace("type"s, "Memory"s);
+                break;
+            case StatRequestType::kCount:
+                break;
+        }
+        result.emplace_back(move(request));
+    }
+
+    return result;
+}
+
+void AddDepartureTimes(Array& stat_requests, uint64_t seed) {
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> time_dist(kFirstDeparture, kLastDeparture);
+    for (auto& request : stat_requests) {
+        auto& dict = get<Dict>(request.GetValue());
+        if (dict.at("type"s).AsString() == "Route"s) {
+            dict.emplace("departure_time"s, time_dist(rng));
+        }
+    }
+}
+
+void ConcentrateRouteOrigins(Array& stat_requests, size_t hub_count, uint64_t seed) {
+    // Узлами становятся остановки отправления первых запросов, поэтому они заведомо есть в городе
+    vector<Node> hubs;
+    for (const auto& request : stat_requests) {
+        if (hubs.size() == hub_count) {
+            break;
+        }
+        const auto& dict = request.AsMap();
+        if (dict.at("type"s).AsString() == "Route"s) {
+            hubs.push_back(dict.at("from"s));
+        }
+    }
+    if (hubs.empty()) {
+        return;
+    }
+
+    mt19937_64 rng(seed);
+    uniform_int_distribution<size_t> hub_dist(0, hubs.size() - 1);
+    for (auto& request : stat_requests) {
+        auto& dict = get<Dict>(request.GetValue());
+        if (dict.at("type"s).AsString() == "Route"s) {
+            dict["from"s] = hubs[hub_dist(rng)];
+        }
+    }
+}
+
+Document MakeInputDocument(const City& city, Array stat_requests, string routing_strategy,
+                           optional<int> route_cache_capacity) {
+    Array base_requests;
+    base_requests.reserve(city.stops.size() + city.buses.size());
+
+    for (const auto& stop : city.stops) {
+        Dict road_distances;
+        for (const auto& [to, distance] : stop.road_distances) {
+            road_distances.emplace(to, distance);
+        }
+        Dict request{
+            {"type"s, "Stop"s},
+            {"name"s, stop.name},
+            {"latitude"s, stop.coordinates.lat},
+            {"longitude"s, stop.coordinates.lng},
+            {"road_distances"s, move(road_distances)},
+        };
+        if (stop.wait_time) {
+            request.emplace("wait_time"s, *stop.wait_time);
+        }
+        base_requests.emplace_back(move(request));
+    }
+
+    for (const auto& bus : city.buses) {
+        Array stops(bus.stops.begin(), bus.stops.end());
+        Dict request{
+            {"type"s, "Bus"s},
+            {"name"s, bus.name},
+            {"stops"s, move(stops)},
+            {"is_roundtrip"s, bus.is_roundtrip},
+        };
+        if (bus.velocity) {
+            request.emplace("velocity"s, *bus.velocity);
+        }
+        if (bus.timetable) {
+            request.emplace("timetable"s, Dict{
+                {"first_departure"s, bus.timetable->first_departure},
+                {"last_departure"s, bus.timetable->last_departure},
+                {"headway"s, bus.timetable->headway},
+            });
+        }
+        base_requests.emplace_back(move(request));
+    }
+
+    return Document{Dict{
+        {"base_requests"s, move(base_requests)},
+        {"stat_requests"s, move(stat_requests)},
+        {"render_settings"s, MakeRenderSettings()},
+        {"routing_settings"s, MakeRoutingSettings(move(routing_strategy), route_cache_capacity)},
+    }};
+}
+
+} // namespace bench
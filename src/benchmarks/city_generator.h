@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "geo.h"
+#include "json.h"
+#include "request_types.h"
+#include "transport_catalogue.h"
+
+namespace bench {
+
+/**
+ * Параметры синтетического города. При одинаковых параметрах (включая seed) генерируется один и тот же город
+ */
+struct CityParams {
+    size_t stop_count = 100;
+    size_t bus_count = 20;
+    size_t min_route_stops = 3;         // Минимальное количество остановок в маршруте автобуса
+    size_t max_route_stops = 20;        // Максимальное количество остановок в маршруте автобуса
+    double roundtrip_ratio = 0.5;       // Доля кольцевых маршрутов
+    double road_distance_density = 0.7; // Доля перегонов, для которых задано дорожное расстояние
+    uint64_t seed = 42;
+};
+
+struct City {
+    struct StopData {
+        std::string name;
+        geo::Coordinates coordinates;
+        std::map<std::string, int> road_distances;
+        std::optional<int> wait_time;
+    };
+
+    struct Timetable {
+        double first_departure;
+        double last_departure;
+        double headway;
+    };
+
+    struct BusData {
+        std::string name;
+        std::vector<std::string> stops;
+        bool is_roundtrip;
+        std::optional<Timetable> timetable;
+        std::optional<double> velocity;
+    };
+
+    std::vector<StopData> stops;
+    std::vector<BusData> buses;
+};
+
+/**
+ * Остановки расставляются по сетке со случайным смещением, а маршруты строятся случайным блужданием
+ * по соседним узлам сетки, поэтому маршруты пересекаются и в графе появляются пересадки
+ */
+City GenerateCity(const CityParams& params);
+
+/**
+ * Интервальное расписание с 6:00 до 22:00 для всех автобусов города. Первые отправления сдвинуты на номер автобуса
+ * по модулю интервала, чтобы рейсы разных автобусов не совпадали по времени. Случайные числа не используются
+ */
+void AddTimetables(City& city, double headway);
+
+/**
+ * Переопределения скорости и ожидания: каждый третий автобус - экспресс со скоростью 60 км/ч,
+ * на каждой пятой остановке (пересадочном узле) ожидание 2 минуты. Случайные числа не используются
+ */
+void AddRoutingOverrides(City& city);
+
+// Заполнение каталога напрямую, минуя json
+void FillCatalogue(const City& city, TransportCatalogue& db);
+
+/**
+ * Запросы одного типа к случайным остановкам/автобусам города
+ */
+json::Array GenerateStatRequests(const City& city, requests::StatRequestType type, size_t count, uint64_t seed);
+
+// Добавляет к запросам Route ключ "departure_time" - случайное время в пределах расписания AddTimetables
+void AddDepartureTimes(json::Array& stat_requests, uint64_t seed);
+
+// Заменяет остановку отправления запросов Route на одну из `hub_count` остановок - пакет с небольшим числом узлов
+void ConcentrateRouteOrigins(json::Array& stat_requests, size_t hub_count, uint64_t seed);
+
+/**
+ * Полный входной документ: base_requests, stat_requests, render_settings и routing_settings.
+ * `routing_strategy` - значение ключа "strategy" в routing_settings, `route_cache_capacity` - ключа "route_cache_capacity"
+ * (если не задан, ключ не добавляется)
+ */
+json::Document MakeInputDocument(const City& city, json::Array stat_requests, std::string routing_strategy = "all_pairs",
+                                 std::optional<int> route_cache_capacity = std::nullopt);
+
+} // namespace bench
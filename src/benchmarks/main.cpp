@@ -0,0 +1,455 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "checks.h"
+#include "binary_protocol.h"
+#include "binary_reader.h"
+#include "city_generator.h"
+#include "json.h"
+#include "json_reader.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+using namespace std;
+using requests::StatRequestType;
+
+namespace {
+
+struct Options {
+    size_t max_stops = 5000;    // Масштабы с большим числом остановок пропускаются
+    size_t iterations = 5;      // Количество повторов каждого замера
+    size_t queries = 200;       // Количество запросов одного типа в пакете stat_requests
+    string filter;              // Запускаются только замеры, в названии которых есть эта подстрока
+};
+
+// Интервал движения автобусов в минутах для замеров поиска по расписанию
+constexpr double kTimetableHeadway = 10.0;
+// Количество остановок отправления в пакете запросов Route с узлами
+constexpr size_t kRouteHubCount = 5;
+
+struct Scale {
+    string name;
+    bench::CityParams params;
+};
+
+const vector<Scale>& GetScales() {
+    static const vector<Scale> scales = {
+        {"small", {.stop_count = 100, .bus_count = 20, .min_route_stops = 3, .max_route_stops = 15}},
+        {"medium", {.stop_count = 300, .bus_count = 60, .min_route_stops = 5, .max_route_stops = 25}},
+        {"large", {.stop_count = 600, .bus_count = 120, .min_route_stops = 5, .max_route_stops = 40}},
+        {"xlarge", {.stop_count = 5000, .bus_count = 1000, .min_route_stops = 5, .max_route_stops = 40}},
+    };
+    return scales;
+}
+
+struct Strategy {
+    string name;                        // Значение ключа "strategy" в routing_settings
+    domain::dto::RoutingStrategy value;
+    size_t max_stops;                   // Для больших городов стратегия не запускается
+};
+
+// Таблица Флойда-Уоршелла строится за O(V^3), поэтому на больших масштабах она пропускается
+const vector<Strategy>& GetStrategies() {
+    static const vector<Strategy> strategies = {
+        {"all_pairs", domain::dto::RoutingStrategy::kAllPairs, 600},
+        {"contraction_hierarchy", domain::dto::RoutingStrategy::kContractionHierarchy, SIZE_MAX},
+        {"dijkstra", domain::dto::RoutingStrategy::kDijkstra, SIZE_MAX},
+        {"bidirectional_dijkstra", domain::dto::RoutingStrategy::kBidirectionalDijkstra, SIZE_MAX},
+        {"a_star", domain::dto::RoutingStrategy::kAStar, SIZE_MAX},
+    };
+    return strategies;
+}
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string_view arg = argv[i];
+        const char* value = argv[i + 1];
+        if (arg == "--max-stops") {
+            options.max_stops = strtoull(value, nullptr, 10);
+        } else if (arg == "--iterations") {
+            options.iterations = max<size_t>(1, strtoull(value, nullptr, 10));
+        } else if (arg == "--queries") {
+            options.queries = max<size_t>(1, strtoull(value, nullptr, 10));
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else {
+            cerr << "Unknown option "s << arg << '\n';
+            exit(EXIT_FAILURE);
+        }
+    }
+    return options;
+}
+
+string ToString(const json::Document& doc) {
+    ostringstream out;
+    json::Print(doc, out);
+    return out.str();
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options_(options) {
+        bench::PrintHeader(cout);
+    }
+
+    template <typename Func>
+    void Run(const string& name, size_t ops_per_iteration, Func&& func) {
+        if (!IsSelected(name)) {
+            return;
+        }
+        bench::PrintResult(cout, bench::Measure(name, options_.iterations, ops_per_iteration, func));
+    }
+
+    // Замер, в котором `func` увеличивает `counter`. В таблицу попадает среднее значение счетчика на операцию
+    template <typename Func>
+    void RunWithCounter(const string& name, size_t ops_per_iteration, size_t& counter, Func&& func) {
+        if (!IsSelected(name)) {
+            return;
+        }
+        counter = 0;
+        bench::Result result = bench::Measure(name, options_.iterations, ops_per_iteration, func);
+        result.counter_per_op = static_cast<double>(counter) / static_cast<double>(result.iterations * result.ops_per_iteration);
+        bench::PrintResult(cout, result);
+    }
+
+    bool IsSelected(const string& name) const {
+        return options_.filter.empty() || name.find(options_.filter) != string::npos;
+    }
+
+private:
+    const Options& options_;
+};
+
+vector<pair<string, string>> GenerateRoutePairs(const bench::City& city, size_t count) {
+    mt19937_64 rng(7);
+    uniform_int_distribution<size_t> stop_dist(0, city.stops.size() - 1);
+
+    vector<pair<string, string>> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.emplace_back(city.stops[stop_dist(rng)].name, city.stops[stop_dist(rng)].name);
+    }
+    return result;
+}
+
+// Запросы двоичного протокола с теми же полями, строки ссылаются на `stat_requests`
+vector<binary::StatRequest> ToBinaryRequests(const json::Array& stat_requests) {
+    vector<binary::StatRequest> result;
+    result.reserve(stat_requests.size());
+    for (const auto& request : stat_requests) {
+        const auto& dict = request.AsMap();
+        binary::StatRequest& item = result.emplace_back();
+        item.id = dict.at("id"s).AsInt();
+        item.type = *requests::kStatRequestTypes.Find(dict.at("type"s).AsString());
+        if (dict.count("name"s)) {
+            item.name = dict.at("name"s).AsString();
+        }
+        if (dict.count("from"s)) {
+            item.from = dict.at("from"s).AsString();
+            item.to = dict.at("to"s).AsString();
+        }
+    }
+    return result;
+}
+
+void RunScale(Runner& runner, const Options& options, const Scale& scale) {
+    const bench::City city = bench::GenerateCity(scale.params);
+    const string prefix = scale.name + "/"s;
+
+    vector<const Strategy*> strategies;
+    for (const auto& strategy : GetStrategies()) {
+        if (scale.params.stop_count <= strategy.max_stops) {
+            strategies.push_back(&strategy);
+        }
+    }
+    // Запросы, не зависящие от роутера, и разбор base_requests используют первую доступную стратегию
+    const string& default_strategy = strategies.front()->name;
+
+    // Разбор json и заполнение каталога. Запросов маршрутов в документе нет, поэтому роутер не строится
+    const string input = ToString(bench::MakeInputDocument(city, {}, default_strategy));
+    runner.Run(prefix + "json_load"s, 1, [&input] {
+        istringstream in(input);
+        json::Load(in);
+    });
+    // Тот же документ из непрерывного буфера, как при --input с отображенным в память файлом
+    runner.Run(prefix + "json_load_buffer"s, 1, [&input] {
+        json::Load(string_view(input));
+    });
+
+    bench::NullBuffer null_buffer;
+    ostream null_stream(&null_buffer);
+
+    runner.Run(prefix + "parse_base_requests/"s + default_strategy, 1, [&input, &null_stream] {
+        istringstream in(input);
+        JsonReader reader(in, null_stream);
+        reader.ParseBaseRequests();
+    });
+
+    // Вывод документа размером со входной город с отступами и без них
+    const json::Document input_document = bench::MakeInputDocument(city, {}, default_strategy);
+    runner.Run(prefix + "json_print/indented"s, 1, [&input_document, &null_stream] {
+        json::Print(input_document, null_stream);
+    });
+    runner.Run(prefix + "json_print/minified"s, 1, [&input_document, &null_stream] {
+        json::Print(input_document, null_stream, json::PrintFormat::kMinified);
+    });
+
+    // Построение графа и роутера отдельно от разбора json
+    TransportCatalogue db;
+    bench::FillCatalogue(city, db);
+    for (const Strategy* strategy : strategies) {
+        const domain::dto::RoutingSettings routing_settings{.velocity = 40.0, .wait_time = 6, .strategy = strategy->value};
+        runner.Run(prefix + "transport_router_build/"s + strategy->name, 1, [&db, &routing_settings] {
+            TransportRouter router(db, routing_settings);
+        });
+    }
+
+    // То же построение в городе с переопределениями скорости автобусов и ожидания на остановках
+    bench::City overrides_city = city;
+    bench::AddRoutingOverrides(overrides_city);
+    TransportCatalogue overrides_db;
+    bench::FillCatalogue(overrides_city, overrides_db);
+    for (const Strategy* strategy : strategies) {
+        const domain::dto::RoutingSettings routing_settings{.velocity = 40.0, .wait_time = 6, .strategy = strategy->value};
+        runner.Run(prefix + "transport_router_build_overrides/"s + strategy->name, 1, [&overrides_db, &routing_settings] {
+            TransportRouter router(overrides_db, routing_settings);
+        });
+    }
+
+    // Поиск маршрута без разбора запросов и вывода ответа. Счетчик - просмотренные поиском вершины на запрос
+    const vector<pair<string, string>> route_pairs = GenerateRoutePairs(city, options.queries);
+    for (const Strategy* strategy : strategies) {
+        const string name = prefix + "route_search/"s + strategy->name;
+        if (!runner.IsSelected(name)) {
+            continue;
+        }
+        const domain::dto::RoutingSettings routing_settings{.velocity = 40.0, .wait_time = 6, .strategy = strategy->value};
+        const TransportRouter router(db, routing_settings);
+        graph::SearchStats stats;
+        runner.RunWithCounter(name, route_pairs.size(), stats.settled_vertices, [&router, &route_pairs, &stats] {
+            for (const auto& [from, to] : route_pairs) {
+                router.GetRoute(from, to, &stats);
+            }
+        });
+    }
+
+    // Поиск по расписанию (Connection Scan) в том же городе, где у каждого автобуса интервал движения 10 минут.
+    // Счетчик - просмотренные перегоны рейсов на запрос
+    bench::City timetable_city = city;
+    bench::AddTimetables(timetable_city, kTimetableHeadway);
+    if (const string name = prefix + "route_search_timetable"s; runner.IsSelected(name)) {
+        TransportCatalogue timetable_db;
+        bench::FillCatalogue(timetable_city, timetable_db);
+        const domain::dto::RoutingSettings routing_settings{.velocity = 40.0, .wait_time = 6, .strategy = strategies.front()->value};
+        const TransportRouter router(timetable_db, routing_settings);
+
+        mt19937_64 rng(7);
+        uniform_real_distribution<double> time_dist(6 * 60.0, 22 * 60.0);
+        vector<double> departure_times(route_pairs.size());
+        for (double& time : departure_times) {
+            time = time_dist(rng);
+        }
+
+        graph::SearchStats stats;
+        runner.RunWithCounter(name, route_pairs.size(), stats.settled_vertices, [&] {
+            for (size_t i = 0; i < route_pairs.size(); ++i) {
+                router.GetRouteAt(route_pairs[i].first, route_pairs[i].second, departure_times[i], &stats);
+            }
+        });
+    }
+
+    // Задержка одного запроса каждого типа, включая построение и вывод json-ответа, но без фонового построения роутера.
+    // Итерации повторяют один и тот же пакет, поэтому кэш ответов Route отключен, иначе замерялись бы только попадания
+    auto run_queries = [&](StatRequestType type, const string& name, size_t count, const string& strategy) {
+        if (!options.filter.empty() && name.find(options.filter) == string::npos) {
+            return;
+        }
+
+        auto stat_requests = bench::GenerateStatRequests(city, type, count, 7);
+        const string query_input = ToString(bench::MakeInputDocument(city, move(stat_requests), strategy, 0));
+        istringstream in(query_input);
+        JsonReader reader(in, null_stream);
+        reader.ParseBaseRequests();
+        reader.GetRequestHandler().WaitForRouter();
+
+        runner.Run(name, count, [&reader] {
+            reader.ParseStatRequests();
+        });
+    };
+
+    run_queries(StatRequestType::kBus, prefix + "query/Bus"s, options.queries, default_strategy);
+    run_queries(StatRequestType::kStop, prefix + "query/Stop"s, options.queries, default_strategy);
+    run_queries(StatRequestType::kBusSegment, prefix + "query/BusSegment"s, options.queries, default_strategy);
+    for (const Strategy* strategy : strategies) {
+        run_queries(StatRequestType::kRoute, prefix + "query/Route/"s + strategy->name, options.queries, strategy->name);
+    }
+    // Запросы Route из нескольких узлов: маршруты из одного узла ищутся одним поиском на пакет
+    for (const Strategy* strategy : strategies) {
+        const string name = prefix + "query/RouteHubs/"s + strategy->name;
+        if (!runner.IsSelected(name)) {
+            continue;
+        }
+        auto stat_requests = bench::GenerateStatRequests(city, StatRequestType::kRoute, options.queries, 7);
+        bench::ConcentrateRouteOrigins(stat_requests, kRouteHubCount, 7);
+        const string query_input = ToString(bench::MakeInputDocument(city, move(stat_requests), strategy->name, 0));
+        istringstream in(query_input);
+        JsonReader reader(in, null_stream);
+        reader.ParseBaseRequests();
+        reader.GetRequestHandler().WaitForRouter();
+
+        runner.Run(name, options.queries, [&reader] {
+            reader.ParseStatRequests();
+        });
+    }
+    // Повторяющиеся запросы Route с кэшем ответов. Счетчик - доля попаданий в кэш
+    if (const string name = prefix + "query/RouteCached/"s + default_strategy; runner.IsSelected(name)) {
+        auto stat_requests = bench::GenerateStatRequests(city, StatRequestType::kRoute, options.queries, 7);
+        const string query_input = ToString(bench::MakeInputDocument(city, move(stat_requests), default_strategy));
+        istringstream in(query_input);
+        JsonReader reader(in, null_stream);
+        reader.ParseBaseRequests();
+        reader.GetRequestHandler().WaitForRouter();
+
+        size_t hits = 0;
+        runner.RunWithCounter(name, options.queries, hits, [&reader, &hits] {
+            reader.ParseStatRequests();
+            hits = reader.GetRequestHandler().GetRouteCacheStats().hits;
+        });
+    }
+    // Route с "departure_time" по расписаниям автобусов, кэш ответов для таких запросов не используется
+    if (const string name = prefix + "query/RouteTimetable"s; runner.IsSelected(name)) {
+        auto stat_requests = bench::GenerateStatRequests(timetable_city, StatRequestType::kRoute, options.queries, 7);
+        bench::AddDepartureTimes(stat_requests, 7);
+        const string query_input = ToString(bench::MakeInputDocument(timetable_city, move(stat_requests), default_strategy, 0));
+        istringstream in(query_input);
+        JsonReader reader(in, null_stream);
+        reader.ParseBaseRequests();
+        reader.GetRequestHandler().WaitForRouter();
+
+        runner.Run(name, options.queries, [&reader] {
+            reader.ParseStatRequests();
+        });
+    }
+    // Поиск по раундам не зависит от стратегии. Счетчик - просмотренные позиции маршрутов на запрос
+    if (const string name = prefix + "route_search_pareto"s; runner.IsSelected(name)) {
+        const domain::dto::RoutingSettings routing_settings{.velocity = 40.0, .wait_time = 6, .strategy = strategies.front()->value};
+        const TransportRouter router(db, routing_settings);
+        graph::SearchStats stats;
+        runner.RunWithCounter(name, route_pairs.size(), stats.settled_vertices, [&router, &route_pairs, &stats] {
+            for (const auto& [from, to] : route_pairs) {
+                router.GetParetoRoutes(from, to, &stats);
+            }
+        });
+    }
+    run_queries(StatRequestType::kParetoRoute, prefix + "query/ParetoRoute"s, options.queries, default_strategy);
+    // Три альтернативы строятся двумя поисками, поэтому задержка сравнима с одним запросом Route
+    for (const Strategy* strategy : strategies) {
+        run_queries(StatRequestType::kAlternatives, prefix + "query/Alternatives/"s + strategy->name, options.queries,
+                    strategy->name);
+    }
+    // Матрица 20 x 20 - 400 пар остановок в одном запросе, поэтому пакет тоже меньше
+    for (const Strategy* strategy : strategies) {
+        run_queries(StatRequestType::kMatrix, prefix + "query/Matrix/"s + strategy->name,
+                    max<size_t>(1, options.queries / 20), strategy->name);
+    }
+    for (const Strategy* strategy : strategies) {
+        run_queries(StatRequestType::kIsochrone, prefix + "query/Isochrone/"s + strategy->name, options.queries,
+                    strategy->name);
+    }
+    // Обход всех структур каталога и роутера, пакет меньше, как для карты
+    for (const Strategy* strategy : strategies) {
+        run_queries(StatRequestType::kMemory, prefix + "query/Memory/"s + strategy->name,
+                    max<size_t>(1, options.queries / 20), strategy->name);
+    }
+    // Карта рендерится долго, поэтому для нее пакет меньше
+    run_queries(StatRequestType::kMap, prefix + "query/Map"s, max<size_t>(1, options.queries / 20), default_strategy);
+    // Та же карта, сжатая DEFLATE и выведенная в base64. Счетчик - байт ответа на запрос
+    if (const string name = prefix + "query/MapDeflate"s; runner.IsSelected(name)) {
+        const size_t count = max<size_t>(1, options.queries / 20);
+        auto stat_requests = bench::GenerateStatRequests(city, StatRequestType::kMap, count, 7);
+        for (auto& request : stat_requests) {
+            get<json::Dict>(request.GetValue()).emplace("compression"s, "deflate"s);
+        }
+        const string query_input = ToString(bench::MakeInputDocument(city, move(stat_requests), default_strategy, 0));
+        istringstream in(query_input);
+        ostringstream out;
+        JsonReader reader(in, out);
+        reader.ParseBaseRequests();
+
+        size_t response_bytes = 0;
+        runner.RunWithCounter(name, count, response_bytes, [&reader, &out, &response_bytes] {
+            out.str({});
+            reader.ParseStatRequests();
+            response_bytes += out.str().size();
+        });
+    }
+
+    // Двоичный протокол на пакете запросов Route: кодирование и декодирование кадров (счетчик - байт в кадре запроса)
+    // и ответы BinaryReader, которые сравниваются с query/Route той же стратегии
+    const json::Array binary_source = bench::GenerateStatRequests(city, StatRequestType::kRoute, options.queries, 7);
+    const vector<binary::StatRequest> binary_requests = ToBinaryRequests(binary_source);
+    size_t request_bytes = 0;
+    runner.RunWithCounter(prefix + "binary/encode_requests"s, binary_requests.size(), request_bytes, [&] {
+        binary::Writer writer;
+        for (const auto& request : binary_requests) {
+            writer.Clear();
+            binary::EncodeRequest(request, writer);
+            request_bytes += writer.GetData().size();
+        }
+    });
+
+    ostringstream frames_output;
+    binary::Writer frame_writer;
+    for (const auto& request : binary_requests) {
+        frame_writer.Clear();
+        binary::EncodeRequest(request, frame_writer);
+        binary::WriteFrame(frames_output, frame_writer.GetData());
+    }
+    const string frames = frames_output.str();
+    runner.Run(prefix + "binary/decode_requests"s, binary_requests.size(), [&frames] {
+        istringstream in(frames);
+        string payload;
+        while (binary::ReadFrame(in, payload)) {
+            binary::Reader reader(payload);
+            binary::DecodeRequest(reader);
+        }
+    });
+
+    if (const string name = prefix + "query/RouteBinary/"s + default_strategy; runner.IsSelected(name)) {
+        istringstream in(input);
+        JsonReader reader(in, null_stream);
+        reader.ParseBaseRequests();
+        reader.GetRequestHandler().WaitForRouter();
+        runner.Run(name, binary_requests.size(), [&] {
+            istringstream frames_input(frames);
+            BinaryReader(reader.GetRequestHandler(), frames_input, null_stream).ParseStatRequests();
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // --check - проверки корректности вместо замеров (в том числе из ctest)
+    if (argc == 2 && argv[1] == "--check"sv) {
+        return bench::RunChecks(cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    const Options options = ParseOptions(argc, argv);
+    Runner runner(options);
+
+    for (const auto& scale : GetScales()) {
+        if (scale.params.stop_count > options.max_stops) {
+            continue;
+        }
+        RunScale(runner, options, scale);
+    }
+}
@@ -0,0 +1,265 @@
+#include "binary_protocol.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+#include <variant>
+
+using namespace std;
+using requests::StatRequestType;
+
+namespace binary {
+
+namespace {
+
+// varint uint64_t занимает не больше 10 байт
+constexpr int kMaxVarintBytes = 10;
+// Нагрузка кадра читается частями такого размера
+constexpr size_t kFrameReadChunk = 1 << 20;
+
+uint64_t ZigZagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void WriteHeader(int id, ResponseStatus status, Writer& writer) {
+    writer.WriteSigned(id);
+    writer.WriteByte(static_cast<uint8_t>(status));
+}
+
+} // namespace
+
+void Writer::WriteVarint(uint64_t value) {
+    while (value >= 0x80) {
+        buffer_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer_.push_back(static_cast<char>(value));
+}
+
+void Writer::WriteSigned(int64_t value) {
+    WriteVarint(ZigZagEncode(value));
+}
+
+void Writer::WriteByte(uint8_t value) {
+    buffer_.push_back(static_cast<char>(value));
+}
+
+void Writer::WriteDouble(double value) {
+    // Порядок байт фиксирован, поэтому кадр одинаково читается на любой платформе
+    const auto bits = bit_cast<uint64_t>(value);
+    for (int shift = 0; shift < 64; shift += 8) {
+        buffer_.push_back(static_cast<char>((bits >> shift) & 0xFF));
+    }
+}
+
+void Writer::WriteString(string_view value) {
+    WriteVarint(value.size());
+    buffer_.append(value);
+}
+
+uint64_t Reader::ReadVarint() {
+    uint64_t result = 0;
+    for (int i = 0; i < kMaxVarintBytes; ++i) {
+        const uint8_t byte = ReadByte();
+        result |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            return result;
+        }
+    }
+    throw runtime_error("Malformed varint in binary frame");
+}
+
+int64_t Reader::ReadSigned() {
+    return ZigZagDecode(ReadVarint());
+}
+
+uint8_t Reader::ReadByte() {
+    Require(1);
+    return static_cast<uint8_t>(data_[pos_++]);
+}
+
+double Reader::ReadDouble() {
+    Require(8);
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_ + i])) << (8 * i);
+    }
+    pos_ += 8;
+    return bit_cast<double>(bits);
+}
+
+string_view Reader::ReadString() {
+    const uint64_t size = ReadVarint();
+    Require(size);
+    string_view result = data_.substr(pos_, size);
+    pos_ += size;
+    return result;
+}
+
+void Reader::Require(size_t size) const {
+    if (data_.size() - pos_ < size) {
+        throw runtime_error("Unexpected end of binary frame");
+    }
+}
+
+bool ReadFrame(istream& input, string& payload) {
+    // Длина кадра читается по байту, сама нагрузка - одним read
+    uint64_t size = 0;
+    for (int i = 0;; ++i) {
+        const int byte = input.get();
+        if (byte == char_traits<char>::eof()) {
+            if (i == 0) {
+                return false;
+            }
+            throw runtime_error("Unexpected end of input inside binary frame length");
+        }
+        if (i == kMaxVarintBytes) {
+            throw runtime_error("Malformed binary frame length");
+        }
+        size |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    if (size > kMaxFrameSize) {
+        throw runtime_error("Malformed binary frame length");
+    }
+
+    // Нагрузка растет по мере чтения, поэтому оборванный кадр с большой длиной не выделяет всю память сразу
+    payload.clear();
+    while (payload.size() < size) {
+        const size_t read_from = payload.size();
+        payload.resize(read_from + min<size_t>(size - read_from, kFrameReadChunk));
+        if (!input.read(payload.data() + read_from, static_cast<streamsize>(payload.size() - read_from))) {
+            throw runtime_error("Unexpected end of input inside binary frame");
+        }
+    }
+    return true;
+}
+
+void WriteFrame(ostream& output, string_view payload) {
+    if (payload.size() > kMaxFrameSize) {
+        throw length_error("Binary frame is too large");
+    }
+    Writer header;
+    header.WriteVarint(payload.size());
+    const string_view header_data = header.GetData();
+    output.write(header_data.data(), static_cast<streamsize>(header_data.size()));
+    output.write(payload.data(), static_cast<streamsize>(payload.size()));
+}
+
+void EncodeRequest(const StatRequest& request, Writer& writer) {
+    writer.WriteSigned(request.id);
+    writer.WriteVarint(static_cast<uint64_t>(request.type));
+    switch (request.type) {
+        case StatRequestType::kStop:
+        case StatRequestType::kBus:
+            writer.WriteString(request.name);
+            break;
+        case StatRequestType::kRoute:
+            writer.WriteString(request.from);
+            writer.WriteString(request.to);
+            writer.WriteByte(request.departure_time.has_value());
+            if (request.departure_time) {
+                writer.WriteDouble(*request.departure_time);
+            }
+            break;
+        case StatRequestType::kMap:
+            // Без сжатия кадр остается прежним
+            if (request.compress_map) {
+                writer.WriteByte(1);
+            }
+            break;
+        default:
+            throw invalid_argument("Request type is not supported by binary protocol");
+    }
+}
+
+StatRequest DecodeRequest(Reader& reader) {
+    StatRequest request;
+    const int64_t id = reader.ReadSigned();
+    if (id < numeric_limits<int>::min() || id > numeric_limits<int>::max()) {
+        throw runtime_error("Request id " + to_string(id) + " in binary frame is out of int range");
+    }
+    request.id = static_cast<int>(id);
+    const uint64_t type = reader.ReadVarint();
+    if (type >= static_cast<uint64_t>(StatRequestType::kCount)) {
+        throw runtime_error("Unknown request type " + to_string(type) + " in binary frame");
+    }
+    request.type = static_cast<StatRequestType>(type);
+
+    switch (request.type) {
+        case StatRequestType::kStop:
+        case StatRequestType::kBus:
+            request.name = reader.ReadString();
+            break;
+        case StatRequestType::kRoute:
+            request.from = reader.ReadString();
+            request.to = reader.ReadString();
+            if (reader.ReadByte()) {
+                request.departure_time = reader.ReadDouble();
+            }
+            break;
+        case StatRequestType::kMap:
+            if (!reader.IsEnd()) {
+                request.compress_map = reader.ReadByte() != 0;
+            }
+            break;
+        default:
+            throw runtime_error("Request type " + to_string(type) + " is not supported by binary protocol");
+    }
+    return request;
+}
+
+void EncodeNotFound(int id, Writer& writer) {
+    WriteHeader(id, ResponseStatus::kNotFound, writer);
+}
+
+void EncodeStopResponse(int id, const vector<string_view>& buses, Writer& writer) {
+    WriteHeader(id, ResponseStatus::kOk, writer);
+    writer.WriteVarint(buses.size());
+    for (string_view bus : buses) {
+        writer.WriteString(bus);
+    }
+}
+
+void EncodeBusResponse(int id, const domain::BusStat& stat, Writer& writer) {
+    WriteHeader(id, ResponseStatus::kOk, writer);
+    writer.WriteVarint(static_cast<uint64_t>(stat.road_distance));
+    writer.WriteDouble(stat.road_distance / stat.geo_distance);
+    writer.WriteVarint(static_cast<uint64_t>(stat.stop_count));
+    writer.WriteVarint(static_cast<uint64_t>(stat.uniq_stops));
+}
+
+void EncodeRouteResponse(int id, const domain::dto::RouteResponse& route, Writer& writer) {
+    WriteHeader(id, ResponseStatus::kOk, writer);
+    writer.WriteDouble(route.total_time);
+    writer.WriteVarint(route.items.size());
+    for (const auto& route_item : route.items) {
+        visit([&writer](const auto& item) {
+            using Type = decay_t<decltype(item)>;
+            if constexpr (is_same_v<Type, domain::dto::Waiting>) {
+                writer.WriteByte(static_cast<uint8_t>(RouteItemKind::kWait));
+                writer.WriteString(item.stop_name);
+                writer.WriteDouble(item.time);
+            } else {
+                writer.WriteByte(static_cast<uint8_t>(RouteItemKind::kBus));
+                writer.WriteString(item.bus);
+                writer.WriteDouble(item.time);
+                writer.WriteVarint(static_cast<uint64_t>(item.span_count));
+            }
+        }, route_item);
+    }
+}
+
+void EncodeMapResponse(int id, string_view map, Writer& writer) {
+    WriteHeader(id, ResponseStatus::kOk, writer);
+    writer.WriteString(map);
+}
+
+} // namespace binary
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "domain.h"
+#include "request_types.h"
+
+/**
+ * Компактный двоичный протокол запросов Stop, Bus, Route и Map для обмена между сервисами.
+ *
+ * Поток - последовательность кадров: длина нагрузки (varint) и сама нагрузка. Первый кадр входного потока - json-документ
+ * с base_requests, render_settings и routing_settings (stat_requests в нем не обрабатываются), каждый следующий - один
+ * запрос. На каждый запрос выводится один кадр ответа в том же порядке.
+ *
+ * Целые без знака - varint (по 7 бит в байте, старший бит - признак продолжения), целые со знаком - zigzag и varint,
+ * double - 8 байт IEEE 754 little-endian, строка - длина (varint) и байты.
+ *
+ * Запрос: id (со знаком), тип (varint, значение StatRequestType) и поля типа:
+ *   Stop, Bus - name; Route - from, to, байт 1 и departure_time, если время отправления задано, иначе байт 0;
+ *   Map - полей нет или байт 1, если карта нужна сжатой DEFLATE (без него - байт 0 или конец нагрузки).
+ * Ответ: id (со знаком), статус (байт ResponseStatus) и при kOk поля типа запроса:
+ *   Stop - количество автобусов и их названия по возрастанию;
+ *   Bus - route_length, curvature (double), stop_count, unique_stop_count;
+ *   Route - total_time (double), количество шагов и шаги: вид (байт RouteItemKind), затем
+ *           для Wait - stop_name и time (double), для Bus - bus, time (double) и span_count;
+ *   Map - svg-документ или, со сжатием, его поток DEFLATE (RFC 1951) без заголовков zlib.
+ */
+namespace binary {
+
+enum class ResponseStatus : uint8_t {
+    kOk = 0,
+    kNotFound = 1,
+};
+
+enum class RouteItemKind : uint8_t {
+    kWait = 0,
+    kBus = 1,
+};
+
+// Кодирует значения в конец буфера. Буфер переиспользуется между кадрами, поэтому память выделяется один раз
+class Writer {
+public:
+    void WriteVarint(uint64_t value);
+    void WriteSigned(int64_t value);
+    void WriteByte(uint8_t value);
+    void WriteDouble(double value);
+    void WriteString(std::string_view value);
+
+    std::string_view GetData() const noexcept {
+        return buffer_;
+    }
+
+    void Clear() noexcept {
+        buffer_.clear();
+    }
+
+private:
+    std::string buffer_;
+};
+
+// Читает значения из нагрузки кадра. При выходе за конец нагрузки или слишком длинном varint бросает std::runtime_error
+class Reader {
+public:
+    explicit Reader(std::string_view data) : data_(data) {}
+
+    uint64_t ReadVarint();
+    int64_t ReadSigned();
+    uint8_t ReadByte();
+    double ReadDouble();
+    // Строка ссылается на нагрузку и действительна, пока жива нагрузка
+    std::string_view ReadString();
+
+    bool IsEnd() const noexcept {
+        return pos_ == data_.size();
+    }
+
+private:
+    std::string_view data_;
+    size_t pos_ = 0;
+
+    void Require(size_t size) const;
+};
+
+// Наибольшая длина нагрузки кадра. Ее хватает на json-документ большого города в первом кадре
+inline constexpr size_t kMaxFrameSize = size_t{1} << 30;
+
+// Читает следующий кадр в `payload`. false - поток закончился перед кадром, обрыв внутри кадра или длина больше
+// kMaxFrameSize - std::runtime_error
+bool ReadFrame(std::istream& input, std::string& payload);
+// Нагрузка длиннее kMaxFrameSize - std::length_error
+void WriteFrame(std::ostream& output, std::string_view payload);
+
+// Строки запроса ссылаются на нагрузку кадра, из которого он декодирован
+struct StatRequest {
+    int id = 0;
+    requests::StatRequestType type = requests::StatRequestType::kStop;
+    std::string_view name;      // Stop, Bus
+    std::string_view from;      // Route
+    std::string_view to;
+    std::optional<double> departure_time;
+    bool compress_map = false;  // Map
+};
+
+void EncodeRequest(const StatRequest& request, Writer& writer);
+// Запросы других типов протокол не поддерживает, id вне диапазона int - std::runtime_error
+StatRequest DecodeRequest(Reader& reader);
+
+void EncodeNotFound(int id, Writer& writer);
+// `buses` - названия автобусов по возрастанию
+void EncodeStopResponse(int id, const std::vector<std::string_view>& buses, Writer& writer);
+void EncodeBusResponse(int id, const domain::BusStat& stat, Writer& writer);
+void EncodeRouteResponse(int id, const domain::dto::RouteResponse& route, Writer& writer);
+// `map` - svg-документ или его сжатый поток, если в запросе было сжатие
+void EncodeMapResponse(int id, std::string_view map, Writer& writer);
+
+} // namespace binary
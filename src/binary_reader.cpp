@@ -0,0 +1,77 @@
+#include "binary_reader.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "instrumentation.h"
+
+using namespace std;
+using requests::StatRequestType;
+
+BinaryReader::BinaryReader(const RequestHandler& handler, istream& input, ostream& output)
+    : handler_(handler), input_(input), output_(output) {
+}
+
+void BinaryReader::ParseStatRequests() {
+    TC_SCOPED_TIMER("binary_requests.total");
+    // Буферы кадров переиспользуются, поэтому в установившемся режиме запрос не выделяет память под кадры
+    string payload;
+    binary::Writer writer;
+    while (binary::ReadFrame(input_, payload)) {
+        binary::Reader reader(payload);
+        const binary::StatRequest request = binary::DecodeRequest(reader);
+        if (!reader.IsEnd()) {
+            throw runtime_error("Unexpected trailing bytes in binary request frame");
+        }
+
+        writer.Clear();
+        HandleStatRequest(request, writer);
+        binary::WriteFrame(output_, writer.GetData());
+    }
+    output_.flush();
+}
+
+void BinaryReader::HandleStatRequest(const binary::StatRequest& request, binary::Writer& writer) const {
+    switch (request.type) {
+        case StatRequestType::kStop: {
+            const auto buses_table = handler_.GetStopStat(request.name);
+            if (!buses_table.has_value()) {
+                binary::EncodeNotFound(request.id, writer);
+                return;
+            }
+            vector<string_view> buses;
+            buses.reserve(buses_table->size());
+            for (const auto bus_ptr : *buses_table) {
+                buses.push_back(bus_ptr->name);
+            }
+            sort(buses.begin(), buses.end());
+            binary::EncodeStopResponse(request.id, buses, writer);
+            return;
+        }
+        case StatRequestType::kBus: {
+            const auto stat = handler_.GetBusStat(request.name);
+            if (!stat.has_value()) {
+                binary::EncodeNotFound(request.id, writer);
+                return;
+            }
+            binary::EncodeBusResponse(request.id, *stat, writer);
+            return;
+        }
+        case StatRequestType::kRoute: {
+            const auto route = handler_.BuildRoute(request.from, request.to, request.departure_time);
+            if (!route.has_value()) {
+                binary::EncodeNotFound(request.id, writer);
+                return;
+            }
+            binary::EncodeRouteResponse(request.id, *route, writer);
+            return;
+        }
+        case StatRequestType::kMap:
+            binary::EncodeMapResponse(request.id, request.compress_map ? handler_.RenderCompressedMap() : handler_.RenderMap(),
+                                      writer);
+            return;
+        default:
+            throw runtime_error("Request type is not supported by binary protocol");
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iostream>
+
+#include "binary_protocol.h"
+#include "request_handler.h"
+
+/**
+ * Обработчик запросов двоичного протокола (binary_protocol.h). Каталог, рендер и маршрутизатор общие с JsonReader:
+ * BinaryReader только декодирует кадры запросов и кодирует ответы, а сами ответы строит RequestHandler
+ */
+class BinaryReader {
+public:
+    BinaryReader(const RequestHandler& handler, std::istream& input, std::ostream& output);
+    BinaryReader(const BinaryReader&) = delete;
+    BinaryReader& operator=(const BinaryReader&) = delete;
+
+    // Отвечает на кадры запросов до конца входного потока
+    void ParseStatRequests();
+
+    // Кодирует ответ на один запрос в `writer`
+    void HandleStatRequest(const binary::StatRequest& request, binary::Writer& writer) const;
+
+private:
+    const RequestHandler& handler_;
+    std::istream& input_;
+    std::ostream& output_;
+};
@@ -0,0 +1,430 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace compression {
+
+namespace {
+
+constexpr size_t kWindowSize = 1 << 15;
+constexpr size_t kMinMatch = 3;
+constexpr size_t kMaxMatch = 258;
+constexpr int kHashBits = 15;
+constexpr int kMaxChain = 32;
+// Символов в одном блоке: коды Хаффмана подстраиваются под участок данных, а заголовок блока окупается
+constexpr size_t kBlockSymbols = 1 << 14;
+
+constexpr size_t kLiteralCodes = 286;
+constexpr size_t kDistanceCodes = 30;
+constexpr size_t kCodeLengthCodes = 19;
+constexpr uint16_t kEndOfBlock = 256;
+constexpr int kMaxCodeLength = 15;
+constexpr int kMaxCodeLengthCodeLength = 7;
+
+// Длины повторов 3..258 и расстояния 1..32768: базовое значение кода и количество дополнительных бит (RFC 1951, 3.2.5)
+constexpr array<uint16_t, 29> kLengthBase = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                             35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr array<uint8_t, 29> kLengthExtra = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                             3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr array<uint16_t, 30> kDistanceBase = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                               513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr array<uint8_t, 30> kDistanceExtra = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                               7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Порядок, в котором в заголовке блока записываются длины кодов для длин кодов
+constexpr array<uint8_t, kCodeLengthCodes> kCodeLengthOrder = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2,
+                                                               14, 1, 15};
+
+// Индекс кода в таблице базовых значений: последний код, база которого не больше значения
+template <size_t N>
+size_t FindCode(const array<uint16_t, N>& base, size_t value) {
+    return static_cast<size_t>(upper_bound(base.begin(), base.end(), value) - base.begin()) - 1;
+}
+
+/**
+ * Длины кодов Хаффмана не длиннее `limit` для частот `freq`. Если дерево получается глубже, частоты уменьшаются вдвое
+ * и дерево строится заново. Используемых кодов всегда не меньше двух, чтобы код был полным - так его примет любой декодер
+ */
+vector<uint8_t> BuildCodeLengths(const vector<uint32_t>& freq, int limit) {
+    vector<uint8_t> lengths(freq.size(), 0);
+    vector<size_t> used;
+    for (size_t i = 0; i < freq.size(); ++i) {
+        if (freq[i] > 0) {
+            used.push_back(i);
+        }
+    }
+    for (size_t i = 0; used.size() < 2; ++i) {
+        if (freq[i] == 0) {
+            used.push_back(i);
+        }
+    }
+    if (used.size() == 2) {
+        lengths[used[0]] = lengths[used[1]] = 1;
+        return lengths;
+    }
+
+    vector<uint64_t> weights(used.size());
+    for (size_t i = 0; i < used.size(); ++i) {
+        weights[i] = freq[used[i]];
+    }
+
+    for (;;) {
+        // Листья - узлы [0, used.size()), внутренние узлы добавляются следом, корень - последний
+        vector<size_t> parent(2 * used.size() - 1, 0);
+        using Item = pair<uint64_t, size_t>;
+        priority_queue<Item, vector<Item>, greater<Item>> queue;
+        for (size_t i = 0; i < used.size(); ++i) {
+            queue.emplace(weights[i], i);
+        }
+        size_t next_node = used.size();
+        while (queue.size() > 1) {
+            const auto [lhs_weight, lhs] = queue.top();
+            queue.pop();
+            const auto [rhs_weight, rhs] = queue.top();
+            queue.pop();
+            parent[lhs] = parent[rhs] = next_node;
+            queue.emplace(lhs_weight + rhs_weight, next_node++);
+        }
+
+        // Родитель создан позже потомка, поэтому глубины считаются одним проходом от корня
+        vector<int> depth(parent.size(), 0);
+        int max_depth = 0;
+        for (size_t node = parent.size() - 1; node-- > 0;) {
+            depth[node] = depth[parent[node]] + 1;
+            max_depth = max(max_depth, depth[node]);
+        }
+        if (max_depth <= limit) {
+            for (size_t i = 0; i < used.size(); ++i) {
+                lengths[used[i]] = static_cast<uint8_t>(depth[i]);
+            }
+            return lengths;
+        }
+        for (auto& weight : weights) {
+            weight = (weight >> 1) | 1;
+        }
+    }
+}
+
+// Канонические коды по длинам (RFC 1951, 3.2.2). Биты кода развернуты, т.к. коды выводятся начиная со старшего бита
+vector<uint16_t> BuildCodes(const vector<uint8_t>& lengths) {
+    array<uint16_t, kMaxCodeLength + 1> length_count{};
+    for (uint8_t length : lengths) {
+        ++length_count[length];
+    }
+    length_count[0] = 0;
+
+    array<uint16_t, kMaxCodeLength + 1> next_code{};
+    uint16_t code = 0;
+    for (int bits = 1; bits <= kMaxCodeLength; ++bits) {
+        code = static_cast<uint16_t>((code + length_count[bits - 1]) << 1);
+        next_code[bits] = code;
+    }
+
+    vector<uint16_t> codes(lengths.size(), 0);
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        const int length = lengths[i];
+        if (length == 0) {
+            continue;
+        }
+        const uint16_t value = next_code[length]++;
+        uint16_t reversed = 0;
+        for (int bit = 0; bit < length; ++bit) {
+            reversed = static_cast<uint16_t>(reversed | (((value >> bit) & 1) << (length - 1 - bit)));
+        }
+        codes[i] = reversed;
+    }
+    return codes;
+}
+
+// Длины кодов литералов и расстояний, сжатые повторами: символ кода длин и значение его дополнительных бит
+vector<pair<uint8_t, uint8_t>> EncodeCodeLengths(const vector<uint8_t>& lengths) {
+    vector<pair<uint8_t, uint8_t>> result;
+    for (size_t i = 0; i < lengths.size();) {
+        const uint8_t length = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == length) {
+            ++run;
+        }
+        i += run;
+
+        if (length == 0) {
+            while (run >= 11) {
+                const size_t count = min<size_t>(run, 138);
+                result.emplace_back(18, static_cast<uint8_t>(count - 11));
+                run -= count;
+            }
+            if (run >= 3) {
+                result.emplace_back(17, static_cast<uint8_t>(run - 3));
+                run = 0;
+            }
+        } else {
+            result.emplace_back(length, 0);
+            --run;
+            while (run >= 3) {
+                const size_t count = min<size_t>(run, 6);
+                result.emplace_back(16, static_cast<uint8_t>(count - 3));
+                run -= count;
+            }
+        }
+        for (; run > 0; --run) {
+            result.emplace_back(length, 0);
+        }
+    }
+    return result;
+}
+
+uint32_t Hash(const char* data) {
+    const uint32_t value = static_cast<uint8_t>(data[0]) | (static_cast<uint8_t>(data[1]) << 8)
+                           | (static_cast<uint8_t>(data[2]) << 16);
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+} // namespace
+
+DeflateEncoder::DeflateEncoder(string& output)
+    : output_(output), head_(size_t{1} << kHashBits, -1), prev_(kWindowSize, -1) {
+    symbols_.reserve(kBlockSymbols);
+}
+
+void DeflateEncoder::Write(string_view data) {
+    if (finished_) {
+        throw logic_error("Deflate stream is already finished");
+    }
+    window_.append(data);
+    Compress(false);
+}
+
+void DeflateEncoder::Finish() {
+    if (finished_) {
+        return;
+    }
+    Compress(true);
+    WriteBlock(true);
+    if (bit_count_ > 0) {
+        output_.push_back(static_cast<char>(bit_buffer_ & 0xFF));
+        bit_buffer_ = 0;
+        bit_count_ = 0;
+    }
+    finished_ = true;
+}
+
+void DeflateEncoder::Compress(bool flush) {
+    // Без `flush` позиция сжимается, только когда за ней есть байты на повтор максимальной длины
+    const size_t limit = flush ? window_.size() : (window_.size() > kMaxMatch ? window_.size() - kMaxMatch : 0);
+    while (pos_ < limit) {
+        const size_t available = window_.size() - pos_;
+        const Match match = available >= kMinMatch ? FindMatch(pos_, min(available, kMaxMatch)) : Match{};
+        if (match.length >= kMinMatch) {
+            symbols_.push_back({static_cast<uint16_t>(match.length), static_cast<uint16_t>(match.distance)});
+            for (size_t i = 0; i < match.length; ++i) {
+                Insert(pos_ + i);
+            }
+            pos_ += match.length;
+        } else {
+            symbols_.push_back({static_cast<uint8_t>(window_[pos_]), 0});
+            Insert(pos_);
+            ++pos_;
+        }
+        if (symbols_.size() == kBlockSymbols) {
+            WriteBlock(false);
+        }
+    }
+
+    // Сдвиг окна: байты дальше окна от текущей позиции больше не нужны
+    if (pos_ > 2 * kWindowSize) {
+        const size_t drop = pos_ - kWindowSize;
+        window_.erase(0, drop);
+        pos_ -= drop;
+        window_base_ += static_cast<int64_t>(drop);
+    }
+}
+
+DeflateEncoder::Match DeflateEncoder::FindMatch(size_t pos, size_t max_length) const {
+    const int64_t position = window_base_ + static_cast<int64_t>(pos);
+    const char* current = window_.data() + pos;
+    Match best;
+    int64_t candidate = head_[Hash(current)];
+    for (int chain = kMaxChain; candidate >= 0 && position - candidate <= static_cast<int64_t>(kWindowSize) && chain > 0;
+         --chain) {
+        const char* previous = window_.data() + (candidate - window_base_);
+        // Кандидат длиннее лучшего повтора только при совпадении следующего за ним байта
+        if (previous[best.length] == current[best.length]) {
+            size_t length = 0;
+            while (length < max_length && previous[length] == current[length]) {
+                ++length;
+            }
+            if (length > best.length) {
+                best = {length, static_cast<size_t>(position - candidate)};
+                if (length == max_length) {
+                    break;
+                }
+            }
+        }
+        const int64_t next = prev_[static_cast<size_t>(candidate) & (kWindowSize - 1)];
+        if (next >= candidate) {
+            break;
+        }
+        candidate = next;
+    }
+    return best;
+}
+
+void DeflateEncoder::Insert(size_t pos) {
+    if (pos + kMinMatch > window_.size()) {
+        return;
+    }
+    const int64_t position = window_base_ + static_cast<int64_t>(pos);
+    auto& head = head_[Hash(window_.data() + pos)];
+    prev_[static_cast<size_t>(position) & (kWindowSize - 1)] = head;
+    head = position;
+}
+
+void DeflateEncoder::WriteBlock(bool final) {
+    vector<uint32_t> literal_freq(kLiteralCodes, 0);
+    vector<uint32_t> distance_freq(kDistanceCodes, 0);
+    for (const auto [value, distance] : symbols_) {
+        if (distance == 0) {
+            ++literal_freq[value];
+        } else {
+            ++literal_freq[kEndOfBlock + 1 + FindCode(kLengthBase, value)];
+            ++distance_freq[FindCode(kDistanceBase, distance)];
+        }
+    }
+    literal_freq[kEndOfBlock] = 1;
+
+    const auto literal_lengths = BuildCodeLengths(literal_freq, kMaxCodeLength);
+    const auto distance_lengths = BuildCodeLengths(distance_freq, kMaxCodeLength);
+    const auto literal_codes = BuildCodes(literal_lengths);
+    const auto distance_codes = BuildCodes(distance_lengths);
+
+    size_t literal_count = kLiteralCodes;
+    while (literal_count > 257 && literal_lengths[literal_count - 1] == 0) {
+        --literal_count;
+    }
+    size_t distance_count = kDistanceCodes;
+    while (distance_count > 1 && distance_lengths[distance_count - 1] == 0) {
+        --distance_count;
+    }
+
+    // Длины кодов литералов и расстояний записываются одной последовательностью, сжатой своим кодом Хаффмана
+    vector<uint8_t> all_lengths(literal_lengths.begin(), literal_lengths.begin() + static_cast<ptrdiff_t>(literal_count));
+    all_lengths.insert(all_lengths.end(), distance_lengths.begin(),
+                       distance_lengths.begin() + static_cast<ptrdiff_t>(distance_count));
+    const auto encoded_lengths = EncodeCodeLengths(all_lengths);
+    vector<uint32_t> length_freq(kCodeLengthCodes, 0);
+    for (const auto& [code, extra] : encoded_lengths) {
+        ++length_freq[code];
+    }
+    const auto length_lengths = BuildCodeLengths(length_freq, kMaxCodeLengthCodeLength);
+    const auto length_codes = BuildCodes(length_lengths);
+    size_t length_count = kCodeLengthCodes;
+    while (length_count > 4 && length_lengths[kCodeLengthOrder[length_count - 1]] == 0) {
+        --length_count;
+    }
+
+    // Заголовок блока с динамическими кодами
+    WriteBits(final ? 1 : 0, 1);
+    WriteBits(2, 2);
+    WriteBits(static_cast<uint32_t>(literal_count - 257), 5);
+    WriteBits(static_cast<uint32_t>(distance_count - 1), 5);
+    WriteBits(static_cast<uint32_t>(length_count - 4), 4);
+    for (size_t i = 0; i < length_count; ++i) {
+        WriteBits(length_lengths[kCodeLengthOrder[i]], 3);
+    }
+    for (const auto& [code, extra] : encoded_lengths) {
+        WriteBits(length_codes[code], length_lengths[code]);
+        if (code == 16) {
+            WriteBits(extra, 2);
+        } else if (code == 17) {
+            WriteBits(extra, 3);
+        } else if (code == 18) {
+            WriteBits(extra, 7);
+        }
+    }
+
+    for (const auto [value, distance] : symbols_) {
+        if (distance == 0) {
+            WriteBits(literal_codes[value], literal_lengths[value]);
+            continue;
+        }
+        const size_t length_code = FindCode(kLengthBase, value);
+        const size_t literal = kEndOfBlock + 1 + length_code;
+        WriteBits(literal_codes[literal], literal_lengths[literal]);
+        WriteBits(value - kLengthBase[length_code], kLengthExtra[length_code]);
+        const size_t distance_code = FindCode(kDistanceBase, distance);
+        WriteBits(distance_codes[distance_code], distance_lengths[distance_code]);
+        WriteBits(distance - kDistanceBase[distance_code], kDistanceExtra[distance_code]);
+    }
+    WriteBits(literal_codes[kEndOfBlock], literal_lengths[kEndOfBlock]);
+    symbols_.clear();
+}
+
+void DeflateEncoder::WriteBits(uint32_t bits, int count) {
+    // Биты упаковываются начиная с младшего
+    bit_buffer_ |= static_cast<uint64_t>(bits) << bit_count_;
+    bit_count_ += count;
+    while (bit_count_ >= 8) {
+        output_.push_back(static_cast<char>(bit_buffer_ & 0xFF));
+        bit_buffer_ >>= 8;
+        bit_count_ -= 8;
+    }
+}
+
+DeflateBuffer::DeflateBuffer(string& output) : encoder_(output) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+void DeflateBuffer::Finish() {
+    FlushBuffer();
+    encoder_.Finish();
+}
+
+DeflateBuffer::int_type DeflateBuffer::overflow(int_type ch) {
+    FlushBuffer();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+void DeflateBuffer::FlushBuffer() {
+    encoder_.Write({pbase(), static_cast<size_t>(pptr() - pbase())});
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+string EncodeBase64(string_view data) {
+    static constexpr string_view kAlphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string result;
+    result.reserve((data.size() + 2) / 3 * 4);
+
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        const uint32_t chunk = (static_cast<uint8_t>(data[i]) << 16) | (static_cast<uint8_t>(data[i + 1]) << 8)
+                               | static_cast<uint8_t>(data[i + 2]);
+        result.push_back(kAlphabet[(chunk >> 18) & 0x3F]);
+        result.push_back(kAlphabet[(chunk >> 12) & 0x3F]);
+        result.push_back(kAlphabet[(chunk >> 6) & 0x3F]);
+        result.push_back(kAlphabet[chunk & 0x3F]);
+    }
+
+    // Последние 1 или 2 байта дополняются знаками '='
+    if (const size_t rest = data.size() - i; rest > 0) {
+        uint32_t chunk = static_cast<uint8_t>(data[i]) << 16;
+        if (rest == 2) {
+            chunk |= static_cast<uint8_t>(data[i + 1]) << 8;
+        }
+        result.push_back(kAlphabet[(chunk >> 18) & 0x3F]);
+        result.push_back(kAlphabet[(chunk >> 12) & 0x3F]);
+        result.push_back(rest == 2 ? kAlphabet[(chunk >> 6) & 0x3F] : '=');
+        result.push_back('=');
+    }
+    return result;
+}
+
+} // namespace compression
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Сжатие ответов без сторонних библиотек: DEFLATE (RFC 1951) и base64 (RFC 4648)
+ */
+namespace compression {
+
+/**
+ * Потоковый кодировщик DEFLATE. Данные подаются частями через Write, повторы ищутся жадно в окне 32 КиБ по цепочкам
+ * позиций с одинаковым хэшем трех байт, а каждые kBlockSymbols символов выводятся блоком с динамическими кодами Хаффмана.
+ * Памяти нужно на окно и один блок независимо от объема данных. Результат - "сырой" DEFLATE без заголовков zlib и gzip
+ */
+class DeflateEncoder {
+public:
+    explicit DeflateEncoder(std::string& output);
+
+    void Write(std::string_view data);
+    // Сжимает оставшиеся данные и завершает поток последним блоком. После Finish писать нельзя
+    void Finish();
+
+private:
+    // Литерал (distance == 0) или повтор длины value на расстоянии distance
+    struct Symbol {
+        uint16_t value;
+        uint16_t distance;
+    };
+
+    struct Match {
+        size_t length = 0;
+        size_t distance = 0;
+    };
+
+    std::string& output_;
+    uint64_t bit_buffer_ = 0;
+    int bit_count_ = 0;
+
+    // История (не больше окна) перед pos_ и еще не сжатые данные. Позиции в head_ и prev_ отсчитываются от начала
+    // потока, window_[0] - это позиция window_base_
+    std::string window_;
+    size_t pos_ = 0;
+    int64_t window_base_ = 0;
+    std::vector<int64_t> head_;     // Последняя позиция для каждого хэша, -1 - позиций нет
+    std::vector<int64_t> prev_;     // Предыдущая позиция с тем же хэшем, индекс - позиция по модулю окна
+    std::vector<Symbol> symbols_;   // Символы текущего блока
+    bool finished_ = false;
+
+    // Сжимает данные, для которых уже известно достаточно следующих байт. При `flush` - все данные
+    void Compress(bool flush);
+    Match FindMatch(size_t pos, size_t max_length) const;
+    void Insert(size_t pos);
+    void WriteBlock(bool final);
+    void WriteBits(uint32_t bits, int count);
+};
+
+// Буфер потока, который сжимает все, что в него выводится. Поток завершается вызовом Finish
+class DeflateBuffer : public std::streambuf {
+public:
+    explicit DeflateBuffer(std::string& output);
+    void Finish();
+
+protected:
+    int_type overflow(int_type ch) override;
+
+private:
+    DeflateEncoder encoder_;
+    std::array<char, 1 << 14> buffer_;
+
+    void FlushBuffer();
+};
+
+std::string EncodeBase64(std::string_view data);
+
+} // namespace compression
@@ -0,0 +1,111 @@
+#include "connection_scan.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+#include "parallel.h"
+
+using namespace std;
+
+namespace transit {
+
+ConnectionScan::ConnectionScan(size_t stop_count, size_t trip_count, vector<Connection> connections)
+    : stop_count_(stop_count), trip_count_(trip_count), connections_(move(connections)) {
+    // Перегоны с одинаковым отправлением упорядочиваются по прибытию, поэтому перегон нулевой длительности
+    // просматривается раньше отправления с его конечной остановки в тот же момент. Рейс и позиция делают порядок полным
+    parallel::Sort(connections_.begin(), connections_.end(), [](const Connection& lhs, const Connection& rhs) {
+        return tie(lhs.departure, lhs.arrival, lhs.trip, lhs.position) < tie(rhs.departure, rhs.arrival, rhs.trip, rhs.position);
+    });
+}
+
+optional<Journey> ConnectionScan::FindEarliestArrival(StopId from, StopId to, Time departure,
+                                                      graph::SearchStats* stats) const {
+    if (from >= stop_count_ || to >= stop_count_) {
+        throw out_of_range("Stop id is out of range");
+    }
+    if (from == to) {
+        return Journey{departure, {}};
+    }
+
+    Workspace& workspace = GetWorkspace();
+    const uint32_t current = workspace.current_version;
+    auto earliest = [&workspace, current](StopId stop) {
+        return workspace.stop_version[stop] == current ? workspace.earliest[stop] : numeric_limits<Time>::infinity();
+    };
+
+    workspace.stop_version[from] = current;
+    workspace.earliest[from] = departure;
+    workspace.in_connection[from] = kNone;
+
+    auto first = lower_bound(connections_.begin(), connections_.end(), departure,
+                             [](const Connection& connection, Time time) { return connection.departure < time; });
+    size_t scanned = 0;
+    for (auto it = first; it != connections_.end(); ++it) {
+        const Connection& connection = *it;
+        // Перегоны отсортированы по отправлению, поэтому дальнейшие не могут привезти в `to` раньше
+        if (!(connection.departure < earliest(to))) {
+            break;
+        }
+        ++scanned;
+
+        const bool on_board = workspace.trip_version[connection.trip] == current;
+        if (!on_board && !(earliest(connection.from) <= connection.departure)) {
+            continue;
+        }
+        if (!on_board) {
+            workspace.trip_version[connection.trip] = current;
+            workspace.boarding[connection.trip] = static_cast<uint32_t>(it - connections_.begin());
+        }
+        if (connection.arrival < earliest(connection.to)) {
+            workspace.stop_version[connection.to] = current;
+            workspace.earliest[connection.to] = connection.arrival;
+            workspace.in_connection[connection.to] = static_cast<uint32_t>(it - connections_.begin());
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices += scanned;
+    }
+    if (workspace.stop_version[to] != current) {
+        return nullopt;
+    }
+
+    // Путь восстанавливается с конца: перегон прибытия на остановку и перегон посадки на тот же рейс задают участок
+    Journey journey{workspace.earliest[to], {}};
+    for (StopId stop = to; stop != from;) {
+        const Connection& alight = connections_[workspace.in_connection[stop]];
+        const Connection& board = connections_[workspace.boarding[alight.trip]];
+        journey.legs.push_back({
+            .trip = alight.trip,
+            .from = board.from,
+            .to = alight.to,
+            .departure = board.departure,
+            .arrival = alight.arrival,
+            .span_count = alight.position - board.position + 1
+        });
+        stop = board.from;
+    }
+    reverse(journey.legs.begin(), journey.legs.end());
+
+    return journey;
+}
+
+ConnectionScan::Workspace& ConnectionScan::GetWorkspace() const {
+    thread_local Workspace workspace;
+
+    if (workspace.stop_version.size() != stop_count_ || workspace.trip_version.size() != trip_count_
+        || workspace.current_version == numeric_limits<uint32_t>::max()) {
+        workspace.earliest.assign(stop_count_, 0);
+        workspace.in_connection.assign(stop_count_, kNone);
+        workspace.stop_version.assign(stop_count_, 0);
+        workspace.boarding.assign(trip_count_, kNone);
+        workspace.trip_version.assign(trip_count_, 0);
+        workspace.current_version = 0;
+    }
+    ++workspace.current_version;
+    return workspace;
+}
+
+} // namespace transit
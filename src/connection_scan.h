@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "memory_usage.h"
+
+namespace transit {
+
+using StopId = uint32_t;
+using TripId = uint32_t;
+using Time = double;        // Минуты от начала суток
+
+// Перегон одного рейса: отправление с остановки `from` и прибытие на следующую остановку рейса `to`
+struct Connection {
+    StopId from;
+    StopId to;
+    TripId trip;
+    uint32_t position;      // Номер перегона в рейсе
+    Time departure;
+    Time arrival;
+};
+
+// Участок пути на одном рейсе от посадки до высадки
+struct Leg {
+    TripId trip;
+    StopId from;
+    StopId to;
+    Time departure;
+    Time arrival;
+    uint32_t span_count;
+};
+
+struct Journey {
+    Time arrival;
+    std::vector<Leg> legs;
+};
+
+/**
+ * Поиск пути с самым ранним прибытием по расписанию (Connection Scan Algorithm).
+ * Все перегоны всех рейсов хранятся в одном массиве, отсортированном по времени отправления. Запрос находит
+ * бинарным поиском первый перегон не раньше времени отправления и просматривает массив подряд, пока отправление
+ * не станет позже уже найденного прибытия в конечную остановку. Граф и очередь с приоритетом не нужны
+ */
+class ConnectionScan {
+public:
+    // Перегоны передаются в любом порядке. Рейсы пронумерованы с 0, перегоны рейса - с 0 в порядке движения
+    ConnectionScan(size_t stop_count, size_t trip_count, std::vector<Connection> connections);
+
+    // Если передан `stats`, в него добавляется количество просмотренных перегонов
+    std::optional<Journey> FindEarliestArrival(StopId from, StopId to, Time departure,
+                                               graph::SearchStats* stats = nullptr) const;
+
+    size_t GetConnectionCount() const noexcept {
+        return connections_.size();
+    }
+
+    void AddMemoryUsage(const std::string& prefix, memory::Report& report) const {
+        report.push_back(memory::MakeUsage(prefix + ".connections", connections_));
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    // Массивы переиспользуются между запросами потока, метка версии заменяет их очистку
+    struct Workspace {
+        std::vector<Time> earliest;             // Самое раннее прибытие на остановку
+        std::vector<uint32_t> in_connection;    // Перегон, которым достигнуто earliest
+        std::vector<uint32_t> stop_version;
+        std::vector<uint32_t> boarding;         // Перегон, на котором произошла посадка на рейс
+        std::vector<uint32_t> trip_version;
+        uint32_t current_version = 0;
+    };
+
+    size_t stop_count_;
+    size_t trip_count_;
+    std::vector<Connection> connections_;
+
+    Workspace& GetWorkspace() const;
+};
+
+} // namespace transit
@@ -0,0 +1,683 @@
+#pragma once
+
+#include "graph.h"
+#include "memory_usage.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+/**
+ * Иерархия сжатия (Contraction Hierarchies).
+ * При построении вершины по очереди "сжимаются": вершина удаляется из графа, а кратчайшие пути через нее
+ * заменяются ребрами-сокращениями между ее соседями. Порядок сжатия задает ранг вершины.
+ * Запрос - двунаправленный поиск Дейкстры, в котором обе стороны идут только по ребрам к вершинам с большим рангом,
+ * поэтому каждая сторона просматривает малую часть графа. Сокращения в найденном пути раскрываются в ребра исходного графа
+ */
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    struct Route {
+        Weight weight;
+        std::vector<EdgeId> edges; // Ребра исходного графа
+    };
+
+    explicit ContractionHierarchy(const Graph& graph);
+
+    // Если передан `stats`, в него добавляется количество просмотренных поиском вершин
+    std::optional<Route> FindRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+    /**
+     * Веса кратчайших путей из каждого источника в каждую цель без восстановления путей (алгоритм с корзинами):
+     * обратные поиски от целей раскладывают расстояния по корзинам вершин, затем прямой поиск от каждого источника
+     * просматривает корзины достигнутых вершин. Поиски одной стороны независимы и выполняются параллельно
+     */
+    std::vector<std::vector<std::optional<Weight>>> BuildWeightMatrix(const std::vector<VertexId>& sources,
+                                                                      const std::vector<VertexId>& targets) const;
+
+    size_t GetShortcutCount() const noexcept {
+        return shortcut_count_;
+    }
+
+    // Добавляет в `report` память ребер иерархии и графов поиска. Рабочие массивы поиска принадлежат потокам
+    // и не учитываются
+    void AddMemoryUsage(const std::string& prefix, memory::Report& report) const {
+        report.push_back(memory::MakeUsage(prefix + ".ch_edges", ch_edges_));
+        for (const auto& [name, search_graph] : {std::pair{".upward", &upward_}, std::pair{".downward", &downward_}}) {
+            report.push_back(memory::MakeUsage(prefix + name + ".offsets", search_graph->offsets));
+            report.push_back(memory::MakeUsage(prefix + name + ".arcs", search_graph->arcs));
+        }
+    }
+
+private:
+    static constexpr uint32_t kNoIndex = std::numeric_limits<uint32_t>::max();
+    // Количество вершин, которое может просмотреть поиск свидетеля, прежде чем сокращение будет добавлено без проверки.
+    // При оценке приоритета точность нужна меньше, поэтому и предел меньше
+    static constexpr size_t kWitnessSettleLimit = 100;
+    static constexpr size_t kSimulationSettleLimit = 20;
+
+    // Ребро иерархии: либо ребро исходного графа, либо сокращение из двух ребер иерархии
+    struct ChEdge {
+        Weight weight;
+        EdgeId original;        // Для сокращения - значение kNoEdge
+        uint32_t first_child;
+        uint32_t second_child;
+    };
+
+    struct Arc {
+        uint32_t vertex;        // Вершина на другом конце дуги
+        uint32_t edge;          // Индекс ребра в ch_edges_
+    };
+
+    // Граф поиска хранится в формате CSR: дуги вершины v - arcs[offsets[v]..offsets[v + 1])
+    struct SearchGraph {
+        std::vector<uint32_t> offsets;
+        std::vector<Arc> arcs;
+    };
+
+    static constexpr EdgeId kNoEdge = std::numeric_limits<EdgeId>::max();
+    static constexpr Weight ZERO_WEIGHT{};
+
+    std::vector<ChEdge> ch_edges_;
+    SearchGraph upward_;        // Дуги v -> w к вершинам с большим рангом
+    SearchGraph downward_;      // Дуги u -> v от вершин с большим рангом, хранятся у v
+    size_t shortcut_count_ = 0;
+
+    // Состояние построения, освобождается после построения графов поиска
+    struct Builder;
+
+    // Состояние поиска одного направления. Массивы переиспользуются между запросами потока,
+    // метка версии заменяет их очистку, поэтому запрос не тратит O(V) на инициализацию
+    struct Side {
+        std::vector<Weight> distance;
+        std::vector<uint32_t> parent_edge;
+        std::vector<uint32_t> parent_vertex;
+        std::vector<uint32_t> version;
+    };
+    struct Workspace {
+        Side sides[2];
+        uint32_t current_version = 0;
+    };
+
+    // Направление 0 - прямой поиск по upward_, направление 1 - обратный поиск по downward_
+    const SearchGraph& GetSearchGraph(int dir) const {
+        return dir == 0 ? upward_ : downward_;
+    }
+
+    size_t GetVertexCount() const {
+        return upward_.offsets.size() - 1;
+    }
+
+    Workspace& GetWorkspace() const;
+    bool IsStalled(int dir, uint32_t vertex, const Weight& dist, const Side& side, uint32_t current) const;
+
+    // Полный поиск одного направления от `source`. `visit(vertex, distance)` вызывается для каждой извлеченной
+    // и не остановленной вершины
+    template <typename Visitor>
+    void SearchUpward(uint32_t source, int dir, Visitor&& visit) const;
+
+    void UnpackEdge(uint32_t ch_edge, std::vector<EdgeId>& out) const;
+};
+
+// ---------- Построение иерархии ------------------
+
+template <typename Weight>
+struct ContractionHierarchy<Weight>::Builder {
+    ContractionHierarchy& ch;
+    size_t vertex_count;
+    std::vector<std::vector<Arc>> out;
+    std::vector<std::vector<Arc>> in;
+    std::vector<bool> contracted;
+    std::vector<uint32_t> contracted_neighbours;
+    std::vector<uint32_t> level;                // На единицу больше наибольшего уровня сжатых соседей
+    std::vector<std::vector<Arc>> upward_arcs;
+    std::vector<std::vector<Arc>> downward_arcs;
+
+    // Рабочие массивы поиска свидетеля. Метка версии позволяет не очищать массивы между поисками
+    std::vector<Weight> distance;
+    std::vector<uint32_t> version;
+    std::vector<Weight> target_limit;
+    std::vector<uint32_t> target_version;
+    size_t unwitnessed = 0;
+    uint32_t current_version = 0;
+
+    Builder(ContractionHierarchy& ch, const Graph& graph)
+        : ch(ch)
+        , vertex_count(graph.GetVertexCount())
+        , out(vertex_count)
+        , in(vertex_count)
+        , contracted(vertex_count, false)
+        , contracted_neighbours(vertex_count, 0)
+        , level(vertex_count, 0)
+        , upward_arcs(vertex_count)
+        , downward_arcs(vertex_count)
+        , distance(vertex_count)
+        , version(vertex_count, 0)
+        , target_limit(vertex_count)
+        , target_version(vertex_count, 0) {
+        AddOriginalEdges(graph);
+    }
+
+    // Из параллельных ребер между парой вершин в иерархию попадает только самое легкое, петли отбрасываются
+    void AddOriginalEdges(const Graph& graph) {
+        std::vector<uint32_t> best_arc(vertex_count, kNoIndex);
+        for (VertexId from = 0; from < vertex_count; ++from) {
+            for (const EdgeId edge_id : graph.GetIncidentEdges(from)) {
+                const auto& edge = graph.GetEdge(edge_id);
+                if (edge.weight < ZERO_WEIGHT) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+                if (edge.to == from) {
+                    continue;
+                }
+
+                uint32_t& arc_idx = best_arc[edge.to];
+                if (arc_idx != kNoIndex) {
+                    ChEdge& existing = ch.ch_edges_[out[from][arc_idx].edge];
+                    if (edge.weight < existing.weight) {
+                        existing = {edge.weight, edge_id, kNoIndex, kNoIndex};
+                    }
+                    continue;
+                }
+
+                arc_idx = static_cast<uint32_t>(out[from].size());
+                const uint32_t ch_edge = NextEdgeIndex();
+                ch.ch_edges_.push_back({edge.weight, edge_id, kNoIndex, kNoIndex});
+                out[from].push_back({static_cast<uint32_t>(edge.to), ch_edge});
+                in[edge.to].push_back({static_cast<uint32_t>(from), ch_edge});
+            }
+            for (const auto& arc : out[from]) {
+                best_arc[arc.vertex] = kNoIndex;
+            }
+        }
+    }
+
+    /**
+     * Поиск свидетелей из `source` в обход `skipped`: для каждой цели ищется путь не тяжелее ее предела.
+     * Цели задаются через SetTarget, поиск прекращается, как только свидетели найдены для всех целей
+     */
+    void WitnessSearch(uint32_t source, uint32_t skipped, const Weight& limit, size_t settle_limit) {
+        using QueueItem = std::pair<Weight, uint32_t>;
+        auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.first < lhs.first; };
+        std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)> queue(greater);
+
+        version[source] = current_version;
+        distance[source] = ZERO_WEIGHT;
+        queue.push({ZERO_WEIGHT, source});
+
+        size_t settled = 0;
+        while (!queue.empty() && settled < settle_limit) {
+            const auto [dist, vertex] = queue.top();
+            queue.pop();
+            if (distance[vertex] < dist) {
+                continue;
+            }
+            if (limit < dist) {
+                break;
+            }
+            ++settled;
+
+            for (const Arc& arc : out[vertex]) {
+                if (arc.vertex == skipped || contracted[arc.vertex]) {
+                    continue;
+                }
+                const Weight candidate = dist + ch.ch_edges_[arc.edge].weight;
+                if (version[arc.vertex] == current_version && !(candidate < distance[arc.vertex])) {
+                    continue;
+                }
+                version[arc.vertex] = current_version;
+                distance[arc.vertex] = candidate;
+                queue.push({candidate, arc.vertex});
+
+                // Найденный путь уже короче пути через skipped, даже если он еще не кратчайший
+                if (target_version[arc.vertex] == current_version && !(target_limit[arc.vertex] < candidate)) {
+                    target_version[arc.vertex] = 0;
+                    if (--unwitnessed == 0) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    void SetTarget(uint32_t target, const Weight& weight) {
+        target_version[target] = current_version;
+        target_limit[target] = weight;
+        ++unwitnessed;
+    }
+
+    bool HasWitness(uint32_t target) const {
+        return target_version[target] != current_version;
+    }
+
+    /**
+     * Сжатие вершины. При `simulate` граф не меняется, возвращается только количество нужных сокращений
+     */
+    size_t Contract(uint32_t vertex, bool simulate) {
+        size_t shortcuts = 0;
+        for (const Arc& in_arc : in[vertex]) {
+            if (contracted[in_arc.vertex]) {
+                continue;
+            }
+            // Копия, а не ссылка: AddShortcut добавляет ребра в ch_edges_, и ссылка может стать недействительной
+            const Weight in_weight = ch.ch_edges_[in_arc.edge].weight;
+
+            // Цели поиска - соседи по исходящим дугам, наибольший вес пути через vertex ограничивает поиск
+            ++current_version;
+            unwitnessed = 0;
+            std::optional<Weight> limit;
+            for (const Arc& out_arc : out[vertex]) {
+                if (contracted[out_arc.vertex] || out_arc.vertex == in_arc.vertex) {
+                    continue;
+                }
+                const Weight candidate = in_weight + ch.ch_edges_[out_arc.edge].weight;
+                SetTarget(out_arc.vertex, candidate);
+                if (!limit || *limit < candidate) {
+                    limit = candidate;
+                }
+            }
+            if (!limit) {
+                continue;
+            }
+
+            WitnessSearch(in_arc.vertex, vertex, *limit, simulate ? kSimulationSettleLimit : kWitnessSettleLimit);
+            if (unwitnessed == 0) {
+                continue;
+            }
+
+            for (const Arc& out_arc : out[vertex]) {
+                if (contracted[out_arc.vertex] || out_arc.vertex == in_arc.vertex || HasWitness(out_arc.vertex)) {
+                    continue;
+                }
+                ++shortcuts;
+                if (!simulate) {
+                    AddShortcut(in_arc, out_arc, in_weight + ch.ch_edges_[out_arc.edge].weight);
+                }
+            }
+        }
+        return shortcuts;
+    }
+
+    // Индекс следующего ребра в ch_edges_. Индексы ребер хранятся в uint32_t, а kNoIndex занят под "нет ребра"
+    uint32_t NextEdgeIndex() const {
+        if (ch.ch_edges_.size() >= kNoIndex) {
+            throw std::length_error("Too many edges and shortcuts for contraction hierarchy");
+        }
+        return static_cast<uint32_t>(ch.ch_edges_.size());
+    }
+
+    void AddShortcut(const Arc& in_arc, const Arc& out_arc, const Weight& weight) {
+        const uint32_t from = in_arc.vertex;
+        const uint32_t to = out_arc.vertex;
+        const uint32_t ch_edge = NextEdgeIndex();
+
+        // Если дуга from -> to уже есть, она заменяется более легким сокращением
+        auto existing = std::find_if(out[from].begin(), out[from].end(), [to](const Arc& arc) { return arc.vertex == to; });
+        if (existing != out[from].end()) {
+            if (!(weight < ch.ch_edges_[existing->edge].weight)) {
+                return;
+            }
+            existing->edge = ch_edge;
+            auto reverse = std::find_if(in[to].begin(), in[to].end(), [from](const Arc& arc) { return arc.vertex == from; });
+            reverse->edge = ch_edge;
+        } else {
+            out[from].push_back({to, ch_edge});
+            in[to].push_back({from, ch_edge});
+        }
+
+        ch.ch_edges_.push_back({weight, kNoEdge, in_arc.edge, out_arc.edge});
+        ++ch.shortcut_count_;
+    }
+
+    // Приоритет сжатия: разность ребер (добавленные сокращения минус удаленные дуги), количество сжатых соседей
+    // и уровень вершины в иерархии. Два последних слагаемых распределяют сжатие по графу равномерно
+    int Priority(uint32_t vertex) {
+        const auto shortcuts = static_cast<int>(Contract(vertex, /* simulate */ true));
+        const auto removed = static_cast<int>(out[vertex].size() + in[vertex].size());
+        return shortcuts - removed + static_cast<int>(contracted_neighbours[vertex]) + 2 * static_cast<int>(level[vertex]);
+    }
+
+    void Run() {
+        using QueueItem = std::pair<int, uint32_t>;
+        std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+        for (uint32_t vertex = 0; vertex < vertex_count; ++vertex) {
+            queue.push({Priority(vertex), vertex});
+        }
+
+        // Ленивое обновление приоритетов: перед сжатием приоритет пересчитывается,
+        // и если вершина перестала быть минимальной, она возвращается в очередь
+        while (!queue.empty()) {
+            const uint32_t vertex = queue.top().second;
+            queue.pop();
+            const int priority = Priority(vertex);
+            if (!queue.empty() && priority > queue.top().first) {
+                queue.push({priority, vertex});
+                continue;
+            }
+
+            Contract(vertex, /* simulate */ false);
+            Remove(vertex);
+        }
+    }
+
+    // Дуги сжатой вершины к несжатым соседям переходят в граф поиска и удаляются из списков соседей
+    void Remove(uint32_t vertex) {
+        contracted[vertex] = true;
+        for (const Arc& arc : out[vertex]) {
+            if (contracted[arc.vertex]) {
+                continue;
+            }
+            upward_arcs[vertex].push_back(arc);
+            ++contracted_neighbours[arc.vertex];
+            level[arc.vertex] = std::max(level[arc.vertex], level[vertex] + 1);
+            std::erase_if(in[arc.vertex], [vertex](const Arc& item) { return item.vertex == vertex; });
+        }
+        for (const Arc& arc : in[vertex]) {
+            if (contracted[arc.vertex]) {
+                continue;
+            }
+            downward_arcs[vertex].push_back(arc);
+            ++contracted_neighbours[arc.vertex];
+            level[arc.vertex] = std::max(level[arc.vertex], level[vertex] + 1);
+            std::erase_if(out[arc.vertex], [vertex](const Arc& item) { return item.vertex == vertex; });
+        }
+        out[vertex].clear();
+        out[vertex].shrink_to_fit();
+        in[vertex].clear();
+        in[vertex].shrink_to_fit();
+    }
+
+    static SearchGraph ToSearchGraph(const std::vector<std::vector<Arc>>& arcs) {
+        SearchGraph result;
+        result.offsets.reserve(arcs.size() + 1);
+        result.offsets.push_back(0);
+        for (const auto& vertex_arcs : arcs) {
+            result.offsets.push_back(result.offsets.back() + static_cast<uint32_t>(vertex_arcs.size()));
+        }
+        result.arcs.reserve(result.offsets.back());
+        for (const auto& vertex_arcs : arcs) {
+            result.arcs.insert(result.arcs.end(), vertex_arcs.begin(), vertex_arcs.end());
+        }
+        return result;
+    }
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph) {
+    if (graph.GetVertexCount() >= kNoIndex) {
+        throw std::length_error("Too many vertices for contraction hierarchy");
+    }
+
+    Builder builder(*this, graph);
+    builder.Run();
+    upward_ = Builder::ToSearchGraph(builder.upward_arcs);
+    downward_ = Builder::ToSearchGraph(builder.downward_arcs);
+    ch_edges_.shrink_to_fit();
+}
+
+// ---------- Запрос ------------------
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::Route> ContractionHierarchy<Weight>::FindRoute(VertexId from,
+                                                                                                    VertexId to,
+                                                                                                    SearchStats* stats) const {
+    const size_t vertex_count = GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (from == to) {
+        return Route{ZERO_WEIGHT, {}};
+    }
+
+    Workspace& workspace = GetWorkspace();
+    const uint32_t current = workspace.current_version;
+
+    using QueueItem = std::pair<Weight, uint32_t>;
+    auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.first < lhs.first; };
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)>;
+    Queue queues[2] = {Queue(greater), Queue(greater)};
+
+    const uint32_t sources[2] = {static_cast<uint32_t>(from), static_cast<uint32_t>(to)};
+    for (int dir = 0; dir < 2; ++dir) {
+        Side& side = workspace.sides[dir];
+        side.version[sources[dir]] = current;
+        side.distance[sources[dir]] = ZERO_WEIGHT;
+        side.parent_edge[sources[dir]] = kNoIndex;
+        queues[dir].push({ZERO_WEIGHT, sources[dir]});
+    }
+
+    std::optional<Weight> best;
+    uint32_t meeting_vertex = kNoIndex;
+    size_t settled = 0;
+
+    // Стороны чередуются. Сторона останавливается, когда ее минимальное расстояние не меньше лучшего найденного пути
+    while (!queues[0].empty() || !queues[1].empty()) {
+        for (int dir = 0; dir < 2; ++dir) {
+            Queue& queue = queues[dir];
+            if (queue.empty()) {
+                continue;
+            }
+            const auto [dist, vertex] = queue.top();
+            queue.pop();
+
+            Side& side = workspace.sides[dir];
+            if (side.distance[vertex] < dist) {
+                continue;
+            }
+            if (best && !(dist < *best)) {
+                queue = Queue(greater);
+                continue;
+            }
+            ++settled;
+
+            const Side& other = workspace.sides[1 - dir];
+            if (other.version[vertex] == current) {
+                const Weight total = dist + other.distance[vertex];
+                if (!best || total < *best) {
+                    best = total;
+                    meeting_vertex = vertex;
+                }
+            }
+
+            if (IsStalled(dir, vertex, dist, side, current)) {
+                continue;
+            }
+
+            const SearchGraph& search_graph = GetSearchGraph(dir);
+            for (uint32_t i = search_graph.offsets[vertex]; i < search_graph.offsets[vertex + 1]; ++i) {
+                const Arc& arc = search_graph.arcs[i];
+                const Weight candidate = dist + ch_edges_[arc.edge].weight;
+                if (side.version[arc.vertex] != current || candidate < side.distance[arc.vertex]) {
+                    side.version[arc.vertex] = current;
+                    side.distance[arc.vertex] = candidate;
+                    side.parent_edge[arc.vertex] = arc.edge;
+                    side.parent_vertex[arc.vertex] = vertex;
+                    queue.push({candidate, arc.vertex});
+                }
+            }
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices += settled;
+    }
+    if (!best) {
+        return std::nullopt;
+    }
+
+    // Ребра иерархии от from до точки встречи (в обратном порядке) и от точки встречи до to
+    std::vector<uint32_t> forward_edges;
+    for (uint32_t vertex = meeting_vertex; vertex != sources[0]; vertex = workspace.sides[0].parent_vertex[vertex]) {
+        forward_edges.push_back(workspace.sides[0].parent_edge[vertex]);
+    }
+
+    Route route{*best, {}};
+    for (auto it = forward_edges.rbegin(); it != forward_edges.rend(); ++it) {
+        UnpackEdge(*it, route.edges);
+    }
+    for (uint32_t vertex = meeting_vertex; vertex != sources[1]; vertex = workspace.sides[1].parent_vertex[vertex]) {
+        UnpackEdge(workspace.sides[1].parent_edge[vertex], route.edges);
+    }
+
+    return route;
+}
+
+template <typename Weight>
+std::vector<std::vector<std::optional<Weight>>> ContractionHierarchy<Weight>::BuildWeightMatrix(
+        const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const {
+    const size_t vertex_count = GetVertexCount();
+    auto check_vertex = [vertex_count](VertexId vertex) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    };
+    std::for_each(sources.begin(), sources.end(), check_vertex);
+    std::for_each(targets.begin(), targets.end(), check_vertex);
+
+    struct BucketEntry {
+        uint32_t target;        // Индекс цели в `targets`
+        Weight distance;        // Расстояние от вершины корзины до цели
+    };
+
+    // Пространства обратного поиска целей
+    std::vector<std::vector<std::pair<uint32_t, Weight>>> target_spaces(targets.size());
+    parallel::For(targets.size(), parallel::GetThreadCount(targets.size()), [this, &targets, &target_spaces](size_t idx) {
+        SearchUpward(static_cast<uint32_t>(targets[idx]), 1, [&space = target_spaces[idx]](uint32_t vertex, const Weight& dist) {
+            space.emplace_back(vertex, dist);
+        });
+    });
+
+    // Корзины в формате CSR: записи вершины v - buckets[bucket_offsets[v]..bucket_offsets[v + 1])
+    std::vector<size_t> bucket_offsets(vertex_count + 1, 0);
+    for (const auto& space : target_spaces) {
+        for (const auto& [vertex, dist] : space) {
+            ++bucket_offsets[vertex + 1];
+        }
+    }
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        bucket_offsets[vertex + 1] += bucket_offsets[vertex];
+    }
+    std::vector<BucketEntry> buckets(bucket_offsets.back());
+    std::vector<size_t> positions(bucket_offsets.begin(), bucket_offsets.end() - 1);
+    for (uint32_t target = 0; target < target_spaces.size(); ++target) {
+        for (const auto& [vertex, dist] : target_spaces[target]) {
+            buckets[positions[vertex]++] = {target, dist};
+        }
+    }
+
+    std::vector<std::vector<std::optional<Weight>>> result(sources.size(),
+                                                           std::vector<std::optional<Weight>>(targets.size()));
+    parallel::For(sources.size(), parallel::GetThreadCount(sources.size()), [&](size_t idx) {
+        auto& row = result[idx];
+        SearchUpward(static_cast<uint32_t>(sources[idx]), 0, [&](uint32_t vertex, const Weight& dist) {
+            for (size_t i = bucket_offsets[vertex]; i < bucket_offsets[vertex + 1]; ++i) {
+                const BucketEntry& entry = buckets[i];
+                const Weight total = dist + entry.distance;
+                if (!row[entry.target] || total < *row[entry.target]) {
+                    row[entry.target] = total;
+                }
+            }
+        });
+    });
+
+    return result;
+}
+
+template <typename Weight>
+typename ContractionHierarchy<Weight>::Workspace& ContractionHierarchy<Weight>::GetWorkspace() const {
+    thread_local Workspace workspace;
+
+    const size_t vertex_count = GetVertexCount();
+    if (workspace.sides[0].version.size() != vertex_count || workspace.current_version == kNoIndex) {
+        for (Side& side : workspace.sides) {
+            side.distance.assign(vertex_count, ZERO_WEIGHT);
+            side.parent_edge.assign(vertex_count, kNoIndex);
+            side.parent_vertex.assign(vertex_count, kNoIndex);
+            side.version.assign(vertex_count, 0);
+        }
+        workspace.current_version = 0;
+    }
+    ++workspace.current_version;
+    return workspace;
+}
+
+// Остановка по требованию: если в vertex можно прийти короче через вершину с большим рангом,
+// найденное расстояние не кратчайшее, и продолжать поиск из vertex бессмысленно
+template <typename Weight>
+bool ContractionHierarchy<Weight>::IsStalled(int dir, uint32_t vertex, const Weight& dist, const Side& side,
+                                             uint32_t current) const {
+    const SearchGraph& stall_graph = GetSearchGraph(1 - dir);
+    for (uint32_t i = stall_graph.offsets[vertex]; i < stall_graph.offsets[vertex + 1]; ++i) {
+        const Arc& arc = stall_graph.arcs[i];
+        if (side.version[arc.vertex] == current && side.distance[arc.vertex] + ch_edges_[arc.edge].weight < dist) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Weight>
+template <typename Visitor>
+void ContractionHierarchy<Weight>::SearchUpward(uint32_t source, int dir, Visitor&& visit) const {
+    Workspace& workspace = GetWorkspace();
+    const uint32_t current = workspace.current_version;
+    Side& side = workspace.sides[dir];
+    const SearchGraph& search_graph = GetSearchGraph(dir);
+
+    using QueueItem = std::pair<Weight, uint32_t>;
+    auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.first < lhs.first; };
+    std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)> queue(greater);
+
+    side.version[source] = current;
+    side.distance[source] = ZERO_WEIGHT;
+    queue.push({ZERO_WEIGHT, source});
+
+    while (!queue.empty()) {
+        const auto [dist, vertex] = queue.top();
+        queue.pop();
+        if (side.distance[vertex] < dist || IsStalled(dir, vertex, dist, side, current)) {
+            continue;
+        }
+        visit(vertex, dist);
+
+        for (uint32_t i = search_graph.offsets[vertex]; i < search_graph.offsets[vertex + 1]; ++i) {
+            const Arc& arc = search_graph.arcs[i];
+            const Weight candidate = dist + ch_edges_[arc.edge].weight;
+            if (side.version[arc.vertex] != current || candidate < side.distance[arc.vertex]) {
+                side.version[arc.vertex] = current;
+                side.distance[arc.vertex] = candidate;
+                queue.push({candidate, arc.vertex});
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackEdge(uint32_t ch_edge, std::vector<EdgeId>& out) const {
+    // Обход дерева сокращений в глубину без рекурсии: сначала первая половина сокращения, затем вторая
+    std::vector<uint32_t> stack{ch_edge};
+    while (!stack.empty()) {
+        const ChEdge& edge = ch_edges_[stack.back()];
+        stack.pop_back();
+        if (edge.original != kNoEdge) {
+            out.push_back(edge.original);
+            continue;
+        }
+        stack.push_back(edge.second_child);
+        stack.push_back(edge.first_child);
+    }
+}
+
+}  // namespace graph
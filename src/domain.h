@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <optional>
 #include <variant>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <utility>
 
 #include "geo.h"
 
@@ -14,11 +17,38 @@ struct Bus {
     std::string name;					// Название автобуса
     std::vector<const Stop*> stops; 	// Последовательный массив из указателей на остановки маршрута автобуса
     bool is_roundtrip;                  // Кольцевой маршрут?
+    std::vector<double> departures;     // Отправления рейсов от первой остановки в минутах от начала суток, по возрастанию.
+                                        // Для некольцевого маршрута рейсы в обратном направлении отправляются в то же время
+                                        // от последней остановки. Пусто - у автобуса нет расписания
+    std::optional<double> velocity;     // Скорость автобуса в км/ч, если отличается от bus_velocity из routing_settings
 };
 
 struct Stop {
     std::string name;					// Название остановки
     geo::Coordinates coordinates; 		// Координаты остановки
+    std::optional<int> wait_time;       // Ожидание автобуса на остановке в минутах, если отличается от bus_wait_time
+};
+
+/**
+ * Накопленные расстояния вдоль маршрута автобуса, элемент i относится к stops[i].
+ * forward_* - расстояние от первой остановки до stops[i] по ходу маршрута,
+ * backward_* - сумма перегонов stops[k + 1] -> stops[k] для k < i (только для некольцевых маршрутов).
+ * Расстояние от stops[i] до stops[j] при i < j - forward[j] - forward[i], обратно - backward[j] - backward[i]
+ */
+struct BusDistances {
+    std::vector<int> forward_road;
+    std::vector<double> forward_geo;
+    std::vector<int> backward_road;
+    std::vector<double> backward_geo;
+    // Пары (остановка, позиция в stops), отсортированные по остановке, затем по позиции.
+    // Кольцевой маршрут может проходить через одну остановку несколько раз, поэтому позиций у остановки бывает больше одной
+    std::vector<std::pair<const Stop*, uint32_t>> stop_positions;
+};
+
+// Участок маршрута автобуса между двумя остановками
+struct BusSegmentStat {
+    int road_distance;
+    int span_count;
 };
 
 struct BusStat {
@@ -30,6 +60,27 @@ struct BusStat {
 
 namespace dto { // Объекты для передачи данных между несвязанными модулями
 
+// Описания объектов для пакетной загрузки в TransportCatalogue. Строки принадлежат вызывающей стороне
+struct StopDescription {
+    std::string_view name;
+    geo::Coordinates coordinates;
+    std::optional<int> wait_time;
+};
+
+struct RoadDistanceDescription {
+    std::string_view from;
+    std::string_view to;
+    int distance;
+};
+
+struct BusDescription {
+    std::string_view name;
+    std::vector<std::string_view> stops;
+    bool is_roundtrip;
+    std::vector<double> departures;
+    std::optional<double> velocity;
+};
+
 struct Point {
     double x;
     double y;
@@ -65,15 +116,25 @@ struct RenderSettings { // Настройки MapRenderer
     std::vector<Color>color_palette;
 };
 
+// Алгоритм поиска маршрута (ключ "strategy" в "routing_settings")
+enum class RoutingStrategy {
+    kAllPairs,                  // "all_pairs" - таблица кратчайших путей между всеми парами остановок
+    kContractionHierarchy,      // "contraction_hierarchy" - иерархия сжатия для больших сетей
+    kDijkstra,                  // "dijkstra" - поиск Дейкстры без предобработки
+    kBidirectionalDijkstra,     // "bidirectional_dijkstra" - встречный поиск Дейкстры
+    kAStar,                     // "a_star" - поиск A* с оценкой по расстоянию по прямой
+};
+
 struct RoutingSettings {
     double velocity;
     int wait_time;
+    RoutingStrategy strategy = RoutingStrategy::kAllPairs;
 };
 
 // Структуры для хранения ответа из TransportRouter, который пройдя через RequestHandler должен использоваться в JsonReader
 struct Waiting {
     std::string stop_name;
-    int time;
+    double time;        // При поиске по расписанию ожидание - время до отправления рейса, поэтому дробное
 };
 
 struct Trip {
@@ -89,6 +150,23 @@ struct RouteResponse {
     double total_time;
 };
 
+// Остановка, до которой можно доехать за отведенное время, и время в пути до нее
+// Маршрут из множества Парето по времени в пути и количеству пересадок
+struct ParetoRoute {
+    RouteResponse route;
+    int transfers;
+};
+
+struct ReachableStop {
+    const Stop* stop;
+    double time;
+};
+
+struct IsochroneResponse {
+    std::vector<ReachableStop> stops;   // По возрастанию времени, первая - исходная остановка
+    std::optional<std::string> map;     // svg-слой с достижимыми остановками, если он запрошен
+};
+
 } // namespace dto
 
 } // namespace domain
@@ -1,8 +1,14 @@
 #pragma once
 
+#include "memory_usage.h"
+#include "parallel.h"
 #include "ranges.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 namespace graph {
@@ -10,6 +16,11 @@ namespace graph {
 using VertexId = size_t;
 using EdgeId = size_t;
 
+// Счетчики поиска пути в графе
+struct SearchStats {
+    size_t settled_vertices = 0;    // Вершины, извлеченные из очереди поиска с окончательным весом
+};
+
 template <typename Weight>
 struct Edge {
     VertexId from;
@@ -20,40 +31,86 @@ struct Edge {
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = ranges::Range<typename std::vector<EdgeId>::const_iterator>;
 
 public:
     DirectedWeightedGraph() = default;
-    explicit DirectedWeightedGraph(size_t vertex_count);
-    EdgeId AddEdge(const Edge<Weight>& edge);
+
+    /**
+     * Построение графа из заранее подготовленного массива ребер. Id ребра - его индекс в `edges`.
+     * Списки инцидентности хранятся подряд в одном массиве (CSR) и строятся параллельно. Ребра каждой вершины
+     * идут по возрастанию id. Кроме ребер и списков нужен только массив смещений, временных массивов на поток нет
+     */
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // Добавляет в `report` память ребер и списков инцидентности под именами с префиксом `prefix`
+    void AddMemoryUsage(const std::string& prefix, memory::Report& report) const;
+
 private:
     std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    // Ребра вершины v - incidence_edges_[incidence_offsets_[v]..incidence_offsets_[v + 1])
+    std::vector<size_t> incidence_offsets_ = std::vector<size_t>(1, 0);
+    std::vector<EdgeId> incidence_edges_;
 };
 
 template <typename Weight>
-DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
-}
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges)
+    : edges_(std::move(edges))
+    , incidence_offsets_(vertex_count + 1, 0)
+    , incidence_edges_(edges_.size()) {
+    constexpr size_t kEdgesPerThread = 1 << 14;
+    constexpr size_t kVerticesPerThread = 1 << 14;
+    const size_t edge_chunks = parallel::GetThreadCount(edges_.size(), kEdgesPerThread);
 
-template <typename Weight>
-EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-    edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
-    return id;
+    // Один поток раскладывает ребра по возрастанию id, и атомарные операции и сортировка списков не нужны
+    const bool concurrent = edge_chunks > 1;
+    auto fetch_increment = [concurrent](size_t& counter) {
+        return concurrent ? std::atomic_ref<size_t>(counter).fetch_add(1, std::memory_order_relaxed) : counter++;
+    };
+
+    // Степени вершин считаются прямо в массиве смещений со сдвигом на одну вершину
+    parallel::ForEachChunk(edges_.size(), edge_chunks, [this, &fetch_increment](size_t, size_t begin, size_t end) {
+        for (EdgeId id = begin; id < end; ++id) {
+            fetch_increment(incidence_offsets_[edges_[id].from + 1]);
+        }
+    });
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        incidence_offsets_[vertex + 1] += incidence_offsets_[vertex];
+    }
+
+    // Начало списка служит курсором записи. После раскладки в incidence_offsets_[v] оказывается конец списка v,
+    // то есть начало списка v + 1, и смещения восстанавливаются сдвигом на одну вершину
+    parallel::ForEachChunk(edges_.size(), edge_chunks, [this, &fetch_increment](size_t, size_t begin, size_t end) {
+        for (EdgeId id = begin; id < end; ++id) {
+            incidence_edges_[fetch_increment(incidence_offsets_[edges_[id].from])] = id;
+        }
+    });
+    for (VertexId vertex = vertex_count; vertex > 0; --vertex) {
+        incidence_offsets_[vertex] = incidence_offsets_[vertex - 1];
+    }
+    incidence_offsets_[0] = 0;
+    if (!concurrent) {
+        return;
+    }
+
+    // Потоки раскладывают ребра одной вершины в произвольном порядке, а поиск должен быть детерминированным
+    const size_t vertex_chunks = parallel::GetThreadCount(vertex_count, kVerticesPerThread);
+    parallel::ForEachChunk(vertex_count, vertex_chunks, [this](size_t, size_t begin, size_t end) {
+        for (VertexId vertex = begin; vertex < end; ++vertex) {
+            std::sort(incidence_edges_.begin() + incidence_offsets_[vertex],
+                      incidence_edges_.begin() + incidence_offsets_[vertex + 1]);
+        }
+    });
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return incidence_offsets_.size() - 1;
 }
 
 template <typename Weight>
@@ -69,6 +126,16 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    if (vertex >= GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    return {incidence_edges_.begin() + incidence_offsets_[vertex], incidence_edges_.begin() + incidence_offsets_[vertex + 1]};
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::AddMemoryUsage(const std::string& prefix, memory::Report& report) const {
+    report.push_back(memory::MakeUsage(prefix + ".edges", edges_));
+    report.push_back(memory::MakeUsage(prefix + ".incidence_offsets", incidence_offsets_));
+    report.push_back(memory::MakeUsage(prefix + ".incidence_edges", incidence_edges_));
 }
 }  // namespace graph
\ No newline at end of file
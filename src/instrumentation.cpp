@@ -0,0 +1,160 @@
+#include "instrumentation.h"
+
+#include <bit>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "json_builder.h"
+
+using namespace std;
+
+namespace instrumentation {
+
+namespace {
+
+void UpdateMax(atomic<uint64_t>& max_value, uint64_t value) noexcept {
+    uint64_t current = max_value.load(memory_order_relaxed);
+    while (current < value && !max_value.compare_exchange_weak(current, value, memory_order_relaxed)) {
+    }
+}
+
+// В json::Node целые числа хранятся как int, поэтому большие значения выводятся как double
+json::Node::Value ToJsonNumber(uint64_t value) {
+    if (value <= static_cast<uint64_t>(INT_MAX)) {
+        return static_cast<int>(value);
+    }
+    return static_cast<double>(value);
+}
+
+double ToMs(uint64_t ns) noexcept {
+    return static_cast<double>(ns) / 1'000'000.0;
+}
+
+double ToUs(uint64_t ns) noexcept {
+    return static_cast<double>(ns) / 1'000.0;
+}
+
+} // namespace
+
+void Timer::Record(uint64_t ns) noexcept {
+    count_.fetch_add(1, memory_order_relaxed);
+    total_ns_.fetch_add(ns, memory_order_relaxed);
+    UpdateMax(max_ns_, ns);
+}
+
+void Histogram::Record(uint64_t ns) noexcept {
+    Timer::Record(ns);
+    const size_t bucket = ns == 0 ? 0 : static_cast<size_t>(bit_width(ns) - 1);
+    buckets_[min(bucket, kBucketCount - 1)].fetch_add(1, memory_order_relaxed);
+}
+
+uint64_t Histogram::GetPercentileUpperNs(double percentile) const noexcept {
+    const uint64_t count = GetCount();
+    if (count == 0) {
+        return 0;
+    }
+
+    const auto threshold = static_cast<uint64_t>(percentile * static_cast<double>(count));
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        accumulated += GetBucket(i);
+        if (accumulated > threshold || accumulated == count) {
+            return uint64_t{1} << (i + 1);
+        }
+    }
+    return GetMaxNs();
+}
+
+Registry& Registry::Instance() {
+    static Registry registry;
+    return registry;
+}
+
+Registry::~Registry() {
+    // Реестр - статический объект, поэтому деструктор вызывается при завершении программы
+    if (const char* path = getenv("TC_INSTRUMENTATION_OUTPUT"); path != nullptr && *path != '\0') {
+        ofstream out(path);
+        Dump(out);
+    } else {
+        Dump(cerr);
+        cerr << endl;
+    }
+}
+
+template <typename T>
+T& Registry::GetOrCreate(Storage<T>& storage, string_view name) {
+    lock_guard guard(mutex_);
+    auto it = storage.find(name);
+    if (it == storage.end()) {
+        it = storage.emplace(string(name), make_unique<T>()).first;
+    }
+    return *it->second;
+}
+
+Counter& Registry::GetCounter(string_view name) {
+    return GetOrCreate(counters_, name);
+}
+
+Timer& Registry::GetTimer(string_view name) {
+    return GetOrCreate(timers_, name);
+}
+
+Histogram& Registry::GetHistogram(string_view name) {
+    return GetOrCreate(histograms_, name);
+}
+
+void Registry::Dump(ostream& out) const {
+    lock_guard guard(mutex_);
+
+    json::Builder builder;
+    auto root = builder.StartDict();
+
+    auto timers = root.Key("timers").StartDict();
+    for (const auto& [name, timer] : timers_) {
+        timers.Key(name).StartDict()
+            .Key("count").Value(ToJsonNumber(timer->GetCount()))
+            .Key("total_ms").Value(ToMs(timer->GetTotalNs()))
+            .Key("max_ms").Value(ToMs(timer->GetMaxNs()))
+        .EndDict();
+    }
+    timers.EndDict();
+
+    auto counters = root.Key("counters").StartDict();
+    for (const auto& [name, counter] : counters_) {
+        counters.Key(name).Value(ToJsonNumber(counter->Get()));
+    }
+    counters.EndDict();
+
+    auto histograms = root.Key("histograms").StartDict();
+    for (const auto& [name, histogram] : histograms_) {
+        const uint64_t count = histogram->GetCount();
+        const double mean_ns = count == 0 ? 0.0 : static_cast<double>(histogram->GetTotalNs()) / static_cast<double>(count);
+
+        auto item = histograms.Key(name).StartDict();
+        item.Key("count").Value(ToJsonNumber(count))
+            .Key("mean_us").Value(mean_ns / 1'000.0)
+            .Key("max_us").Value(ToUs(histogram->GetMaxNs()))
+            .Key("p50_us").Value(ToUs(histogram->GetPercentileUpperNs(0.5)))
+            .Key("p99_us").Value(ToUs(histogram->GetPercentileUpperNs(0.99)));
+
+        // Выводятся только непустые корзины: верхняя граница корзины и количество попавших в нее замеров
+        auto buckets = item.Key("buckets").StartArray();
+        for (size_t i = 0; i < Histogram::kBucketCount; ++i) {
+            if (const uint64_t bucket = histogram->GetBucket(i); bucket != 0) {
+                buckets.StartDict()
+                    .Key("upper_us").Value(ToUs(uint64_t{1} << (i + 1)))
+                    .Key("count").Value(ToJsonNumber(bucket))
+                .EndDict();
+            }
+        }
+        buckets.EndArray();
+        item.EndDict();
+    }
+    histograms.EndDict();
+
+    json::Print(json::Document{root.EndDict().Build()}, out);
+}
+
+} // namespace instrumentation
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * Инструментация для профилирования без внешнего профайлера: таймеры фаз, счетчики и гистограммы задержек.
+ * Точки замера расставляются макросами TC_SCOPED_TIMER, TC_COUNTER_ADD и TC_SCOPED_LATENCY,
+ * которые раскрываются в пустоту, если не определен TRANSPORT_CATALOGUE_INSTRUMENTATION
+ * (опция CMake TRANSPORT_CATALOGUE_INSTRUMENTATION).
+ *
+ * При завершении программы собранные данные выводятся в json в stderr,
+ * либо в файл, путь к которому задан переменной окружения TC_INSTRUMENTATION_OUTPUT
+ */
+namespace instrumentation {
+
+using Clock = std::chrono::steady_clock;
+
+class Counter {
+public:
+    void Add(uint64_t value) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_ = 0;
+};
+
+// Суммарное и максимальное время всех вызовов одной фазы
+class Timer {
+public:
+    void Record(uint64_t ns) noexcept;
+
+    uint64_t GetCount() const noexcept { return count_.load(std::memory_order_relaxed); }
+    uint64_t GetTotalNs() const noexcept { return total_ns_.load(std::memory_order_relaxed); }
+    uint64_t GetMaxNs() const noexcept { return max_ns_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> count_ = 0;
+    std::atomic<uint64_t> total_ns_ = 0;
+    std::atomic<uint64_t> max_ns_ = 0;
+};
+
+/**
+ * Гистограмма задержек с логарифмическими корзинами: в корзину i попадают значения из [2^i, 2^(i+1)) нс
+ */
+class Histogram : public Timer {
+public:
+    static constexpr size_t kBucketCount = 40;
+
+    void Record(uint64_t ns) noexcept;
+
+    uint64_t GetBucket(size_t idx) const noexcept {
+        return buckets_[idx].load(std::memory_order_relaxed);
+    }
+
+    // Верхняя граница корзины, в которую попадает заданный процентиль
+    uint64_t GetPercentileUpperNs(double percentile) const noexcept;
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+};
+
+class Registry {
+public:
+    static Registry& Instance();
+
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+    ~Registry();
+
+    /**
+     * Возвращаемые ссылки действительны до конца работы программы,
+     * поэтому в точках замера их достаточно получить один раз
+     */
+    Counter& GetCounter(std::string_view name);
+    Timer& GetTimer(std::string_view name);
+    Histogram& GetHistogram(std::string_view name);
+
+    void Dump(std::ostream& out) const;
+
+private:
+    Registry() = default;
+
+    template <typename T>
+    using Storage = std::map<std::string, std::unique_ptr<T>, std::less<>>;
+
+    mutable std::mutex mutex_;
+    Storage<Counter> counters_;
+    Storage<Timer> timers_;
+    Storage<Histogram> histograms_;
+
+    template <typename T>
+    T& GetOrCreate(Storage<T>& storage, std::string_view name);
+};
+
+// Записывает время жизни объекта в таймер или гистограмму
+template <typename Sink>
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Sink& sink) noexcept : sink_(sink), start_(Clock::now()) {}
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_);
+        sink_.Record(static_cast<uint64_t>(elapsed.count()));
+    }
+
+private:
+    Sink& sink_;
+    Clock::time_point start_;
+};
+
+} // namespace instrumentation
+
+#ifdef TRANSPORT_CATALOGUE_INSTRUMENTATION
+
+#define TC_INSTRUMENTATION_CONCAT_IMPL(a, b) a##b
+#define TC_INSTRUMENTATION_CONCAT(a, b) TC_INSTRUMENTATION_CONCAT_IMPL(a, b)
+#define TC_INSTRUMENTATION_VAR(prefix) TC_INSTRUMENTATION_CONCAT(prefix, __LINE__)
+
+// Замер времени до конца текущей области видимости. `name` должен быть неизменным для точки замера
+#define TC_SCOPED_TIMER(name)                                                                                   \
+    static ::instrumentation::Timer& TC_INSTRUMENTATION_VAR(tc_timer_) =                                        \
+        ::instrumentation::Registry::Instance().GetTimer(name);                                                 \
+    ::instrumentation::ScopedTimer<::instrumentation::Timer> TC_INSTRUMENTATION_VAR(tc_scoped_timer_)(          \
+        TC_INSTRUMENTATION_VAR(tc_timer_))
+
+#define TC_COUNTER_ADD(name, value)                                                                             \
+    do {                                                                                                        \
+        static ::instrumentation::Counter& tc_counter = ::instrumentation::Registry::Instance().GetCounter(name); \
+        tc_counter.Add(static_cast<uint64_t>(value));                                                           \
+    } while (false)
+
+// Замер задержки в гистограмму. Имя может вычисляться во время выполнения (например, по типу запроса)
+#define TC_SCOPED_LATENCY(name)                                                                                 \
+    ::instrumentation::ScopedTimer<::instrumentation::Histogram> TC_INSTRUMENTATION_VAR(tc_scoped_latency_)(    \
+        ::instrumentation::Registry::Instance().GetHistogram(name))
+
+#else
+
+#define TC_SCOPED_TIMER(name) static_cast<void>(0)
+#define TC_COUNTER_ADD(name, value) static_cast<void>(0)
+#define TC_SCOPED_LATENCY(name) static_cast<void>(0)
+
+#endif
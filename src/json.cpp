@@ -1,6 +1,8 @@
 #include "json.h"
 
-#include <cctype>
+#include <charconv>
+#include <iterator>
+#include <string_view>
 #include <type_traits>
 
 using namespace std;
@@ -9,32 +11,113 @@ namespace json {
 
 namespace {
 
-Node LoadNode(istream& input);
+/**
+ * Источники символов для парсера. Парсер - шаблон от источника, поэтому вызовы для непрерывного буфера встраиваются,
+ * а поток читается через его буфер без sentry istream на каждый символ
+ */
 
-Node LoadArray(istream& input) {
-    Array result;
+// Читает из буфера потока
+class StreamSource {
+public:
+    explicit StreamSource(istream& input) : buf_(input.rdbuf()) {}
+
+    int Peek() {
+        return buf_->sgetc();
+    }
+
+    bool Get(char& c) {
+        const int ch = buf_->sbumpc();
+        if (ch == EOF) {
+            return false;
+        }
+        c = static_cast<char>(ch);
+        return true;
+    }
+
+    void Unget() {
+        buf_->sungetc();
+    }
+
+private:
+    streambuf* buf_;
+};
+
+// Читает из непрерывного буфера, например отображенного в память файла
+class BufferSource {
+public:
+    explicit BufferSource(string_view input) : pos_(input.data()), end_(input.data() + input.size()) {}
+
+    int Peek() const {
+        return pos_ == end_ ? EOF : static_cast<unsigned char>(*pos_);
+    }
+
+    bool Get(char& c) {
+        if (pos_ == end_) {
+            return false;
+        }
+        c = *pos_++;
+        return true;
+    }
+
+    void Unget() {
+        --pos_;
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+};
+
+// Те же пробельные символы, что пропускает std::ws в локали "C"
+bool IsSpace(int c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+template <typename Source>
+void SkipWs(Source& input) {
+    while (IsSpace(input.Peek())) {
+        char c;
+        input.Get(c);
+    }
+}
+
+template <typename Source>
+Node LoadNode(Source& input);
+
+// Читает элементы массива до закрывающей ']' включительно, сам элемент читает `load_item`
+template <typename Source, typename LoadItem>
+void ReadArray(Source& input, LoadItem load_item) {
     bool wait_comma = false;
     char c;
     
-    while (input >> ws) {
-        if (input.peek() == ']') {
-            input.get(c);
-            return Node(move(result));
+    for (SkipWs(input); input.Peek() != EOF; SkipWs(input)) {
+        if (input.Peek() == ']') {
+            input.Get(c);
+            return;
         }
 
         if (wait_comma) {
-            if (!input.get(c) || c != ',') {
+            if (!input.Get(c) || c != ',') {
                 throw ParsingError("Between array items must be ','");
             }
         }
         
-        result.emplace_back(LoadNode(input));
+        load_item();
         wait_comma = true;
     }
 
     throw ParsingError("Unclosed array");
 }
 
+template <typename Source>
+Node LoadArray(Source& input) {
+    Array result;
+    ReadArray(input, [&input, &result] {
+        result.emplace_back(LoadNode(input));
+    });
+    return Node(move(result));
+}
+
 char ReadEscapeSequence(char c) {
     switch(c) {
         case 'n' : return '\n';
@@ -47,12 +130,13 @@ char ReadEscapeSequence(char c) {
 
 }
 
-Node LoadString(istream& input) {
+template <typename Source>
+Node LoadString(Source& input) {
     string line;
     char c;
-    while (input.get(c)) { // Выход из функции при закрытии скобки в цикле
+    while (input.Get(c)) { // Выход из функции при закрытии скобки в цикле
         if (c == '\\') {
-            if (!input.get(c)) throw ParsingError("Unfinished escape sequence");
+            if (!input.Get(c)) throw ParsingError("Unfinished escape sequence");
             line += ReadEscapeSequence(c);
         } else if (c == '\"') {
             return Node(move(line));
@@ -64,64 +148,80 @@ Node LoadString(istream& input) {
     throw ParsingError("Unclosed string");
 }
 
-Node LoadDict(istream& input) {
-    Dict result;
+// Читает пары словаря до закрывающей '}' включительно. `load_value(key)` вызывается после ':' и читает значение
+template <typename Source, typename LoadValue>
+void ReadDict(Source& input, LoadValue load_value) {
     char c;
     bool wait_comma = false;
     
-    // пока инпут не сломан, цикл будет продолжаться. Выход из цикла по break
     // На каждой итерации удаляются пробелы, т.к. после запятой они могут быть или на первой итерации перед }
-    while (input >> ws) {
-        if (input.peek() == '}') {
-            input.get(c);
-            return Node(move(result));
+    for (SkipWs(input); input.Peek() != EOF; SkipWs(input)) {
+        if (input.Peek() == '}') {
+            input.Get(c);
+            return;
         }
 
         if (wait_comma) {
-            if (!input.get(c) || c != ',') {
+            if (!input.Get(c) || c != ',') {
                 throw ParsingError("Between dictionary items must be ','");
             }
         }
 
         string key = LoadNode(input).AsString(); // Ключ - строка. AsString кинет исключение если прочтется не строка
         
-        input >> ws;
-        if (!input.get(c) || c != ':') {
+        SkipWs(input);
+        if (!input.Get(c) || c != ':') {
             throw ParsingError("Invalid dictionary format");
         }
 
-        // Если LoadNode попытается прочесть неверный json-объект, будет выброшено исключение
-        result.emplace(move(key), LoadNode(input));
+        load_value(move(key));
         wait_comma = true;
     }
 
     throw ParsingError("Unclosed dictionary");
 }
 
-Node LoadNull(istream& input) {
+template <typename Source>
+Node LoadDict(Source& input) {
+    Dict result;
+    ReadDict(input, [&input, &result](string key) {
+        // Если LoadNode попытается прочесть неверный json-объект, будет выброшено исключение
+        result.emplace(move(key), LoadNode(input));
+    });
+    return Node(move(result));
+}
+
+// После литерала должен идти конец входа или разделитель
+bool IsLiteralEnd(int next) {
+    static const string kValidTerminators = " ,}]:\n\t";
+    return next == EOF || kValidTerminators.find(static_cast<char>(next)) != kValidTerminators.npos;
+}
+
+template <typename Source>
+Node LoadNull(Source& input) {
     constexpr std::string_view kNullStr = "null"sv;
-    for (char c : kNullStr) {
-        if (input.get() != c) {
+    for (char expected : kNullStr) {
+        char c;
+        if (!input.Get(c) || c != expected) {
             throw ParsingError("Expected 'null'");
         }
     }
 
-    auto next = input.peek();
-    static const string kValidTerminators = " ,}]:\n\t";
-    if (next == EOF || kValidTerminators.find(static_cast<char>(next)) != kValidTerminators.npos) {
+    if (IsLiteralEnd(input.Peek())) {
         return Node(nullptr);
     }
     throw ParsingError("Expected 'null'");
 }
 
-Node LoadBool(istream& input) {
+template <typename Source>
+Node LoadBool(Source& input) {
     constexpr string_view kTrueStr = "true";
     constexpr string_view kFalseStr = "false";
     
     string_view compare_str;
     bool result;
 
-    if (input.peek() == 't') {
+    if (input.Peek() == 't') {
         compare_str = kTrueStr;
         result = true;
     } else {
@@ -129,45 +229,49 @@ Node LoadBool(istream& input) {
         result = false;
     }
 
-    for (char c : compare_str) {
-        if (input.get() != c) {
+    for (char expected : compare_str) {
+        char c;
+        if (!input.Get(c) || c != expected) {
             throw ParsingError("text");
         }
     }
 
-    auto next = input.peek();
-    static const string kValidTerminators = " ,}]:\n\t";
-    if (next == EOF || kValidTerminators.find(static_cast<char>(next)) != kValidTerminators.npos) {
+    if (IsLiteralEnd(input.Peek())) {
         return Node(result);
     }
     throw ParsingError("text");
 }
 
-Node LoadNum(std::istream& input) {
+bool IsDigit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+template <typename Source>
+Node LoadNum(Source& input) {
     std::string parsed_num;
 
+    // Вызывается только после Peek, поэтому символ всегда есть
     auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream");
-        }
+        char c = 0;
+        input.Get(c);
+        parsed_num += c;
     };
 
     auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
+        if (!IsDigit(input.Peek())) {
             throw ParsingError("A digit is expected");
         }
 
-        while (std::isdigit(input.peek())) {
+        while (IsDigit(input.Peek())) {
             read_char();
         }
     };
 
-    if (input.peek() == '-') {
+    if (input.Peek() == '-') {
         read_char();
     }
 
-    if (input.peek() == '0') {
+    if (input.Peek() == '0') {
         read_char();
     } else {
         read_digits();
@@ -175,16 +279,16 @@ Node LoadNum(std::istream& input) {
 
     bool is_int = true;
     // Парсим дробную часть числа
-    if (input.peek() == '.') {
+    if (input.Peek() == '.') {
         read_char();
         read_digits();
         is_int = false;
     }
 
     // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
+    if (int ch = input.Peek(); ch == 'e' || ch == 'E') {
         read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
+        if (ch = input.Peek(); ch == '+' || ch == '-') {
             read_char();
         }
         read_digits();
@@ -203,11 +307,12 @@ Node LoadNum(std::istream& input) {
     }
 }
 
-Node LoadNode(istream& input) {
-    input >> ws;
+template <typename Source>
+Node LoadNode(Source& input) {
+    SkipWs(input);
     
     char c;
-    if (!input.get(c)) {
+    if (!input.Get(c)) {
         throw ParsingError("Invalid json format");
     }
 
@@ -216,32 +321,131 @@ Node LoadNode(istream& input) {
         case '{' : return LoadDict(input);
         case 't' :
         case 'f' :
-            input.putback(c);
+            input.Unget();
             return LoadBool(input);
         case 'n' :
-            input.putback(c);
+            input.Unget();
             return LoadNull(input);
         case '"':
             return LoadString(input);
         default : 
-            if (c == '-' || isdigit(c)) {
-                input.putback(c);
+            if (c == '-' || IsDigit(static_cast<unsigned char>(c))) {
+                input.Unget();
                 return LoadNum(input);
             }
             throw ParsingError("text");
     }
 }
 
+// Словарь, в котором элементы массива `streamed_key` не сохраняются, а передаются в `on_item`
+template <typename Source>
+Node LoadStreamedDict(Source& input, string_view streamed_key, const function<void(Node&&)>& on_item) {
+    SkipWs(input);
+    char c;
+    if (!input.Get(c) || c != '{') {
+        throw ParsingError("Root of streamed document must be a dictionary");
+    }
+
+    Dict result;
+    ReadDict(input, [&](string key) {
+        if (key != streamed_key) {
+            result.emplace(move(key), LoadNode(input));
+            return;
+        }
+        SkipWs(input);
+        if (!input.Get(c) || c != '[') {
+            throw ParsingError("Streamed value \""s + key + "\" must be an array");
+        }
+        ReadArray(input, [&input, &on_item] {
+            on_item(LoadNode(input));
+        });
+    });
+    return Node(move(result));
+}
+
 }  // namespace
 
 // ------------- Node to ostream --------
 
+namespace {
+
+/**
+ * Непрерывный буфер вывода. Символы копятся в строке и уходят в поток блоками не меньше kFlushSize байт,
+ * а не отдельным operator<< на каждый токен
+ */
+class OutputBuffer {
+public:
+    static constexpr size_t kFlushSize = 1 << 16;
+
+    explicit OutputBuffer(ostream& out) : out_(out) {
+        buffer_.reserve(kFlushSize * 2);
+    }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    ~OutputBuffer() {
+        Flush();
+    }
+
+    void Put(char c) {
+        buffer_.push_back(c);
+        FlushIfFull();
+    }
+
+    void Append(string_view str) {
+        // Длинная строка (например, svg карты) пишется в поток напрямую, без копирования в буфер
+        if (str.size() >= kFlushSize) {
+            Flush();
+            out_.write(str.data(), static_cast<streamsize>(str.size()));
+            return;
+        }
+        buffer_.append(str);
+        FlushIfFull();
+    }
+
+    void AppendIndent(size_t size) {
+        buffer_.append(size, ' ');
+        FlushIfFull();
+    }
+
+    void Flush() {
+        out_.write(buffer_.data(), static_cast<streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+private:
+    ostream& out_;
+    string buffer_;
+
+    void FlushIfFull() {
+        if (buffer_.size() >= kFlushSize) {
+            Flush();
+        }
+    }
+};
+
+} // namespace
+
 struct Node::PrintNode {
-    std::ostream& out;
+    OutputBuffer& out;
     uint8_t offset;
+    PrintFormat format;
 
     void PrintOffset(uint8_t value) const {
-        out << string(value * 2, ' ');
+        if (format == PrintFormat::kIndented) {
+            out.AppendIndent(value * 2);
+        }
+    }
+
+    void PrintNewLine() const {
+        if (format == PrintFormat::kIndented) {
+            out.Put('\n');
+        }
+    }
+
+    void PrintChild(const Node& node) const {
+        visit(PrintNode{out, static_cast<uint8_t>(offset + 1), format}, static_cast<const variant&>(node));
     }
 
     template <typename T>
@@ -250,77 +454,99 @@ struct Node::PrintNode {
     }
 
     void Print(nullptr_t) const {
-        out << "null";
+        out.Append("null"sv);
     }
 
     void Print(int num) const {
-        out << num;
+        char buffer[16];
+        const auto result = to_chars(begin(buffer), end(buffer), num);
+        out.Append({buffer, static_cast<size_t>(result.ptr - buffer)});
     }
 
+    // С отступами число выводится как operator<< с точностью по умолчанию (6 значащих цифр),
+    // без отступов - кратчайшей записью, которая читается обратно в то же значение
     void Print(double num) const {
-        out << num;
+        char buffer[32];
+        const auto result = format == PrintFormat::kIndented
+            ? to_chars(begin(buffer), end(buffer), num, chars_format::general, 6)
+            : to_chars(begin(buffer), end(buffer), num);
+        out.Append({buffer, static_cast<size_t>(result.ptr - buffer)});
     }
 
-    string TranscriptEscapedSimbol(char c) const {
+    static string_view GetEscapeSequence(char c) {
         switch (c) {
-            case '\"': return "\\\"";
-            case '\\': return "\\\\";
-            case '\n': return "\\n";
-            case '\r': return "\\r";
-            case '\t': return "\\t";
-            default: return string(1, c);
+            case '\"': return "\\\""sv;
+            case '\\': return "\\\\"sv;
+            case '\n': return "\\n"sv;
+            case '\r': return "\\r"sv;
+            case '\t': return "\\t"sv;
+            default: return {};
         }
     }
 
     void Print(const string& str) const {
-        string escaped;
-        escaped.reserve(str.size() * 1.1); // С эскейп последовательностями строка будет больше исходной
-        for (const auto c : str) {
-            escaped += TranscriptEscapedSimbol(c);
+        out.Put('"');
+        // Участки без экранируемых символов копируются целиком
+        size_t run_start = 0;
+        for (size_t i = 0; i < str.size(); ++i) {
+            const string_view escape = GetEscapeSequence(str[i]);
+            if (escape.empty()) {
+                continue;
+            }
+            out.Append(string_view(str).substr(run_start, i - run_start));
+            out.Append(escape);
+            run_start = i + 1;
         }
-        out << '\"' << escaped << '\"';
+        out.Append(string_view(str).substr(run_start));
+        out.Put('"');
     }
 
     void Print(bool val) const {
-        out << (val ? "true" : "false");
+        out.Append(val ? "true"sv : "false"sv);
     }
 
     void Print(const Array& array) const {
-        out << "[\n";
+        out.Put('[');
+        PrintNewLine();
         bool wait_comma = false;
         for (const auto& item : array) {
             if (wait_comma) {
-                out << ",\n";
+                out.Put(',');
+                PrintNewLine();
             }
             
             PrintOffset(offset + 1);
             // При принте следующих данных будет информация, что отступ отличается на 1 таб
-            item.Print(out, offset + 1);
+            PrintChild(item);
             wait_comma = true;
         }
-        out << '\n';
+        PrintNewLine();
         
         // отступ на уровне открывающейся скобки
         PrintOffset(offset);
-        out << ']';
+        out.Put(']');
     }
 
     void Print(const Dict& dict) const {
-        out << "{\n";
+        out.Put('{');
+        PrintNewLine();
         bool wait_comma = false;
-        for (auto [key, value] : dict) {
+        for (const auto& [key, value] : dict) {
             if (wait_comma) {
-                out << ",\n";
+                out.Put(',');
+                PrintNewLine();
             }
 
             PrintOffset(offset + 1);
-            out << '"' << key << "\": ";
-            value.Print(out, offset + 1);
+            out.Put('"');
+            out.Append(key);
+            out.Append(format == PrintFormat::kIndented ? "\": "sv : "\":"sv);
+            PrintChild(value);
             wait_comma = true;
         }
-        out << '\n';
+        PrintNewLine();
         PrintOffset(offset);
-        out << '}';
+        out.Put('}');
     }
 
 };
@@ -426,9 +652,10 @@ constexpr bool Node::operator!=(const Node& rhs) const noexcept {
     return !(*this == rhs);
 }
 
-void Node::Print(std::ostream& out, uint8_t offset) const {
+void Node::Print(std::ostream& out, uint8_t offset, PrintFormat format) const {
+    OutputBuffer buffer(out);
     // Та же ситуация и для visit, который так же использует публичные методы variant, которые из-за наследования стали недоступными из вне
-    visit(PrintNode{out, offset}, static_cast<const variant&>(*this));
+    visit(PrintNode{buffer, offset, format}, static_cast<const variant&>(*this));
 }
 
 // ------------- Document ---------------
@@ -450,12 +677,28 @@ bool Document::operator!=(const Document& rhs) const {
 }
 
 Document Load(istream& input) {
-    return Document{LoadNode(input)};
+    StreamSource source(input);
+    return Document{LoadNode(source)};
+}
+
+Document Load(string_view input) {
+    BufferSource source(input);
+    return Document{LoadNode(source)};
+}
+
+Document LoadStreaming(istream& input, string_view streamed_key, const function<void(Node&&)>& on_item) {
+    StreamSource source(input);
+    return Document{LoadStreamedDict(source, streamed_key, on_item)};
+}
+
+Document LoadStreaming(string_view input, string_view streamed_key, const function<void(Node&&)>& on_item) {
+    BufferSource source(input);
+    return Document{LoadStreamedDict(source, streamed_key, on_item)};
 }
 
 
-void Print(const Document& doc, std::ostream& output) {
-    doc.GetRoot().Print(output);
+void Print(const Document& doc, std::ostream& output, PrintFormat format) {
+    doc.GetRoot().Print(output, 0, format);
 }
 
 }  // namespace json
\ No newline at end of file
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <cinttypes>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
@@ -15,6 +17,12 @@ using Dict = std::map<std::string, Node>;
 using Array = std::vector<Node>;
 
 
+// Вывод с отступами и переводами строк или в одну строку без пробельных символов
+enum class PrintFormat {
+    kIndented,
+    kMinified,
+};
+
 class ParsingError : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
@@ -49,7 +57,7 @@ public:
     constexpr bool operator==(const Node& rhs) const noexcept;
     constexpr bool operator!=(const Node& rhs) const noexcept;
 
-    void Print(std::ostream& out, uint8_t offset = 0) const;
+    void Print(std::ostream& out, uint8_t offset = 0, PrintFormat format = PrintFormat::kIndented) const;
 
 private:
 
@@ -78,7 +86,15 @@ private:
 };
 
 Document Load(std::istream& input);
-
-void Print(const Document& doc, std::ostream& output);
+// Разбор из непрерывного буфера, например отображенного в память файла. Строки документа копируются из буфера
+Document Load(std::string_view input);
+/**
+ * Разбирает документ, корень которого - словарь, не собирая в памяти массив по ключу `streamed_key`: каждый его элемент
+ * передается в `on_item` сразу после разбора. В возвращенном документе этого ключа нет
+ */
+Document LoadStreaming(std::istream& input, std::string_view streamed_key, const std::function<void(Node&&)>& on_item);
+Document LoadStreaming(std::string_view input, std::string_view streamed_key, const std::function<void(Node&&)>& on_item);
+
+void Print(const Document& doc, std::ostream& output, PrintFormat format = PrintFormat::kIndented);
 
 }  // namespace json
\ No newline at end of file
@@ -1,105 +1,393 @@
 #include "json_reader.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
 #include <stdexcept>
 #include <type_traits>
 
+#include "compression.h"
+#include "instrumentation.h"
+
 using namespace std;
 using namespace json;
+using requests::BaseRequestType;
+using requests::StatRequestType;
+
+namespace {
 
-JsonReader::JsonReader(istream& input, ostream& output)
-    : output_(output), doc_(Load(input)) {
-        auto render_settings = GetRenderSettings();
-        handler_.SetRenderSettings(move(render_settings));
+/**
+ * Ключ json-словаря с заранее созданной строкой.
+ * `dict.at("literal")` на каждом обращении создает временный std::string, а здесь строка создается один раз
+ */
+template <typename T>
+class Key {
+public:
+    explicit Key(string name) : name_(move(name)) {}
+
+    decltype(auto) Get(const Dict& dict) const {
+        const Node& node = dict.at(name_);
+        if constexpr (is_same_v<T, int>) {
+            return node.AsInt();
+        } else if constexpr (is_same_v<T, double>) {
+            return node.AsDouble();
+        } else if constexpr (is_same_v<T, bool>) {
+            return node.AsBool();
+        } else if constexpr (is_same_v<T, string>) {
+            return node.AsString();
+        } else if constexpr (is_same_v<T, Array>) {
+            return node.AsArray();
+        } else if constexpr (is_same_v<T, Dict>) {
+            return node.AsMap();
+        } else {
+            static_assert(is_same_v<T, Node>, "Unsupported json key type");
+            return (node);
+        }
     }
 
+    // Значение необязательного ключа или `default_value`, если ключа нет
+    T GetOr(const Dict& dict, T default_value) const {
+        return dict.count(name_) ? T(Get(dict)) : move(default_value);
+    }
 
-void JsonReader::ParseBaseRequests() {
-    const auto& all_requests = doc_.GetRoot().AsMap();
-    const auto& base_requests = all_requests.at("base_requests").AsArray();
+    bool Contains(const Dict& dict) const {
+        return dict.count(name_) != 0;
+    }
+
+private:
+    string name_;
+};
+
+constexpr string_view kBaseRequestsKey = "base_requests"sv;
+const Key<Array> kStatRequestsKey{"stat_requests"};
+const Key<int> kIdKey{"id"};
+const Key<string> kTypeKey{"type"};
+const Key<string> kNameKey{"name"};
+const Key<double> kLatitudeKey{"latitude"};
+const Key<double> kLongitudeKey{"longitude"};
+const Key<Dict> kRoadDistancesKey{"road_distances"};
+const Key<Array> kStopsKey{"stops"};
+const Key<bool> kIsRoundtripKey{"is_roundtrip"};
+const Key<string> kFromKey{"from"};
+const Key<string> kToKey{"to"};
+const Key<string> kBusKey{"bus"};
+const Key<Array> kSourcesKey{"sources"};
+const Key<Array> kTargetsKey{"targets"};
+const Key<double> kMaxTimeKey{"max_time"};
+const Key<bool> kRenderMapKey{"render_map"};
+const Key<Dict> kRoutingSettingsKey{"routing_settings"};
+const Key<int> kRouteCacheCapacityKey{"route_cache_capacity"};
+const Key<Array> kDeparturesKey{"departures"};
+const Key<Dict> kTimetableKey{"timetable"};
+const Key<double> kFirstDepartureKey{"first_departure"};
+const Key<double> kLastDepartureKey{"last_departure"};
+const Key<double> kHeadwayKey{"headway"};
+const Key<double> kDepartureTimeKey{"departure_time"};
+const Key<int> kWaitTimeKey{"wait_time"};
+const Key<double> kVelocityKey{"velocity"};
+const Key<int> kCountKey{"count"};
+const Key<string> kCompressionKey{"compression"};
+const Key<Dict> kRenderSettingsKey{"render_settings"};
+const Key<double> kWidthKey{"width"};
+const Key<double> kHeightKey{"height"};
+const Key<double> kPaddingKey{"padding"};
+const Key<double> kLineWidthKey{"line_width"};
+const Key<double> kStopRadiusKey{"stop_radius"};
+const Key<double> kBusLabelFontSizeKey{"bus_label_font_size"};
+const Key<Array> kBusLabelOffsetKey{"bus_label_offset"};
+const Key<double> kStopLabelFontSizeKey{"stop_label_font_size"};
+const Key<Array> kStopLabelOffsetKey{"stop_label_offset"};
+const Key<Node> kUnderlayerColorKey{"underlayer_color"};
+const Key<double> kUnderlayerWidthKey{"underlayer_width"};
+const Key<Array> kColorPaletteKey{"color_palette"};
+const Key<double> kBusVelocityKey{"bus_velocity"};
+const Key<int> kBusWaitTimeKey{"bus_wait_time"};
+const Key<string> kStrategyKey{"strategy"};
+
+// Количество маршрутов в ответе на Alternatives, если ключ "count" не задан
+constexpr int kDefaultAlternativesCount = 3;
+// Остановки из "base_requests" добавляются в каталог частями такого размера, пока читается остальной массив
+constexpr size_t kStopsChunkSize = 4096;
+// Наибольшее количество отправлений интервального расписания одного автобуса: интервал в минуту на неделю
+constexpr size_t kMaxTimetableDepartures = 7 * 24 * 60;
+// Единственный поддерживаемый способ сжатия карты
+constexpr string_view kDeflateCompression = "deflate"sv;
+
+// Словарь {"total_time", "items"} с шагами маршрута
+Node BuildRouteNode(const domain::dto::RouteResponse& route) {
+    Builder builder;
     
-    auto [stops_prop, buses_prop] = SplitRequests(base_requests);
+    auto array = builder.StartArray();
+
+    for (const auto& route_item : route.items) {
+        std::visit([&array](auto&& item) {
+            using Type = std::decay_t<decltype(item)>;
+            if constexpr (std::is_same_v<Type, domain::dto::Waiting>) {
+                array.Value(Node(
+                    Builder()
+                        .StartDict()
+                            .Key("type").Value("Wait")
+                            .Key("time").Value(item.time)
+                            .Key("stop_name").Value(item.stop_name)
+                        .EndDict()
+                    .Build()
+                ).GetValue());
+            } else if constexpr (std::is_same_v<Type, domain::dto::Trip>){
+                array.Value(Node(
+                    Builder()
+                        .StartDict()
+                            .Key("type").Value("Bus")
+                            .Key("time").Value(item.time)
+                            .Key("span_count").Value(item.span_count)
+                            .Key("bus").Value(item.bus)
+                        .EndDict()
+                    .Build()
+                ).GetValue());
+            }
+        }, std::move(route_item));
+    }
+
+    Node items = array.EndArray().Build();
+
+    return Builder()
+        .StartDict()
+            .Key("total_time").Value(route.total_time)
+            .Key("items").Value(items.GetValue())
+        .EndDict()
+    .Build();
+}
+
+// Ответ на запрос Route без "request_id": маршрут или сообщение, что пути нет
+Node BuildRouteOrError(const optional<domain::dto::RouteResponse>& route) {
+    if (!route.has_value()) {
+        return Builder()
+            .StartDict()
+                .Key("error_message").Value("not found")
+            .EndDict()
+        .Build();
+    }
+    return BuildRouteNode(*route);
+}
+
+} // namespace
+
+JsonReader::JsonReader(istream& input, ostream& output, PrintFormat print_format)
+    : input_(&input), output_(output), print_format_(print_format) {
+}
+
+JsonReader::JsonReader(string_view input, ostream& output, PrintFormat print_format)
+    : input_(input), output_(output), print_format_(print_format) {
+}
+
+struct JsonReader::PendingBaseRequests {
+    struct RoadDistance {
+        uint32_t from;
+        uint32_t to;
+        int distance;
+    };
+
+    struct Bus {
+        string name;
+        vector<uint32_t> stops;
+        bool is_roundtrip = true;
+        vector<double> departures;
+        optional<double> velocity;
+    };
+
+    // Названия остановок, на которые ссылаются расстояния и маршруты, хранятся по одному разу, а ссылки на них - номера.
+    // deque не перемещает строки при росте, поэтому ключи name_ids остаются верными
+    deque<string> names;
+    unordered_map<string_view, uint32_t> name_ids;
+    vector<RoadDistance> distances;
+    vector<Bus> buses;
+
+    uint32_t Intern(const string& name) {
+        if (const auto it = name_ids.find(name); it != name_ids.end()) {
+            return it->second;
+        }
+        const auto id = static_cast<uint32_t>(names.size());
+        name_ids.emplace(names.emplace_back(name), id);
+        return id;
+    }
+};
 
-    ParseStops(stops_prop);
-    SetRoadDistances(stops_prop);
-    ParseBuses(buses_prop);
-    handler_.RouterInitialization(GetRoutingSettings());
+void JsonReader::ParseBaseRequests() {
+    TC_SCOPED_TIMER("base_requests.total");
+    PendingBaseRequests pending;
+    vector<Node> stops_prop;
+    stops_prop.reserve(kStopsChunkSize);
+
+    auto on_request = [&](Node&& request) {
+        const auto& type_name = kTypeKey.Get(request.AsMap());
+        auto type = requests::kBaseRequestTypes.Find(type_name);
+        if (!type.has_value()) {
+            throw runtime_error("Unable type \""s + type_name + "\" in \"base_requests\" on json");
+        }
+
+        switch (*type) {
+            case BaseRequestType::kBus:
+                StageBus(request.AsMap(), pending);
+                break;
+            case BaseRequestType::kStop:
+                stops_prop.push_back(move(request));
+                if (stops_prop.size() == kStopsChunkSize) {
+                    ParseStops(stops_prop, pending);
+                    stops_prop.clear();
+                }
+                break;
+            case BaseRequestType::kCount:
+                break;
+        }
+    };
+    doc_ = visit([&on_request](auto input) {
+        if constexpr (is_same_v<decltype(input), istream*>) {
+            return LoadStreaming(*input, kBaseRequestsKey, on_request);
+        } else {
+            return LoadStreaming(input, kBaseRequestsKey, on_request);
+        }
+    }, input_);
+    ParseStops(stops_prop, pending);
+    SetRoadDistances(pending);
+    ParseBuses(pending);
+
+    handler_.SetRenderSettings(GetRenderSettings());
+    handler_.SetRoutingSettings(GetRoutingSettings());
+    // Роутер строится в фоне, пока обрабатываются запросы, которым он не нужен. Без запросов маршрутов не строится вовсе
+    if (HasRouterRequests()) {
+        handler_.StartRouterInitialization();
+    }
+    // Емкость задается ключом "route_cache_capacity" в routing_settings, 0 отключает кэш
+    handler_.SetRouteCacheCapacity(GetRouteCacheCapacity());
 }
 
 void JsonReader::ParseStatRequests() {
+    TC_SCOPED_TIMER("stat_requests.total");
+    static constexpr StatRequestHandlers kHandlers =
+        MakeStatRequestHandlers(make_index_sequence<static_cast<size_t>(StatRequestType::kCount)>{});
+
     const auto& all_requests = doc_.GetRoot().AsMap();
-    const auto& stat_requests = all_requests.at("stat_requests").AsArray();
+    const auto& stat_requests = kStatRequestsKey.Get(all_requests);
+
+    RoutePlan route_plan = PlanRouteRequests(stat_requests);
 
     Builder builder;
     auto array = builder.StartArray();
 
     for (const auto& request : stat_requests) {
         const auto& request_prop = request.AsMap();
-        int id = request_prop.at("id").AsInt();
-        const auto& type = request_prop.at("type").AsString();
-        
-        if (type == "Stop") {
-            const auto& name = request_prop.at("name").AsString();
-            array.Value(MakeStopResponse(id, name).GetValue());
-        } else if (type == "Bus") {
-            const auto& name = request_prop.at("name").AsString();
-            array.Value(MakeBusResponse(id, name).GetValue());
-        } else if (type == "Map") {
-            array.Value(RenderMap(id).GetValue());
-        } else if (type == "Route") {
-            array.Value(BuildRoute(request_prop).GetValue());
-        } else {
-            throw std::runtime_error("Unable type \""s + type + "\" in \"stat_requests\" on json");
+        int id = kIdKey.Get(request_prop);
+        const auto& type_name = kTypeKey.Get(request_prop);
+
+        auto type = requests::kStatRequestTypes.Find(type_name);
+        if (!type.has_value()) {
+            throw std::runtime_error("Unable type \""s + type_name + "\" in \"stat_requests\" on json");
         }
+
+        TC_SCOPED_LATENCY("stat_requests."s + type_name);
+        StatRequestHandler handler = kHandlers[static_cast<size_t>(*type)];
+        array.Value((this->*handler)(id, request_prop, route_plan).GetValue());
     }
 
     auto json_object = array.EndArray().Build();
-    json::Print(Document{std::move(json_object)}, output_);
+    TC_SCOPED_TIMER("stat_requests.print");
+    json::Print(Document{std::move(json_object)}, output_, print_format_);
 }
 
-pair<vector<Dict>, vector<Dict>> JsonReader::SplitRequests(const Array& base_requests) const {
-    vector<Dict> stops_prop;
-    vector<Dict> buses_prop;
-    
-    for (const auto& request : base_requests) {
-        const auto& request_prop = request.AsMap();
-        const auto& type = request_prop.at("type").AsString();
-        if (type == "Bus") {
-            buses_prop.emplace_back(request_prop);
-        } else if (type == "Stop") {
-            stops_prop.emplace_back(request_prop);
-        } else {
-            throw runtime_error("Unable type \""s + type + "\" in \"base_requests\" on json");
+void JsonReader::ParseStops(const vector<Node>& stops_prop, PendingBaseRequests& pending) {
+    TC_SCOPED_TIMER("base_requests.parse_stops");
+    TC_COUNTER_ADD("catalogue.stops", stops_prop.size());
+
+    vector<domain::dto::StopDescription> stops;
+    stops.reserve(stops_prop.size());
+
+    for (const auto& stop_node : stops_prop) {
+        const auto& stop = stop_node.AsMap();
+        const string& name = kNameKey.Get(stop);
+        double lat = kLatitudeKey.Get(stop);
+        double lng = kLongitudeKey.Get(stop);
+
+        optional<int> wait_time;
+        if (kWaitTimeKey.Contains(stop)) {
+            wait_time = kWaitTimeKey.Get(stop);
+            if (*wait_time < 0) {
+                throw invalid_argument("Stop wait_time should be non-negative");
+            }
+        }
+        stops.push_back({name, {lat, lng}, wait_time});
+
+        // Расстояние может ссылаться на еще не прочитанную остановку, поэтому все расстояния задаются после остановок
+        const auto& road_distances = kRoadDistancesKey.Get(stop);
+        if (road_distances.empty()) {
+            continue;
+        }
+        const uint32_t from = pending.Intern(name);
+        for (const auto& [to, json_object] : road_distances) {
+            pending.distances.push_back({from, pending.Intern(to), json_object.AsInt()});
         }
     }
 
-    return {move(stops_prop), move(buses_prop)};
+    handler_.AddStops(stops);
 }
 
-void JsonReader::ParseStops(const vector<Dict>& stops_prop) {
-    for (const auto& stop : stops_prop) {
-        string_view name = stop.at("name").AsString();
-        double lat = stop.at("latitude").AsDouble();
-        double lng = stop.at("longitude").AsDouble();
-        handler_.AddStop(name, {lat, lng});
+void JsonReader::StageBus(const Dict& bus, PendingBaseRequests& pending) const {
+    auto& staged = pending.buses.emplace_back();
+    staged.name = kNameKey.Get(bus);
+    const auto& stops = kStopsKey.Get(bus);
+    if (stops.empty()) {
+        return;
+    }
+
+    if (kVelocityKey.Contains(bus)) {
+        staged.velocity = kVelocityKey.Get(bus);
+        if (!(*staged.velocity > 0.0)) {
+            throw invalid_argument("Bus velocity should be positive");
+        }
     }
+
+    staged.is_roundtrip = kIsRoundtripKey.Get(bus);
+    staged.stops.reserve(stops.size());
+    for (const auto& stop : stops) {
+        staged.stops.push_back(pending.Intern(stop.AsString()));
+    }
+    staged.departures = ParseDepartures(bus);
+}
+
+void JsonReader::SetRoadDistances(const PendingBaseRequests& pending) {
+    TC_SCOPED_TIMER("base_requests.set_road_distances");
+
+    vector<domain::dto::RoadDistanceDescription> distances;
+    distances.reserve(pending.distances.size());
+    for (const auto& [from, to, distance] : pending.distances) {
+        distances.push_back({pending.names[from], pending.names[to], distance});
+    }
+
+    handler_.SetRoadDistances(distances);
 }
 
-void JsonReader::SetRoadDistances(const vector<Dict>& stops_prop) {
-    for (const auto& stop : stops_prop) {
-        string_view from = stop.at("name").AsString();
-        const auto& road_distances = stop.at("road_distances").AsMap();
-        for (const auto& [to_str, json_object] : road_distances) {
-            auto distance = json_object.AsInt();
-            std::string_view to = to_str;
-            handler_.SetRoadDistance(from, to, distance);
+void JsonReader::ParseBuses(PendingBaseRequests& pending) {
+    TC_SCOPED_TIMER("base_requests.parse_buses");
+    TC_COUNTER_ADD("catalogue.buses", pending.buses.size());
+
+    vector<domain::dto::BusDescription> buses;
+    buses.reserve(pending.buses.size());
+
+    for (auto& bus : pending.buses) {
+        vector<string_view> stops;
+        stops.reserve(bus.stops.size());
+        for (const uint32_t id : bus.stops) {
+            stops.push_back(pending.names[id]);
         }
+        buses.push_back({bus.name, move(stops), bus.is_roundtrip, move(bus.departures), bus.velocity});
     }
+
+    handler_.AddBuses(buses);
 }
 
 vector<string_view> JsonReader::CreateRoute(const Array &stops) const {
     // Результат функции в string_view, т.к. результат этой функции используется полностью
-    // до выхода из области видимости вызывающей функции (AddBuses)
+    // до выхода из области видимости вызывающей функции
     // а создание sv из const string& проходит быстрее, чем создание string
     vector<string_view> result;
     size_t size = stops.size();
@@ -112,23 +400,43 @@ vector<string_view> JsonReader::CreateRoute(const Array &stops) const {
     return result;
 }
 
-void JsonReader::ParseBuses(const vector<Dict>& buses_prop) {
-    for (const auto& bus : buses_prop) {
-        string_view name = bus.at("name").AsString();
-        const auto& stops = bus.at("stops").AsArray();
-        
-        if (stops.empty()) {
-            handler_.AddBus(name, {}, true);
-            continue;
+vector<double> JsonReader::ParseDepartures(const Dict& bus) const {
+    vector<double> result;
+    if (kDeparturesKey.Contains(bus)) {
+        const auto& departures = kDeparturesKey.Get(bus);
+        result.reserve(departures.size());
+        for (const auto& departure : departures) {
+            result.push_back(departure.AsDouble());
+        }
+        sort(result.begin(), result.end());
+    } else if (kTimetableKey.Contains(bus)) {
+        // Интервальное расписание разворачивается в список отправлений, дальше они не различаются
+        const auto& timetable = kTimetableKey.Get(bus);
+        const double first = kFirstDepartureKey.Get(timetable);
+        const double last = kLastDepartureKey.Get(timetable);
+        const double headway = kHeadwayKey.Get(timetable);
+        if (!(headway > 0.0)) {
+            throw invalid_argument("timetable headway should be positive");
+        }
+        if (!isfinite(first) || !isfinite(last) || first > last) {
+            throw invalid_argument("timetable first_departure should not be later than last_departure");
+        }
+        // Количество отправлений проверяется до разворачивания, иначе крошечный интервал исчерпывает память
+        const double departure_count = floor((last - first) / headway) + 1.0;
+        if (departure_count > static_cast<double>(kMaxTimetableDepartures)) {
+            throw invalid_argument("timetable has too many departures, headway is too small");
+        }
+        result.reserve(static_cast<size_t>(departure_count));
+        for (size_t i = 0; first + static_cast<double>(i) * headway <= last; ++i) {
+            result.push_back(first + static_cast<double>(i) * headway);
         }
-
-        bool is_roundtrip = bus.at("is_roundtrip").AsBool();
-        auto route = CreateRoute(stops);
-        handler_.AddBus(name, route, is_roundtrip);
     }
+    return result;
 }
 
-Node JsonReader::MakeStopResponse(int id, const string& name) const {
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kStop>(int id, const Dict& request_prop, RoutePlan&) const {
+    const auto& name = kNameKey.Get(request_prop);
     auto buses_table = handler_.GetStopStat(name);
     
     if (!buses_table.has_value()) {
@@ -166,7 +474,9 @@ Node JsonReader::MakeStopResponse(int id, const string& name) const {
     .Build();
 }
 
-Node JsonReader::MakeBusResponse(int id, const string& name) const {
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kBus>(int id, const Dict& request_prop, RoutePlan&) const {
+    const auto& name = kNameKey.Get(request_prop);
     auto stats = handler_.GetBusStat(name); 
     if (!stats.has_value()) {
         return Builder()
@@ -188,7 +498,140 @@ Node JsonReader::MakeBusResponse(int id, const string& name) const {
     .Build();
 }
 
-Node JsonReader::RenderMap(int id) const {
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kAlternatives>(int id, const Dict& request_prop, RoutePlan&) const {
+    const int count = kCountKey.GetOr(request_prop, kDefaultAlternativesCount);
+    if (count < 1) {
+        throw invalid_argument("Alternatives count should be positive");
+    }
+
+    const auto routes = handler_.BuildAlternativeRoutes(kFromKey.Get(request_prop), kToKey.Get(request_prop),
+                                                        static_cast<size_t>(count));
+    if (!routes.has_value() || routes->empty()) {
+        return Builder()
+            .StartDict()
+                .Key("request_id").Value(id)
+                .Key("error_message").Value("not found")
+            .EndDict()
+        .Build();
+    }
+
+    Array array;
+    array.reserve(routes->size());
+    for (const auto& route : *routes) {
+        array.push_back(BuildRouteNode(route));
+    }
+    return Builder()
+        .StartDict()
+            .Key("request_id").Value(id)
+            .Key("routes").Value(move(array))
+        .EndDict()
+    .Build();
+}
+
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kParetoRoute>(int id, const Dict& request_prop, RoutePlan&) const {
+    const auto routes = handler_.BuildParetoRoutes(kFromKey.Get(request_prop), kToKey.Get(request_prop));
+    if (!routes.has_value() || routes->empty()) {
+        return Builder()
+            .StartDict()
+                .Key("request_id").Value(id)
+                .Key("error_message").Value("not found")
+            .EndDict()
+        .Build();
+    }
+
+    Array array;
+    array.reserve(routes->size());
+    for (const auto& [route, transfers] : *routes) {
+        Node node = BuildRouteNode(route);
+        get<Dict>(node.GetValue()).emplace("transfers"s, transfers);
+        array.push_back(move(node));
+    }
+    return Builder()
+        .StartDict()
+            .Key("request_id").Value(id)
+            .Key("routes").Value(move(array))
+        .EndDict()
+    .Build();
+}
+
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kMemory>(int id, const Dict&, RoutePlan&) const {
+    // В json нет целых шире int, поэтому большие размеры выводятся дробным числом
+    auto to_number = [](size_t value) {
+        return value <= static_cast<size_t>(numeric_limits<int>::max()) ? Node(static_cast<int>(value))
+                                                                        : Node(static_cast<double>(value));
+    };
+
+    const auto [report, router_building] = handler_.GetMemoryUsage();
+    size_t total_bytes = 0;
+    Array structures;
+    structures.reserve(report.size());
+    for (const auto& usage : report) {
+        total_bytes += usage.bytes;
+        Dict item{
+            {"name"s, usage.name},
+            {"bytes"s, to_number(usage.bytes)},
+            {"count"s, to_number(usage.count)}
+        };
+        if (usage.load_factor) {
+            item.emplace("load_factor"s, *usage.load_factor);
+        }
+        structures.emplace_back(move(item));
+    }
+
+    Node result = Builder()
+        .StartDict()
+            .Key("request_id"s).Value(id)
+            .Key("total_bytes"s).Value(to_number(total_bytes).GetValue())
+            .Key("structures"s).Value(move(structures))
+        .EndDict()
+    .Build();
+    // Запрос не ждет фонового построения роутера, и память роутера в ответ не попадает
+    if (router_building) {
+        get<Dict>(result.GetValue()).emplace("router_building"s, true);
+    }
+    return result;
+}
+
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kBusSegment>(int id, const Dict& request_prop, RoutePlan&) const {
+    auto segment = handler_.GetBusSegment(kBusKey.Get(request_prop), kFromKey.Get(request_prop), kToKey.Get(request_prop));
+    if (!segment.has_value()) {
+        return Builder()
+            .StartDict()
+                .Key("request_id"s).Value(id)
+                .Key("error_message"s).Value("not found"s)
+            .EndDict()
+        .Build();
+    }
+
+    return Builder()
+        .StartDict()
+            .Key("request_id"s).Value(id)
+            .Key("route_length"s).Value(segment->road_distance)
+            .Key("span_count"s).Value(segment->span_count)
+        .EndDict()
+    .Build();
+}
+
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kMap>(int id, const Dict& request_prop, RoutePlan&) const {
+    // Со сжатием карта выводится в base64 и не экранируется, а несжатый svg целиком в памяти не собирается
+    if (kCompressionKey.Contains(request_prop)) {
+        const auto& method = kCompressionKey.Get(request_prop);
+        if (method != kDeflateCompression) {
+            throw invalid_argument("Unknown map compression \""s + method + "\""s);
+        }
+        return Builder()
+            .StartDict()
+                .Key("request_id"s).Value(id)
+                .Key("compressed_map"s).Value(compression::EncodeBase64(handler_.RenderCompressedMap()))
+            .EndDict()
+        .Build();
+    }
+
     string render_map = handler_.RenderMap();
     return Builder()
         .StartDict()
@@ -198,12 +641,87 @@ Node JsonReader::RenderMap(int id) const {
     .Build();
 }
 
-Node JsonReader::BuildRoute(const json::Dict& request_prop) const {
-    int id = request_prop.at("id").AsInt();
-    const string& from = request_prop.at("from").AsString();
-    const string& to = request_prop.at("to").AsString();
-    const auto& request = handler_.BuildRoute(from, to);
-    if (!request.has_value()) {
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kRoute>(int id, const Dict& request_prop, RoutePlan& route_plan) const {
+    const string& from = kFromKey.Get(request_prop);
+    const string& to = kToKey.Get(request_prop);
+
+    // Ответ зависит от времени отправления, а кэш хранит только ответы без него
+    if (kDepartureTimeKey.Contains(request_prop)) {
+        Node fragment = BuildRouteFragment(from, to, kDepartureTimeKey.Get(request_prop));
+        get<Dict>(fragment.GetValue()).emplace("request_id"s, id);
+        return fragment;
+    }
+
+    // Повторные запросы отвечаются из кэша ответов в RequestHandler
+    auto fragment = FindPlannedRoute(route_plan, from, to);
+    if (!fragment.has_value()) {
+        fragment = BuildRouteFragment(from, to);
+    }
+    get<Dict>(fragment->GetValue()).emplace("request_id"s, id);
+    return move(*fragment);
+}
+
+Node JsonReader::BuildRouteFragment(const string& from, const string& to, optional<double> departure_time) const {
+    return BuildRouteOrError(handler_.BuildRoute(from, to, departure_time));
+}
+
+JsonReader::RoutePlan JsonReader::PlanRouteRequests(const Array& stat_requests) const {
+    TC_SCOPED_TIMER("stat_requests.plan_routes");
+    RoutePlan result;
+
+    // Цели каждой остановки отправления без повторов. Запросы по расписанию не планируются
+    for (const auto& request : stat_requests) {
+        const auto& request_prop = request.AsMap();
+        if (requests::kStatRequestTypes.Find(kTypeKey.Get(request_prop)) != StatRequestType::kRoute
+            || kDepartureTimeKey.Contains(request_prop)) {
+            continue;
+        }
+        result[kFromKey.Get(request_prop)].fragments.try_emplace(kToKey.Get(request_prop));
+    }
+    return result;
+}
+
+optional<Node> JsonReader::FindPlannedRoute(RoutePlan& route_plan, string_view from, string_view to) const {
+    const auto from_it = route_plan.find(from);
+    if (from_it == route_plan.end()) {
+        return nullopt;
+    }
+
+    auto& [searched, fragments] = from_it->second;
+    if (!searched) {
+        searched = true;
+        vector<string_view> targets;
+        targets.reserve(fragments.size());
+        for (const auto& [target, fragment] : fragments) {
+            targets.push_back(target);
+        }
+
+        // Единственную цель обработчик запроса посчитает обычным поиском. Если остановка не найдена,
+        // ошибку тоже выдаст обработчик запроса. Цели с ответом в кэше BuildRoutesFrom не ищет
+        auto routes = targets.size() > 1 ? handler_.BuildRoutesFrom(from, targets) : nullopt;
+        if (!routes.has_value()) {
+            route_plan.erase(from_it);
+            return nullopt;
+        }
+        for (size_t i = 0; i < targets.size(); ++i) {
+            fragments[targets[i]] = BuildRouteOrError((*routes)[i]);
+        }
+    }
+
+    const auto to_it = fragments.find(to);
+    if (to_it == fragments.end()) {
+        return nullopt;
+    }
+    return to_it->second;
+}
+
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kMatrix>(int id, const Dict& request_prop, RoutePlan&) const {
+    // Строки запроса живут в doc_, поэтому string_view остаются валидными на время обработки
+    const auto times = handler_.BuildTravelTimes(CreateRoute(kSourcesKey.Get(request_prop)),
+                                                 CreateRoute(kTargetsKey.Get(request_prop)));
+    if (!times.has_value()) {
         return Builder()
             .StartDict()
                 .Key("request_id").Value(id)
@@ -211,49 +729,64 @@ Node JsonReader::BuildRoute(const json::Dict& request_prop) const {
             .EndDict()
         .Build();
     }
-    Builder builder;
-    
-    auto array = builder.StartArray();
 
-    for (const auto& route_item : request->items) {
-        std::visit([&array](auto&& item) {
-            using Type = std::decay_t<decltype(item)>;
-            if constexpr (std::is_same_v<Type, domain::dto::Waiting>) {
-                array.Value(Node(
-                    Builder()
-                        .StartDict()
-                            .Key("type").Value("Wait")
-                            .Key("time").Value(item.time)
-                            .Key("stop_name").Value(item.stop_name)
-                        .EndDict()
-                    .Build()
-                ).GetValue());
-            } else if constexpr (std::is_same_v<Type, domain::dto::Trip>){
-                array.Value(Node(
-                    Builder()
-                        .StartDict()
-                            .Key("type").Value("Bus")
-                            .Key("time").Value(item.time)
-                            .Key("span_count").Value(item.span_count)
-                            .Key("bus").Value(item.bus)
-                        .EndDict()
-                    .Build()
-                ).GetValue());
+    // Строка матрицы - время из источника до каждой цели, null - пути нет
+    Array rows;
+    rows.reserve(times->size());
+    for (const auto& times_row : *times) {
+        Array row;
+        row.reserve(times_row.size());
+        for (const auto& time : times_row) {
+            if (time) {
+                row.emplace_back(*time);
+            } else {
+                row.emplace_back(nullptr);
             }
-        }, std::move(route_item));
+        }
+        rows.push_back(move(row));
     }
 
-    Node items = array.EndArray().Build();
-
     return Builder()
         .StartDict()
             .Key("request_id").Value(id)
-            .Key("total_time").Value(request->total_time)
-            .Key("items").Value(items.GetValue())
+            .Key("times").Value(move(rows))
         .EndDict()
     .Build();
 }
 
+template <>
+Node JsonReader::HandleStatRequest<StatRequestType::kIsochrone>(int id, const Dict& request_prop, RoutePlan&) const {
+    const auto response = handler_.BuildIsochrone(kFromKey.Get(request_prop), kMaxTimeKey.Get(request_prop),
+                                                  kRenderMapKey.GetOr(request_prop, false));
+    if (!response.has_value()) {
+        return Builder()
+            .StartDict()
+                .Key("request_id").Value(id)
+                .Key("error_message").Value("not found")
+            .EndDict()
+        .Build();
+    }
+
+    Array stops;
+    stops.reserve(response->stops.size());
+    for (const auto& item : response->stops) {
+        stops.emplace_back(Builder()
+            .StartDict()
+                .Key("stop_name").Value(item.stop->name)
+                .Key("time").Value(item.time)
+            .EndDict()
+        .Build());
+    }
+
+    Builder builder;
+    auto dict = builder.StartDict();
+    dict.Key("request_id").Value(id).Key("stops").Value(move(stops));
+    if (response->map) {
+        dict.Key("map").Value(*response->map);
+    }
+    return dict.EndDict().Build();
+}
+
 // Анонимное пространство имен для вспомогательных функций парсинга
 namespace {
 
@@ -317,50 +850,72 @@ domain::dto::Point ParsePoint(const Array& json_array) {
     throw runtime_error("Invalid point parsing from json");
 }
 
+// Необязательный ключ "strategy", по умолчанию - таблица путей между всеми парами остановок
+domain::dto::RoutingStrategy ParseRoutingStrategy(const Dict& routing_settings) {
+    if (!kStrategyKey.Contains(routing_settings)) {
+        return domain::dto::RoutingStrategy::kAllPairs;
+    }
+
+    const string& strategy = kStrategyKey.Get(routing_settings);
+    if (const auto result = requests::kRoutingStrategies.Find(strategy)) {
+        return *result;
+    }
+    throw invalid_argument("Unknown routing strategy \""s + strategy + "\""s);
+}
+
 } // namespace
 
 domain::dto::RenderSettings JsonReader::GetRenderSettings() const {
-    const auto& all_requests = doc_.GetRoot().AsMap();
-    const auto& render_settings = all_requests.at("render_settings").AsMap();
-
-    double width = render_settings.at("width").AsDouble();
-    double height = render_settings.at("height").AsDouble();
-    double padding = render_settings.at("padding").AsDouble();
-    double line_width = render_settings.at("line_width").AsDouble();
-    double stop_radius = render_settings.at("stop_radius").AsDouble();
-    double bus_label_font_size = render_settings.at("bus_label_font_size").AsDouble();
-    const Array& bus_label_offset = render_settings.at("bus_label_offset").AsArray();
-    double stop_label_font_size = render_settings.at("stop_label_font_size").AsDouble();
-    const Array& stop_label_offset = render_settings.at("stop_label_offset").AsArray();
-    const Node& underlayer_color = render_settings.at("underlayer_color");
-    double underlayer_width = render_settings.at("underlayer_width").AsDouble();
-    const Array& color_palette = render_settings.at("color_palette").AsArray();
+    const auto& render_settings = kRenderSettingsKey.Get(doc_.GetRoot().AsMap());
 
     return {
-        .width = width,
-        .height = height,
-        .padding = padding,
-        .line_width = line_width,
-        .stop_radius = stop_radius,
-        .bus_label_font_size = bus_label_font_size,
-        .stop_label_font_size = stop_label_font_size,
-        .underlayer_width = underlayer_width,
-        .bus_label_offset = ParsePoint(bus_label_offset),
-        .stop_label_offset = ParsePoint(stop_label_offset),
-        .underlayer_color = ParseColor(underlayer_color),
-        .color_palette = CreateColorPalette(color_palette)
+        .width = kWidthKey.Get(render_settings),
+        .height = kHeightKey.Get(render_settings),
+        .padding = kPaddingKey.Get(render_settings),
+        .line_width = kLineWidthKey.Get(render_settings),
+        .stop_radius = kStopRadiusKey.Get(render_settings),
+        .bus_label_font_size = kBusLabelFontSizeKey.Get(render_settings),
+        .stop_label_font_size = kStopLabelFontSizeKey.Get(render_settings),
+        .underlayer_width = kUnderlayerWidthKey.Get(render_settings),
+        .bus_label_offset = ParsePoint(kBusLabelOffsetKey.Get(render_settings)),
+        .stop_label_offset = ParsePoint(kStopLabelOffsetKey.Get(render_settings)),
+        .underlayer_color = ParseColor(kUnderlayerColorKey.Get(render_settings)),
+        .color_palette = CreateColorPalette(kColorPaletteKey.Get(render_settings))
     };
 }
 
 domain::dto::RoutingSettings JsonReader::GetRoutingSettings() const {
-    const auto& all_requests = doc_.GetRoot().AsMap();
-    const auto& routing_settings = all_requests.at("routing_settings").AsMap();
-    
-    double velocity = routing_settings.at("bus_velocity").AsDouble();
-    int wait_time = routing_settings.at("bus_wait_time").AsInt();
+    const auto& routing_settings = kRoutingSettingsKey.Get(doc_.GetRoot().AsMap());
 
     return {
-        .velocity = velocity,
-        .wait_time = wait_time
+        .velocity = kBusVelocityKey.Get(routing_settings),
+        .wait_time = kBusWaitTimeKey.Get(routing_settings),
+        .strategy = ParseRoutingStrategy(routing_settings)
     };
-}
\ No newline at end of file
+}
+
+size_t JsonReader::GetRouteCacheCapacity() const {
+    const auto& routing_settings = kRoutingSettingsKey.Get(doc_.GetRoot().AsMap());
+    const int capacity = kRouteCacheCapacityKey.GetOr(routing_settings, static_cast<int>(RouteCache::kDefaultCapacity));
+    if (capacity < 0) {
+        throw invalid_argument("route_cache_capacity should be non-negative");
+    }
+    return static_cast<size_t>(capacity);
+}
+
+bool JsonReader::HasRouterRequests() const {
+    const auto& all_requests = doc_.GetRoot().AsMap();
+    // Без "stat_requests" запросы придут по другому протоколу, и какие из них будут, заранее неизвестно
+    if (!kStatRequestsKey.Contains(all_requests)) {
+        return true;
+    }
+    const auto& stat_requests = kStatRequestsKey.Get(all_requests);
+    return any_of(stat_requests.begin(), stat_requests.end(), [](const Node& request) {
+        const auto type = requests::kStatRequestTypes.Find(kTypeKey.Get(request.AsMap()));
+        return type.has_value() && requests::UsesRouter(*type);
+    });
+}
+
+const RequestHandler& JsonReader::GetRequestHandler() const noexcept {
+    return handler_;
+}
@@ -1,37 +1,122 @@
 #pragma once
 
+#include <array>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 #include "domain.h"
 #include "json_builder.h"
 #include "request_handler.h"
+#include "request_types.h"
 
 class JsonReader {
 public:
-    JsonReader(std::istream& input, std::ostream& output);
+    // `print_format` задает вид json-ответа на stat_requests
+    JsonReader(std::istream& input, std::ostream& output, json::PrintFormat print_format = json::PrintFormat::kIndented);
+    // Документ в непрерывном буфере, например в отображенном в память файле. Буфер должен жить до конца ParseBaseRequests
+    JsonReader(std::string_view input, std::ostream& output, json::PrintFormat print_format = json::PrintFormat::kIndented);
     JsonReader(const JsonReader&) = delete;
     JsonReader& operator=(const JsonReader&) = delete;
+    // Читает входной документ и заполняет каталог. Массив "base_requests" не хранится целиком: запросы обрабатываются
+    // по мере чтения, поэтому пиковая память определяется размером каталога, а не входного текста
     void ParseBaseRequests();
     void ParseStatRequests();
+
+    // Каталог, рендер и маршрутизатор после ParseBaseRequests - общий бэкенд для других протоколов
+    const RequestHandler& GetRequestHandler() const noexcept;
     
 private:
+    std::variant<std::istream*, std::string_view> input_;
     std::ostream& output_;
-    json::Document doc_;
+    json::PrintFormat print_format_;
+    // Документ без "base_requests", читается в ParseBaseRequests
+    json::Document doc_{json::Node{}};
     RequestHandler handler_;
 
+    // Расстояния и автобусы из "base_requests", отложенные до конца массива, определена в json_reader.cpp
+    struct PendingBaseRequests;
 
-    // Разделяет запросы из `base_requests` на запросы по созданию Stop и запросы по созданию Bus
-    std::pair<std::vector<json::Dict>, std::vector<json::Dict>> SplitRequests(const json::Array& base_requests) const;
-
-    void ParseStops(const std::vector<json::Dict>& stops_prop);
-    void ParseBuses(const std::vector<json::Dict>& buses_prop);
-    void SetRoadDistances(const std::vector<json::Dict>& stops_prop);
+    // Добавляет в каталог часть прочитанных остановок, их расстояния откладываются в `pending`
+    void ParseStops(const std::vector<json::Node>& stops_prop, PendingBaseRequests& pending);
+    // Откладывает автобус до конца "base_requests": его маршрут может ссылаться на еще не прочитанные остановки
+    void StageBus(const json::Dict& bus, PendingBaseRequests& pending) const;
+    void SetRoadDistances(const PendingBaseRequests& pending);
+    void ParseBuses(PendingBaseRequests& pending);
     std::vector<std::string_view> CreateRoute(const json::Array &stops) const;
-    json::Node MakeStopResponse(int id, const std::string& name) const;
-    json::Node MakeBusResponse(int id, const std::string& name) const;
-    json::Node RenderMap(int id) const;
-    json::Node BuildRoute(const json::Dict& request_prop) const;
+    // Отправления из "departures" или из интервального "timetable". Пусто, если расписания нет
+    std::vector<double> ParseDepartures(const json::Dict& bus) const;
+
+    // Запросы Route пакета, сгруппированные по остановке отправления: RoutePlan[from].fragments[to]. Ответы всех целей
+    // остановки ищутся одним поиском при первом запросе из нее. Живет до конца ParseStatRequests, строки принадлежат doc_
+    struct PlannedOrigin {
+        bool searched = false;
+        std::unordered_map<std::string_view, json::Node> fragments;
+    };
+    using RoutePlan = std::unordered_map<std::string_view, PlannedOrigin>;
+
+    // Обработчик запроса из "stat_requests". Для каждого типа запроса определена своя специализация.
+    // `route_plan` - план запросов Route текущего пакета
+    template <requests::StatRequestType Type>
+    json::Node HandleStatRequest(int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+
+    using StatRequestHandler = json::Node (JsonReader::*)(int, const json::Dict&, RoutePlan&) const;
+    using StatRequestHandlers = std::array<StatRequestHandler, static_cast<size_t>(requests::StatRequestType::kCount)>;
+
+    // Таблица обработчиков, индексируемая значением StatRequestType, строится на этапе компиляции
+    template <size_t... Types>
+    static constexpr StatRequestHandlers MakeStatRequestHandlers(std::index_sequence<Types...>) {
+        return {&JsonReader::HandleStatRequest<static_cast<requests::StatRequestType>(Types)>...};
+    }
+
     domain::dto::RenderSettings GetRenderSettings() const;
     domain::dto::RoutingSettings GetRoutingSettings() const;
+    size_t GetRouteCacheCapacity() const;
+    // Есть ли в пакете запросы, которым нужен роутер
+    bool HasRouterRequests() const;
+
+    // Ответ на запрос Route без "request_id". С `departure_time` маршрут ищется по расписанию
+    json::Node BuildRouteFragment(const std::string& from, const std::string& to,
+                                  std::optional<double> departure_time = std::nullopt) const;
+    // Группирует запросы Route пакета по остановке отправления. Роутер здесь не нужен, поэтому запросы к каталогу
+    // и карте не ждут его фонового построения
+    RoutePlan PlanRouteRequests(const json::Array& stat_requests) const;
+    // Ответ из группы остановки `from`. При первом обращении к группе, в которой несколько целей, все они ищутся
+    // одним поиском. nullopt - маршрут надо искать отдельно
+    std::optional<json::Node> FindPlannedRoute(RoutePlan& route_plan, std::string_view from, std::string_view to) const;
 };
+
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kStop>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kBus>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kMap>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kRoute>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kMatrix>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kIsochrone>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kBusSegment>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kAlternatives>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kParetoRoute>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
+template <>
+json::Node JsonReader::HandleStatRequest<requests::StatRequestType::kMemory>(
+        int id, const json::Dict& request_prop, RoutePlan& route_plan) const;
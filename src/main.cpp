@@ -1,11 +1,79 @@
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
+#include "binary_reader.h"
 #include "json_reader.h"
+#include "mapped_file.h"
 
 using namespace std;
 
-int main() {
-    JsonReader reader(cin, cout);
+namespace {
+
+// Первый кадр - json-документ с базой и настройками, следующие - запросы двоичного протокола
+void RunBinaryProtocol() {
+    string setup;
+    if (!binary::ReadFrame(cin, setup)) {
+        return;
+    }
+    istringstream setup_input(setup);
+    JsonReader reader(setup_input, cout);
+    reader.ParseBaseRequests();
+    BinaryReader(reader.GetRequestHandler(), cin, cout).ParseStatRequests();
+}
+
+} // namespace
+
+// "--protocol binary" переключает запросы и ответы на двоичный протокол (binary_protocol.h), по умолчанию - json.
+// "--json-format minified" выводит json-ответ в одну строку без пробелов, по умолчанию - "indented" с отступами.
+// "--input <file>" читает json-документ из файла, отображенного в память, вместо stdin
+int main(int argc, char** argv) {
+    string_view protocol = "json";
+    string_view json_format = "indented";
+    string input_path;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string_view arg = argv[i];
+        if (arg == "--protocol") {
+            protocol = argv[i + 1];
+        } else if (arg == "--json-format") {
+            json_format = argv[i + 1];
+        } else if (arg == "--input") {
+            input_path = argv[i + 1];
+        } else {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    if (protocol == "binary") {
+        if (!input_path.empty()) {
+            cerr << "--input is supported only by json protocol" << endl;
+            return 1;
+        }
+        RunBinaryProtocol();
+        return 0;
+    }
+    if (protocol != "json") {
+        cerr << "Unknown protocol " << protocol << endl;
+        return 1;
+    }
+    if (json_format != "indented" && json_format != "minified") {
+        cerr << "Unknown json format " << json_format << endl;
+        return 1;
+    }
+
+    const auto print_format = json_format == "minified" ? json::PrintFormat::kMinified : json::PrintFormat::kIndented;
+    if (input_path.empty()) {
+        JsonReader reader(cin, cout, print_format);
+        reader.ParseBaseRequests();
+        reader.ParseStatRequests();
+        return 0;
+    }
+
+    const MappedFile input(input_path);
+    JsonReader reader(input.GetData(), cout, print_format);
     reader.ParseBaseRequests();
     reader.ParseStatRequests();
-}
\ No newline at end of file
+}
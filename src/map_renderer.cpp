@@ -121,6 +121,12 @@ void MapRenderer::SetRenderSettings(RenderSettings&& settings) {
  * Метод принимает отсортированные по name вектора автобусов и остановок и возвращает изображение карты в виде строки в формате svg
  */
 string MapRenderer::RenderMap(const BusVec& buses, const StopVec& stops) const {
+    ostringstream oss;
+    RenderMap(buses, stops, oss);
+    return oss.str();
+}
+
+void MapRenderer::RenderMap(const BusVec& buses, const StopVec& stops, ostream& out) const {
     Document doc;
     auto stops_coords = GetStopsCoords(stops);
     auto proj = CreateSphereProjector(stops_coords);
@@ -130,13 +136,30 @@ string MapRenderer::RenderMap(const BusVec& buses, const StopVec& stops) const {
     RenderStopsPoints(stops, proj, doc);
     RenderStopsNames(stops, proj, doc);
 
+    doc.Render(out);
+}
+
+string MapRenderer::RenderIsochrone(const StopVec& stops, const StopVec& reached) const {
+    Document doc;
+    auto proj = CreateSphereProjector(GetStopsCoords(stops));
+
+    // Достижимые остановки выделяются кругом цвета первого маршрута поверх белых кругов карты
+    Circle circle;
+    circle.SetRadius(settings_->stop_radius * 2);
+    if (!settings_->color_palette.empty()) {
+        circle.SetFillColor(settings_->color_palette.front());
+    }
+    for (const auto stop : reached) {
+        doc.Add(circle.SetCenter(proj(stop->coordinates)));
+    }
+    RenderStopsNames(reached, proj, doc);
+
     ostringstream oss;
     doc.Render(oss);
 
     return oss.str();
 }
 
-
 CoordVec MapRenderer::GetStopsCoords(const StopVec& stops) const {
     CoordVec result;
     result.reserve(stops.size());
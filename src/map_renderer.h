@@ -59,6 +59,14 @@ public:
      * Метод принимает отсортированные по name вектора с указателями на автобусы и остановки и возвращает изображение карты в виде строки в формате svg
      */
     std::string RenderMap(const BusVec& buses, const StopVec& stops) const;
+    // То же изображение, выведенное в `out` по мере рендера, без промежуточной строки
+    void RenderMap(const BusVec& buses, const StopVec& stops, std::ostream& out) const;
+
+    /**
+     * Слой поверх карты с остановками `reached`. Проекция строится по `stops` так же, как в RenderMap,
+     * поэтому при тех же `stops` слой совпадает с картой координатами
+     */
+    std::string RenderIsochrone(const StopVec& stops, const StopVec& reached) const;
 
 
 private:
@@ -0,0 +1,78 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TC_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+using namespace std;
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(const string& action, const string& path) {
+    throw runtime_error("Unable to "s + action + " \""s + path + "\": "s + strerror(errno));
+}
+
+} // namespace
+
+#ifdef TC_HAS_MMAP
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowSystemError("open", path);
+    }
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        ThrowSystemError("stat", path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+
+    // Пустой файл отобразить нельзя, для него остается пустой буфер
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            ThrowSystemError("map", path);
+        }
+        // Только подсказка ядру, ошибка не мешает чтению
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+    }
+    // Отображение остается действительным после закрытия дескриптора
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const string& path) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        ThrowSystemError("open", path);
+    }
+    content_.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    data_ = content_.data();
+    size_ = content_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
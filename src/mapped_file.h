@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * Файл, отображенный в память только для чтения. Ядро подгружает страницы по мере чтения (с MADV_SEQUENTIAL - с
+ * упреждением), поэтому содержимое не копируется в буферы потока. Там, где mmap нет (сборка MinGW), файл читается
+ * в память целиком. При ошибке открытия или отображения бросает std::runtime_error
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::string_view GetData() const noexcept {
+        return {data_, size_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::string content_;   // Содержимое файла, если отобразить его в память нельзя
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Учет памяти, занятой структурами каталога, графа и роутера. Размеры считаются по емкости контейнеров, а не по
+ * количеству элементов. Для узловых контейнеров (deque, хэш-таблицы) это оценка для libstdc++ без накладных расходов
+ * аллокатора: у deque блоки по 512 байт и массив указателей на них, у хэш-таблицы массив корзин и по узлу на элемент
+ * (указатель на следующий узел, значение и сохраненный хэш)
+ */
+namespace memory {
+
+struct Usage {
+    std::string name;
+    size_t bytes = 0;
+    size_t count = 0;                       // Количество элементов
+    std::optional<double> load_factor;      // Только для хэш-таблиц
+};
+
+using Report = std::vector<Usage>;
+
+// Память буфера строки без самого объекта строки. Короткая строка хранится внутри объекта
+inline size_t HeapBytes(const std::string& str) {
+    constexpr size_t kSsoCapacity = 15;
+    return str.capacity() > kSsoCapacity ? str.capacity() + 1 : 0;
+}
+
+// Память буфера вектора без самого объекта вектора
+template <typename T>
+size_t HeapBytes(const std::vector<T>& vec) {
+    return vec.capacity() * sizeof(T);
+}
+
+template <typename T>
+size_t HeapBytes(const std::deque<T>& deq) {
+    constexpr size_t kBlockBytes = 512;
+    constexpr size_t kItemsPerBlock = sizeof(T) < kBlockBytes ? kBlockBytes / sizeof(T) : 1;
+    // Минимальный размер массива указателей на блоки в libstdc++ - 8
+    constexpr size_t kMinMapSize = 8;
+    const size_t blocks = deq.size() / kItemsPerBlock + 1;
+    return blocks * kItemsPerBlock * sizeof(T) + std::max(kMinMapSize, blocks + 2) * sizeof(void*);
+}
+
+// Подходит и для unordered_map, и для unordered_set
+template <typename HashTable>
+size_t HashTableHeapBytes(const HashTable& table) {
+    constexpr size_t kNodeBytes = sizeof(void*) + sizeof(typename HashTable::value_type) + sizeof(size_t);
+    return table.bucket_count() * sizeof(void*) + table.size() * kNodeBytes;
+}
+
+// `extra_bytes` - память, на которую ссылаются элементы (строки, вложенные контейнеры)
+template <typename Container>
+Usage MakeUsage(std::string name, const Container& container, size_t extra_bytes = 0) {
+    return {std::move(name), sizeof(Container) + HeapBytes(container) + extra_bytes, container.size(), std::nullopt};
+}
+
+template <typename HashTable>
+Usage MakeHashTableUsage(std::string name, const HashTable& table, size_t extra_bytes = 0) {
+    return {std::move(name), sizeof(HashTable) + HashTableHeapBytes(table) + extra_bytes, table.size(), table.load_factor()};
+}
+
+// Вектор векторов: внешний буфер и буферы всех вложенных векторов, count - суммарное количество элементов
+template <typename T>
+Usage MakeNestedUsage(std::string name, const std::vector<std::vector<T>>& vec) {
+    size_t bytes = sizeof(vec) + HeapBytes(vec);
+    size_t count = 0;
+    for (const auto& inner : vec) {
+        bytes += HeapBytes(inner);
+        count += inner.size();
+    }
+    return {std::move(name), bytes, count, std::nullopt};
+}
+
+} // namespace memory
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+/**
+ * Количество потоков для обработки `work` единиц работы, если один поток должен получить не меньше `grain` единиц
+ */
+inline size_t GetThreadCount(size_t work, size_t grain = 1) {
+    const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    return std::clamp<size_t>(work / std::max<size_t>(1, grain), 1, hardware);
+}
+
+/**
+ * Постоянный пул из hardware_concurrency() - 1 потоков. Потоки живут до конца программы, поэтому их thread_local
+ * рабочие области (массивы поиска роутеров) выделяются один раз и переиспользуются между запросами
+ */
+class ThreadPool {
+public:
+    static ThreadPool& Instance() {
+        static ThreadPool pool(std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopped_ = true;
+        }
+        has_tasks_.notify_all();
+    }
+
+    void Post(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        has_tasks_.notify_one();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopped_ = false;
+    // Последнее поле: потоки останавливаются и присоединяются до разрушения очереди
+    std::vector<std::jthread> threads_;
+
+    explicit ThreadPool(size_t thread_count) {
+        threads_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this] { Work(); });
+        }
+    }
+
+    void Work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                has_tasks_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+                if (stopped_) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+/**
+ * Вызывает `func(idx)` для всех idx из [0, count). Индексы раздаются через атомарный счетчик вызывающему потоку
+ * и не более чем `thread_count` - 1 потокам пула, поэтому задачи разной длительности распределяются равномерно.
+ * Вызывающий поток не ждет свободных потоков пула: задачи, не начатые к концу его работы, отменяются, так что
+ * вложенные и одновременные вызовы не блокируют друг друга. Первое исключение из `func` пробрасывается вызывающему.
+ * При `thread_count` <= 1 все выполняется в вызывающем потоке
+ */
+template <typename Func>
+void For(size_t count, size_t thread_count, Func func) {
+    thread_count = std::min(thread_count, count);
+    if (thread_count <= 1) {
+        for (size_t idx = 0; idx < count; ++idx) {
+            func(idx);
+        }
+        return;
+    }
+
+    // Задача пула может начаться уже после возврата из For, поэтому общее состояние живет в shared_ptr,
+    // а к `func` на стеке вызывающего обращаются только задачи, начавшиеся до закрытия
+    struct Job {
+        std::atomic<size_t> next = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t active = 0;
+        bool closed = false;
+        std::exception_ptr error;
+    };
+    const auto job = std::make_shared<Job>();
+
+    auto run = [&job = *job, &func, count] {
+        try {
+            for (size_t idx = job.next.fetch_add(1, std::memory_order_relaxed); idx < count;
+                 idx = job.next.fetch_add(1, std::memory_order_relaxed)) {
+                func(idx);
+            }
+        } catch (...) {
+            job.next.store(count, std::memory_order_relaxed);
+            std::lock_guard lock(job.mutex);
+            if (!job.error) {
+                job.error = std::current_exception();
+            }
+        }
+    };
+
+    ThreadPool& pool = ThreadPool::Instance();
+    for (size_t i = 1; i < thread_count; ++i) {
+        pool.Post([job, run] {
+            {
+                std::lock_guard lock(job->mutex);
+                if (job->closed) {
+                    return;
+                }
+                ++job->active;
+            }
+            run();
+            std::lock_guard lock(job->mutex);
+            if (--job->active == 0) {
+                job->done.notify_all();
+            }
+        });
+    }
+    run();
+
+    std::unique_lock lock(job->mutex);
+    job->closed = true;
+    job->done.wait(lock, [&job] { return job->active == 0; });
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+/**
+ * Делит [0, count) на `chunk_count` непрерывных отрезков и вызывает `func(chunk_idx, begin, end)` для каждого параллельно
+ */
+template <typename Func>
+void ForEachChunk(size_t count, size_t chunk_count, Func func) {
+    chunk_count = std::max<size_t>(1, std::min(chunk_count, count));
+    const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+    For(chunk_count, chunk_count, [&func, count, chunk_size](size_t chunk_idx) {
+        const size_t begin = std::min(count, chunk_idx * chunk_size);
+        const size_t end = std::min(count, begin + chunk_size);
+        func(chunk_idx, begin, end);
+    });
+}
+
+/**
+ * Сортировка слиянием: отрезки сортируются в отдельных потоках, затем попарно сливаются,
+ * причем слияния одного уровня тоже выполняются параллельно
+ */
+template <typename RandomIt, typename Compare>
+void Sort(RandomIt first, RandomIt last, Compare comp, size_t grain = 1 << 15) {
+    const size_t count = static_cast<size_t>(std::distance(first, last));
+    const size_t chunk_count = GetThreadCount(count, grain);
+    if (chunk_count <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    // Формула размера отрезка совпадает с ForEachChunk, поэтому границы слияний совпадают с границами отрезков
+    const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+    ForEachChunk(count, chunk_count, [first, &comp](size_t, size_t begin, size_t end) {
+        std::sort(first + begin, first + end, comp);
+    });
+
+    for (size_t width = chunk_size; width < count; width *= 2) {
+        const size_t merge_count = (count + 2 * width - 1) / (2 * width);
+        For(merge_count, merge_count, [first, &comp, width, count](size_t idx) {
+            const size_t begin = idx * 2 * width;
+            const size_t middle = std::min(begin + width, count);
+            const size_t end = std::min(begin + 2 * width, count);
+            if (middle < end) {
+                std::inplace_merge(first + begin, first + middle, first + end, comp);
+            }
+        });
+    }
+}
+
+} // namespace parallel
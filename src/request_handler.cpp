@@ -1,8 +1,13 @@
 #include "request_handler.h"
 
 #include <algorithm>
+#include <chrono>
+
+#include "compression.h"
+#include "instrumentation.h"
 
 using namespace std;
+using namespace std::chrono_literals;
 using namespace geo;
 using namespace domain;
 using namespace domain::dto;
@@ -10,31 +15,56 @@ using namespace domain::dto;
 using BusesTable = TransportCatalogue::BusesTable;
 
 
-optional<BusStat> RequestHandler::GetBusStat(const string& bus_name) const {
+optional<BusStat> RequestHandler::GetBusStat(string_view bus_name) const {
     return db_.GetBusInfo(bus_name);
 }
 
-optional<BusesTable> RequestHandler::GetStopStat(const string& stop_name) const {
+optional<BusesTable> RequestHandler::GetStopStat(string_view stop_name) const {
     return db_.GetStopStat(stop_name);
 }
 
-void RequestHandler::AddBus(string_view name, const vector<string_view>& route, bool is_roundtrip) {
-    db_.AddBus(name, route, is_roundtrip);
+optional<BusSegmentStat> RequestHandler::GetBusSegment(string_view bus_name, string_view from, string_view to) const {
+    return db_.GetBusSegment(bus_name, from, to);
+}
+
+void RequestHandler::AddStops(const vector<StopDescription>& stops) {
+    ResetRouter();
+    db_.AddStops(stops);
+}
+
+void RequestHandler::SetRoadDistances(const vector<RoadDistanceDescription>& distances) {
+    ResetRouter();
+    db_.SetRoadDistances(distances);
+}
+
+void RequestHandler::AddBuses(const vector<BusDescription>& buses) {
+    ResetRouter();
+    db_.AddBuses(buses);
 }
 
-void RequestHandler::AddStop(string_view name, Coordinates coord) {
-    db_.AddStop(name, coord);
+uint64_t RequestHandler::GetCatalogueVersion() const noexcept {
+    return db_.GetVersion();
 }
 
-void RequestHandler::SetRoadDistance(string_view from, string_view to, int distance) {
-    db_.SetRoadDistance(from, to, distance);
+RequestHandler::MemoryUsage RequestHandler::GetMemoryUsage() const {
+    MemoryUsage usage;
+    db_.AddMemoryUsage(usage.report);
+
+    lock_guard lock(router_mutex_);
+    // Законченное фоновое построение не забирается: его ошибку получит первый запрос маршрута
+    const bool build_finished = router_build_.valid() && router_build_.wait_for(0s) == future_status::ready;
+    usage.router_building = router_build_.valid() && !build_finished;
+    if ((router_ready_.load(memory_order_relaxed) || build_finished) && router_.has_value()) {
+        router_->AddMemoryUsage(usage.report);
+    }
+    return usage;
 }
 
 void RequestHandler::SetRenderSettings(RenderSettings&& settings) {
     renderer_.SetRenderSettings(move(settings));
 }
 
-string RequestHandler::RenderMap() const {
+vector<const Stop*> RequestHandler::GetMapStops() const {
     const auto& all_stops = db_.GetAllStops();
     vector<const Stop*> valid_stops;
     valid_stops.reserve(all_stops.size());
@@ -46,6 +76,11 @@ string RequestHandler::RenderMap() const {
         }
     }
 
+    sort(valid_stops.begin(), valid_stops.end(), [](const auto lhs, const auto rhs) { return lhs->name < rhs->name; });
+    return valid_stops;
+}
+
+vector<const Bus*> RequestHandler::GetMapBuses() const {
     auto& all_buses = db_.GetAllBuses();
     vector<const Bus*> valid_buses;
     valid_buses.reserve(all_buses.size());
@@ -57,20 +92,162 @@ string RequestHandler::RenderMap() const {
     }
 
     auto comparator = [](const auto lhs, const auto rhs) -> bool {return lhs->name < rhs->name;};
-    sort(valid_stops.begin(), valid_stops.end(), comparator);
     sort(valid_buses.begin(), valid_buses.end(), comparator);
+    return valid_buses;
+}
+
+string RequestHandler::RenderMap() const {
+    return renderer_.RenderMap(GetMapBuses(), GetMapStops());
+}
+
+string RequestHandler::RenderCompressedMap() const {
+    string result;
+    compression::DeflateBuffer buffer(result);
+    ostream out(&buffer);
+    renderer_.RenderMap(GetMapBuses(), GetMapStops(), out);
+    buffer.Finish();
+    return result;
+}
+
+void RequestHandler::SetRoutingSettings(RoutingSettings settings) {
+    ResetRouter();
+    routing_settings_ = settings;
+    // Ответы, построенные с прежними настройками, больше не верны
+    route_cache_.Clear();
+}
+
+void RequestHandler::SetRouteCacheCapacity(size_t capacity) {
+    route_cache_.Reset(capacity);
+}
+
+RouteCache::Stats RequestHandler::GetRouteCacheStats() const noexcept {
+    return route_cache_.GetStats();
+}
+
+void RequestHandler::StartRouterInitialization() {
+    if (!routing_settings_.has_value()) {
+        throw logic_error("Routing settings are not set. Call SetRoutingSettings() first.");
+    }
+
+    lock_guard lock(router_mutex_);
+    if (router_ready_.load(memory_order_relaxed) || router_build_.valid()) {
+        return;
+    }
+    // Фоновый поток только читает каталог, как и обработчики остальных запросов, поэтому они идут параллельно
+    router_build_ = async(launch::async, [this, settings = *routing_settings_] {
+        TC_SCOPED_TIMER("base_requests.router_initialization");
+        router_.emplace(db_, settings);
+    });
+}
+
+void RequestHandler::WaitForRouter() const {
+    lock_guard lock(router_mutex_);
+    if (router_build_.valid()) {
+        router_build_.get();
+        router_ready_.store(true, memory_order_release);
+    }
+}
+
+const TransportRouter& RequestHandler::GetRouter() const {
+    if (!router_ready_.load(memory_order_acquire)) {
+        lock_guard lock(router_mutex_);
+        if (router_build_.valid()) {
+            router_build_.get();
+        } else if (!router_ready_.load(memory_order_relaxed)) {
+            if (!routing_settings_.has_value()) {
+                throw logic_error("Routing settings are not set. Call SetRoutingSettings() first.");
+            }
+            TC_SCOPED_TIMER("base_requests.router_initialization");
+            router_.emplace(db_, *routing_settings_);
+        }
+        router_ready_.store(true, memory_order_release);
+    }
+    return *router_;
+}
+
+void RequestHandler::ResetRouter() {
+    lock_guard lock(router_mutex_);
+    if (router_build_.valid()) {
+        // Ошибка построения не важна, роутер все равно выбрасывается
+        router_build_.wait();
+        router_build_ = {};
+    }
+    router_.reset();
+    router_ready_.store(false, memory_order_relaxed);
+}
+
+optional<RouteResponse> RequestHandler::BuildRoute(string_view from, string_view to, optional<double> departure_time) const {
+    // Ответ зависит от времени отправления, а кэш хранит только ответы без него
+    if (departure_time.has_value()) {
+        return GetRouter().GetRouteAt(from, to, *departure_time);
+    }
+
+    const uint64_t version = db_.GetVersion();
+    if (auto cached = route_cache_.Find(from, to, version)) {
+        return move(*cached);
+    }
+    auto route = GetRouter().GetRoute(from, to);
+    route_cache_.Insert(from, to, version, route);
+    return route;
+}
+
+optional<vector<optional<RouteResponse>>> RequestHandler::BuildRoutesFrom(string_view from,
+                                                                         const vector<string_view>& targets) const {
+    const uint64_t version = db_.GetVersion();
+    vector<optional<RouteResponse>> result(targets.size());
+    vector<string_view> missed_targets;
+    vector<size_t> missed_indices;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (auto cached = route_cache_.Find(from, targets[i], version)) {
+            result[i] = move(*cached);
+        } else {
+            missed_targets.push_back(targets[i]);
+            missed_indices.push_back(i);
+        }
+    }
+    if (missed_targets.empty()) {
+        return result;
+    }
+
+    auto routes = GetRouter().GetRoutesFrom(from, missed_targets);
+    if (!routes.has_value()) {
+        return nullopt;
+    }
+    for (size_t i = 0; i < missed_targets.size(); ++i) {
+        route_cache_.Insert(from, missed_targets[i], version, (*routes)[i]);
+        result[missed_indices[i]] = move((*routes)[i]);
+    }
+    return result;
+}
 
-    return renderer_.RenderMap(valid_buses, valid_stops);
+optional<vector<RouteResponse>> RequestHandler::BuildAlternativeRoutes(string_view from, string_view to,
+                                                                      size_t count) const {
+    return GetRouter().GetAlternativeRoutes(from, to, count);
 }
 
-void RequestHandler::RouterInitialization(RoutingSettings settings) {
-    router_.emplace(db_, settings);
+optional<vector<ParetoRoute>> RequestHandler::BuildParetoRoutes(string_view from, string_view to) const {
+    return GetRouter().GetParetoRoutes(from, to);
 }
 
-optional<RouteResponse> RequestHandler::BuildRoute(string_view from, string_view to) const {
-    if (!router_.has_value()) {
-        throw logic_error("Transport router is not initialized. Call RouterInitialization() first.");
+optional<vector<vector<optional<TransportRouter::Time>>>> RequestHandler::BuildTravelTimes(
+        const vector<string_view>& sources, const vector<string_view>& targets) const {
+    return GetRouter().GetTravelTimes(sources, targets);
+}
+
+optional<IsochroneResponse> RequestHandler::BuildIsochrone(string_view from, double max_time, bool render_map) const {
+    auto stops = GetRouter().GetReachableStops(from, max_time);
+    if (!stops.has_value()) {
+        return nullopt;
     }
 
-    return router_->GetRoute(from, to);
+    IsochroneResponse response{move(*stops), nullopt};
+    if (render_map) {
+        vector<const Stop*> reached;
+        reached.reserve(response.stops.size());
+        for (const auto& item : response.stops) {
+            reached.push_back(item.stop);
+        }
+        response.map = renderer_.RenderIsochrone(GetMapStops(), reached);
+    }
+    return response;
 }
\ No newline at end of file
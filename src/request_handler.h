@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <optional>
 #include <vector>
 #include <string>
@@ -7,6 +10,8 @@
 #include "domain.h"
 #include "geo.h"
 #include "map_renderer.h"
+#include "memory_usage.h"
+#include "route_cache.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 
@@ -20,19 +25,52 @@ public:
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
-    std::optional<BusStat> GetBusStat(const std::string& bus_name) const;
-    std::optional<BusesTable> GetStopStat(const std::string& stop_name) const;
-    void AddBus(std::string_view name, const std::vector<std::string_view>& route, bool is_roundtrip);
-    void AddStop(std::string_view name, geo::Coordinates coord);
-    void SetRoadDistance(std::string_view from, std::string_view to, int distance);
+    std::optional<BusStat> GetBusStat(std::string_view bus_name) const;
+    std::optional<BusesTable> GetStopStat(std::string_view stop_name) const;
+    std::optional<domain::BusSegmentStat> GetBusSegment(std::string_view bus_name, std::string_view from,
+                                                        std::string_view to) const;
+    void AddStops(const std::vector<domain::dto::StopDescription>& stops);
+    void SetRoadDistances(const std::vector<domain::dto::RoadDistanceDescription>& distances);
+    void AddBuses(const std::vector<domain::dto::BusDescription>& buses);
+    uint64_t GetCatalogueVersion() const noexcept;
+    struct MemoryUsage {
+        memory::Report report;
+        bool router_building = false;   // Роутер еще строится в фоне, и в отчете только каталог
+    };
+    // Память каталога и готового роутера. Фоновое построение роутера не ожидается
+    MemoryUsage GetMemoryUsage() const;
 
     // Запросы на рендер карты
     void SetRenderSettings(domain::dto::RenderSettings&& settings);
     std::string RenderMap() const;
+    // Карта, сжатая DEFLATE. svg выводится прямо в кодировщик и целиком в памяти не собирается
+    std::string RenderCompressedMap() const;
 
-    // Запросы на поиск маршрута
-    void RouterInitialization(domain::dto::RoutingSettings settings);
-    std::optional<domain::dto::RouteResponse> BuildRoute(std::string_view from, std::string_view to) const;
+    // Запросы на поиск маршрута. Роутер строится при первом таком запросе или заранее в фоновом потоке
+    void SetRoutingSettings(domain::dto::RoutingSettings settings);
+    // Запускает построение роутера в фоновом потоке. Запросы к каталогу и карте обслуживаются сразу,
+    // запросы маршрутов ждут окончания построения
+    void StartRouterInitialization();
+    // Дожидается окончания построения, запущенного StartRouterInitialization. Ошибка построения пробрасывается отсюда
+    void WaitForRouter() const;
+    // Очищает кэш ответов Route и задает его емкость, 0 отключает кэш
+    void SetRouteCacheCapacity(size_t capacity);
+    // Счетчики попаданий и промахов кэша ответов Route
+    RouteCache::Stats GetRouteCacheStats() const noexcept;
+    // С `departure_time` (минуты от начала суток) маршрут ищется по расписаниям автобусов, иначе ответ берется из кэша
+    std::optional<domain::dto::RouteResponse> BuildRoute(std::string_view from, std::string_view to,
+                                                         std::optional<double> departure_time = std::nullopt) const;
+    // Маршруты из одной остановки во все `targets` одним поиском. Ищутся только цели, которых нет в кэше
+    std::optional<std::vector<std::optional<domain::dto::RouteResponse>>> BuildRoutesFrom(
+            std::string_view from, const std::vector<std::string_view>& targets) const;
+    std::optional<std::vector<domain::dto::RouteResponse>> BuildAlternativeRoutes(std::string_view from, std::string_view to,
+                                                                                   size_t count) const;
+    std::optional<std::vector<domain::dto::ParetoRoute>> BuildParetoRoutes(std::string_view from, std::string_view to) const;
+    std::optional<std::vector<std::vector<std::optional<TransportRouter::Time>>>> BuildTravelTimes(
+            const std::vector<std::string_view>& sources, const std::vector<std::string_view>& targets) const;
+    // Остановки, достижимые из `from` за `max_time` минут. При `render_map` в ответ добавляется svg-слой для карты
+    std::optional<domain::dto::IsochroneResponse> BuildIsochrone(std::string_view from, double max_time,
+                                                                 bool render_map) const;
 
 private:
     /**
@@ -41,5 +79,25 @@ private:
 
     TransportCatalogue db_;
     renderer::MapRenderer renderer_;
-    std::optional<TransportRouter> router_; // Инициализируется при первом запросе на поиск маршрута
+    std::optional<domain::dto::RoutingSettings> routing_settings_;
+    /**
+     * Роутер инициализируется при первом запросе на поиск маршрута или в фоновом потоке router_build_.
+     * Порядок полей важен: деструктор router_build_ дожидается фонового построения, пока router_ еще жив.
+     * Состояние меняется под router_mutex_, готовый роутер читается без блокировки после проверки router_ready_
+     */
+    mutable std::mutex router_mutex_;
+    mutable std::optional<TransportRouter> router_;
+    mutable std::future<void> router_build_;
+    mutable std::atomic<bool> router_ready_ = false;
+    // Ответы на Route без времени отправления. Общий для всех протоколов, сбрасывается вместе с настройками роутера
+    mutable RouteCache route_cache_;
+
+    // Остановки, через которые проходит хотя бы один автобус, по возрастанию названия - именно они есть на карте
+    std::vector<const domain::Stop*> GetMapStops() const;
+    // Автобусы с непустым маршрутом по возрастанию названия
+    std::vector<const domain::Bus*> GetMapBuses() const;
+    // Роутер, построенный заранее или прямо сейчас. Без SetRoutingSettings - std::logic_error
+    const TransportRouter& GetRouter() const;
+    // Дожидается фонового построения и сбрасывает роутер - каталог или настройки вот-вот изменятся
+    void ResetRouter();
 };
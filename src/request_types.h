@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include "domain.h"
+
+namespace requests {
+
+// Типы запросов из "base_requests"
+enum class BaseRequestType : uint8_t {
+    kStop,
+    kBus,
+    kCount // Не тип запроса, а количество типов. Должен быть последним
+};
+
+// Типы запросов из "stat_requests". Значения используются как индексы в таблице обработчиков JsonReader
+enum class StatRequestType : uint8_t {
+    kStop,
+    kBus,
+    kMap,
+    kRoute,
+    kMatrix,
+    kIsochrone,
+    kBusSegment,
+    kAlternatives,
+    kParetoRoute,
+    kMemory,
+    kCount // Не тип запроса, а количество типов. Должен быть последним
+};
+
+// Запросы, для ответа на которые нужен роутер
+constexpr bool UsesRouter(StatRequestType type) noexcept {
+    switch (type) {
+        case StatRequestType::kRoute:
+        case StatRequestType::kMatrix:
+        case StatRequestType::kIsochrone:
+        case StatRequestType::kAlternatives:
+        case StatRequestType::kParetoRoute:
+            return true;
+        case StatRequestType::kStop:
+        case StatRequestType::kBus:
+        case StatRequestType::kMap:
+        case StatRequestType::kBusSegment:
+        case StatRequestType::kMemory:
+        case StatRequestType::kCount:
+            return false;
+    }
+    return false;
+}
+
+template <typename Type>
+struct TypeTag {
+    std::string_view name;
+    Type type;
+};
+
+namespace detail {
+
+// FNV-1a с подмешиванием соли, чтобы при коллизии можно было подобрать другую хэш-функцию
+constexpr uint64_t HashTag(std::string_view tag, uint64_t seed) noexcept {
+    uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+    for (char c : tag) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace detail
+
+/**
+ * Реестр типов запросов, построенный на этапе компиляции.
+ * Соль хэш-функции подбирается в конструкторе так, чтобы все теги попали в разные ячейки (совершенный хэш),
+ * поэтому поиск типа - это один хэш и одно сравнение строк независимо от количества зарегистрированных типов.
+ * Если соль подобрать не удалось, компиляция завершится ошибкой
+ */
+template <typename Type, size_t N>
+class TypeRegistry {
+public:
+    consteval explicit TypeRegistry(const std::array<TypeTag<Type>, N>& tags) {
+        for (uint64_t seed = 0; seed < kMaxSeed; ++seed) {
+            if (TryFill(tags, seed)) {
+                seed_ = seed;
+                return;
+            }
+        }
+        throw std::logic_error("Unable to build perfect hash for request types");
+    }
+
+    /**
+     * Возвращает `nullopt`, если тип с таким названием не зарегистрирован
+     */
+    constexpr std::optional<Type> Find(std::string_view name) const noexcept {
+        const Slot& slot = slots_[SlotIndex(name, seed_)];
+        if (!slot.used || slot.name != name) {
+            return std::nullopt;
+        }
+        return slot.type;
+    }
+
+    static constexpr size_t Size() noexcept {
+        return N;
+    }
+
+private:
+    struct Slot {
+        std::string_view name;
+        Type type{};
+        bool used = false;
+    };
+
+    // Таблица в 2 раза больше количества тегов, чтобы совершенный хэш находился за несколько попыток
+    static constexpr size_t kTableSize = std::bit_ceil(N * 2);
+    static constexpr uint64_t kMaxSeed = 1 << 16;
+
+    std::array<Slot, kTableSize> slots_{};
+    uint64_t seed_ = 0;
+
+    static constexpr size_t SlotIndex(std::string_view name, uint64_t seed) noexcept {
+        // Младшие биты FNV слабо перемешаны, поэтому индекс берется из старших
+        return (detail::HashTag(name, seed) >> 32) & (kTableSize - 1);
+    }
+
+    constexpr bool TryFill(const std::array<TypeTag<Type>, N>& tags, uint64_t seed) {
+        slots_ = {};
+        for (const auto& tag : tags) {
+            Slot& slot = slots_[SlotIndex(tag.name, seed)];
+            if (slot.used) {
+                return false;
+            }
+            slot = {tag.name, tag.type, true};
+        }
+        return true;
+    }
+};
+
+inline constexpr TypeRegistry kBaseRequestTypes{std::array{
+    TypeTag<BaseRequestType>{"Stop", BaseRequestType::kStop},
+    TypeTag<BaseRequestType>{"Bus", BaseRequestType::kBus},
+}};
+
+inline constexpr TypeRegistry kStatRequestTypes{std::array{
+    TypeTag<StatRequestType>{"Stop", StatRequestType::kStop},
+    TypeTag<StatRequestType>{"Bus", StatRequestType::kBus},
+    TypeTag<StatRequestType>{"Map", StatRequestType::kMap},
+    TypeTag<StatRequestType>{"Route", StatRequestType::kRoute},
+    TypeTag<StatRequestType>{"Matrix", StatRequestType::kMatrix},
+    TypeTag<StatRequestType>{"Isochrone", StatRequestType::kIsochrone},
+    TypeTag<StatRequestType>{"BusSegment", StatRequestType::kBusSegment},
+    TypeTag<StatRequestType>{"Alternatives", StatRequestType::kAlternatives},
+    TypeTag<StatRequestType>{"ParetoRoute", StatRequestType::kParetoRoute},
+    TypeTag<StatRequestType>{"Memory", StatRequestType::kMemory},
+}};
+
+// Значения ключа "strategy" в "routing_settings"
+inline constexpr TypeRegistry kRoutingStrategies{std::array{
+    TypeTag<domain::dto::RoutingStrategy>{"all_pairs", domain::dto::RoutingStrategy::kAllPairs},
+    TypeTag<domain::dto::RoutingStrategy>{"contraction_hierarchy", domain::dto::RoutingStrategy::kContractionHierarchy},
+    TypeTag<domain::dto::RoutingStrategy>{"dijkstra", domain::dto::RoutingStrategy::kDijkstra},
+    TypeTag<domain::dto::RoutingStrategy>{"bidirectional_dijkstra", domain::dto::RoutingStrategy::kBidirectionalDijkstra},
+    TypeTag<domain::dto::RoutingStrategy>{"a_star", domain::dto::RoutingStrategy::kAStar},
+}};
+
+// Каждый тип запроса должен быть зарегистрирован, иначе его невозможно будет получить из json
+static_assert(kBaseRequestTypes.Size() == static_cast<size_t>(BaseRequestType::kCount));
+static_assert(kStatRequestTypes.Size() == static_cast<size_t>(StatRequestType::kCount));
+
+static_assert(kStatRequestTypes.Find("Route") == StatRequestType::kRoute);
+static_assert(!kStatRequestTypes.Find("Unknown").has_value());
+static_assert(kRoutingStrategies.Find("contraction_hierarchy") == domain::dto::RoutingStrategy::kContractionHierarchy);
+
+} // namespace requests
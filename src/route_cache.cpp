@@ -0,0 +1,80 @@
+#include "route_cache.h"
+
+#include "instrumentation.h"
+
+using namespace std;
+
+RouteCache::RouteCache(size_t capacity) {
+    Reset(capacity);
+}
+
+void RouteCache::Reset(size_t capacity) {
+    // Емкость делится между шардами с округлением вверх, чтобы при небольшой емкости кэш не отключился
+    const size_t shard_capacity = (capacity + kShardCount - 1) / kShardCount;
+    for (Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        shard.capacity = shard_capacity;
+        shard.index.clear();
+        shard.entries.clear();
+    }
+}
+
+void RouteCache::Clear() {
+    for (Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+    }
+}
+
+optional<RouteCache::Route> RouteCache::Find(string_view from, string_view to, uint64_t version) {
+    const KeyView key{from, to, version};
+    Shard& shard = GetShard(key);
+
+    lock_guard guard(shard.mutex);
+    if (shard.capacity == 0) {
+        return nullopt;
+    }
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, memory_order_relaxed);
+        TC_COUNTER_ADD("route_cache.misses", 1);
+        return nullopt;
+    }
+
+    hits_.fetch_add(1, memory_order_relaxed);
+    TC_COUNTER_ADD("route_cache.hits", 1);
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->route;
+}
+
+void RouteCache::Insert(string_view from, string_view to, uint64_t version, const Route& route) {
+    const KeyView key{from, to, version};
+    Shard& shard = GetShard(key);
+
+    lock_guard guard(shard.mutex);
+    if (shard.capacity == 0 || shard.index.count(key)) {
+        return;
+    }
+
+    if (shard.entries.size() == shard.capacity) {
+        const Entry& oldest = shard.entries.back();
+        shard.index.erase(KeyView{oldest.from, oldest.to, oldest.version});
+        shard.entries.pop_back();
+    }
+
+    Entry& entry = shard.entries.emplace_front(Entry{string(from), string(to), version, route});
+    shard.index.emplace(KeyView{entry.from, entry.to, entry.version}, shard.entries.begin());
+}
+
+RouteCache::Stats RouteCache::GetStats() const noexcept {
+    return {
+        .hits = hits_.load(memory_order_relaxed),
+        .misses = misses_.load(memory_order_relaxed)
+    };
+}
+
+RouteCache::Shard& RouteCache::GetShard(const KeyView& key) {
+    return shards_[KeyHasher{}(key) % kShardCount];
+}
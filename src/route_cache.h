@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "domain.h"
+
+/**
+ * Ограниченный потокобезопасный LRU-кэш ответов на запросы Route.
+ * Ключ - (from, to, версия каталога), значение - найденный маршрут или nullopt, если его нет. Значение не зависит
+ * от протокола, поэтому кэш общий для json и двоичного протокола.
+ * Кэш разбит на шарды со своими мьютексами, поэтому запросы к разным парам остановок почти не ждут друг друга,
+ * а вытеснение работает внутри шарда
+ */
+class RouteCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // Маршрут или nullopt, если остановка не найдена или маршрута нет
+    using Route = std::optional<domain::dto::RouteResponse>;
+
+    static constexpr size_t kDefaultCapacity = 1 << 12;
+
+    explicit RouteCache(size_t capacity = kDefaultCapacity);
+
+    // Очищает кэш и задает новую емкость. Емкость 0 отключает кэш
+    void Reset(size_t capacity);
+    void Clear();
+
+    // Внешний optional пуст, если ответа нет в кэше
+    std::optional<Route> Find(std::string_view from, std::string_view to, uint64_t version);
+    void Insert(std::string_view from, std::string_view to, uint64_t version, const Route& route);
+
+    Stats GetStats() const noexcept;
+
+private:
+    static constexpr size_t kShardCount = 16;
+
+    struct Entry {
+        std::string from;
+        std::string to;
+        uint64_t version;
+        Route route;
+    };
+
+    // Ключ индекса ссылается на строки записи в списке. Узлы списка не перемещаются, поэтому ссылки остаются валидными
+    struct KeyView {
+        std::string_view from;
+        std::string_view to;
+        uint64_t version;
+
+        bool operator==(const KeyView& other) const = default;
+    };
+
+    struct KeyHasher {
+        size_t operator()(const KeyView& key) const noexcept {
+            return sv_hasher_(key.from) + 17 * sv_hasher_(key.to) + 31 * static_cast<size_t>(key.version);
+        }
+
+    private:
+        static constexpr std::hash<std::string_view> sv_hasher_{};
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        size_t capacity = 0;
+        std::list<Entry> entries;   // В начале - последние использованные записи
+        std::unordered_map<KeyView, std::list<Entry>::iterator, KeyHasher> index;
+    };
+
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+
+    Shard& GetShard(const KeyView& key);
+};
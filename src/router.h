@@ -1,45 +1,107 @@
 #pragma once
 
 #include "graph.h"
+#include "memory_usage.h"
+#include "parallel.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <optional>
+#include <queue>
 #include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
+// Алгоритм, которым Router отвечает на запросы
+enum class RouterStrategy {
+    kAllPairs,                  // Флойд-Уоршелл: O(V^3) на построение, O(V^2) памяти, запрос - восстановление пути из таблицы
+    kDijkstra,                  // Поиск Дейкстры от начала пути до извлечения конечной вершины
+    kBidirectionalDijkstra,     // Встречный поиск Дейкстры от начала и от конца пути
+    kAStar,                     // Поиск Дейкстры, направленный к цели нижней оценкой оставшегося пути
+};
+
 template <typename Weight>
 class  Router {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    explicit Router(const Graph& graph);
+    /**
+     * Нижняя оценка веса пути из первой вершины во вторую для A*. Оценка должна быть согласованной:
+     * potential(u, to) <= weight(u -> v) + potential(v, to) для каждого ребра u -> v
+     */
+    using Potential = std::function<Weight(VertexId, VertexId)>;
+
+    explicit Router(const Graph& graph, RouterStrategy strategy = RouterStrategy::kAllPairs, Potential potential = {});
 
     struct RouteInfo {
         Weight weight;
         std::vector<EdgeId> edges;
     };
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Если передан `stats`, в него добавляется количество просмотренных поиском вершин
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+    // Решает, подходит ли путь в качестве альтернативы. Путь, для которого вернулось true, считается принятым
+    using RouteFilter = std::function<bool(const RouteInfo&)>;
+
+    /**
+     * Альтернативные пути методом промежуточной вершины. Прямой поиск из `from` и обратный поиск в `to` строят деревья
+     * кратчайших путей с весом не больше `max_stretch` весов кратчайшего пути, и для каждой вершины v, достигнутой
+     * обоими поисками, путь from -> v -> to собирается из этих деревьев без новых поисков (для kAllPairs - из таблицы).
+     * Кандидаты перебираются по возрастанию веса, поэтому первый - кратчайший путь. Пути с циклом и пути через вершины
+     * уже принятых путей пропускаются. Возвращается не больше `max_count` путей, принятых `accept`
+     */
+    std::vector<RouteInfo> BuildAlternativeRoutes(VertexId from, VertexId to, size_t max_count, double max_stretch,
+                                                  const RouteFilter& accept, SearchStats* stats = nullptr) const;
+
+    /**
+     * Веса кратчайших путей из каждого источника в каждую цель без восстановления путей.
+     * Для kAllPairs веса берутся из таблицы, для остальных стратегий из каждого источника выполняется
+     * один поиск Дейкстры до всех целей. Источники обрабатываются параллельно
+     */
+    std::vector<std::vector<std::optional<Weight>>> BuildWeightMatrix(const std::vector<VertexId>& sources,
+                                                                      const std::vector<VertexId>& targets) const;
+
+    /**
+     * Кратчайшие пути из `from` в каждую цель `targets` (nullopt - пути нет). Для kAllPairs пути восстанавливаются
+     * из таблицы, для остальных стратегий выполняется один поиск Дейкстры, который останавливается, когда извлечены
+     * все цели, и пути восстанавливаются по его дереву. Для kDijkstra пути совпадают с BuildRoute
+     */
+    std::vector<std::optional<RouteInfo>> BuildRoutesFrom(VertexId from, const std::vector<VertexId>& targets,
+                                                          SearchStats* stats = nullptr) const;
+
+    /**
+     * Вершины, достижимые из `from` с весом пути не больше `max_weight`, в порядке возрастания веса.
+     * Поиск Дейкстры останавливается на границе бюджета, поэтому время зависит только от размера достигнутой области.
+     * Работает для любой стратегии: таблица kAllPairs не используется
+     */
+    std::vector<std::pair<VertexId, Weight>> FindReachableVertices(VertexId from, Weight max_weight,
+                                                                   SearchStats* stats = nullptr) const;
+
+    // Добавляет в `report` память таблицы kAllPairs и входящих ребер. Рабочие массивы поиска принадлежат потокам
+    // и не учитываются
+    void AddMemoryUsage(const std::string& prefix, memory::Report& report) const;
 
 private:
     struct RouteInternalData {
         Weight weight;
-        std::optional<EdgeId> prev_edge;
+        EdgeId prev_edge;       // kNoEdge для пути из вершины в саму себя. Без optional запись таблицы на 8 байт меньше
     };
     using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
 
     void InitializeRoutesInternalData(const Graph& graph) {
         const size_t vertex_count = graph.GetVertexCount();
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, kNoEdge};
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
@@ -59,7 +121,7 @@ private:
         const Weight candidate_weight = route_from.weight + route_to.weight;
         if (!route_relaxing || candidate_weight < route_relaxing->weight) {
             route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+                              route_to.prev_edge != kNoEdge ? route_to.prev_edge : route_from.prev_edge};
         }
     }
 
@@ -76,42 +138,699 @@ private:
     }
 
     static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId kNoEdge = std::numeric_limits<EdgeId>::max();
+
+    // Состояние поиска одного направления. Массивы переиспользуются между запросами потока,
+    // метка версии заменяет их очистку, поэтому запрос не тратит O(V) на инициализацию
+    struct SearchSide {
+        std::vector<Weight> distance;
+        std::vector<EdgeId> parent_edge;
+        std::vector<uint32_t> version;
+
+        bool IsReached(VertexId vertex, uint32_t current) const {
+            return version[vertex] == current;
+        }
+    };
+    struct SearchWorkspace {
+        SearchSide sides[2];
+        uint32_t current_version = 0;
+    };
+
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    RouterStrategy strategy_;
+    Potential potential_;
+    RoutesInternalData routes_internal_data_;   // Только для kAllPairs
+    // Входящие ребра в формате CSR для обратного поиска: ребра в вершину v - incoming_edges_[offsets[v]..offsets[v + 1]).
+    // Строятся для всех стратегий, кроме kAllPairs: кроме встречного поиска они нужны для альтернативных путей
+    std::vector<size_t> incoming_offsets_;
+    std::vector<EdgeId> incoming_edges_;
+
+    void InitializeIncomingEdges();
+    std::optional<RouteInfo> BuildAllPairsRoute(VertexId from, VertexId to) const;
+    std::optional<RouteInfo> BuildBidirectionalRoute(VertexId from, VertexId to, SearchStats* stats) const;
+    std::optional<RouteInfo> BuildAStarRoute(VertexId from, VertexId to, SearchStats* stats) const;
+    std::vector<std::optional<Weight>> BuildWeightsFrom(VertexId from, const std::vector<VertexId>& targets) const;
+    // Поиск Дейкстры из `from`, который останавливается, когда извлечены все `targets`. Расстояния остаются
+    // в workspace.sides[0], а при `track_parents` там же и ребра дерева путей. Возвращает количество извлеченных вершин
+    size_t SettleTargetsFrom(SearchWorkspace& workspace, VertexId from, const std::vector<VertexId>& targets,
+                             bool track_parents) const;
+    SearchWorkspace& GetWorkspace() const;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, RouterStrategy strategy, Potential potential)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , strategy_(strategy)
+    , potential_(std::move(potential))
 {
-    InitializeRoutesInternalData(graph);
+    switch (strategy_) {
+        case RouterStrategy::kAllPairs: {
+            const size_t vertex_count = graph.GetVertexCount();
+            routes_internal_data_.assign(vertex_count, std::vector<std::optional<RouteInternalData>>(vertex_count));
+            InitializeRoutesInternalData(graph);
+            for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
+                RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+            }
+            break;
+        }
+        case RouterStrategy::kBidirectionalDijkstra:
+            break;
+        case RouterStrategy::kDijkstra:
+        case RouterStrategy::kAStar:
+            // С нулевой оценкой A* совпадает с обычным поиском Дейкстры
+            if (strategy_ == RouterStrategy::kDijkstra || !potential_) {
+                potential_ = [](VertexId, VertexId) { return ZERO_WEIGHT; };
+            }
+            break;
+    }
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    if (strategy_ != RouterStrategy::kAllPairs) {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+        InitializeIncomingEdges();
+    }
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to,
+                                                                             SearchStats* stats) const {
+    switch (strategy_) {
+        case RouterStrategy::kBidirectionalDijkstra:
+            return BuildBidirectionalRoute(from, to, stats);
+        case RouterStrategy::kDijkstra:
+        case RouterStrategy::kAStar:
+            return BuildAStarRoute(from, to, stats);
+        case RouterStrategy::kAllPairs:
+            break;
     }
+    return BuildAllPairsRoute(from, to);
 }
 
 template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-                                                                             VertexId to) const {
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildAllPairsRoute(VertexId from,
+                                                                                     VertexId to) const {
     const auto& route_internal_data = routes_internal_data_.at(from).at(to);
     if (!route_internal_data) {
         return std::nullopt;
     }
     const Weight weight = route_internal_data->weight;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (EdgeId edge_id = route_internal_data->prev_edge;
+         edge_id != kNoEdge;
+         edge_id = routes_internal_data_[from][graph_.GetEdge(edge_id).from]->prev_edge)
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
 
     return RouteInfo{weight, std::move(edges)};
 }
 
+template <typename Weight>
+std::vector<typename Router<Weight>::RouteInfo> Router<Weight>::BuildAlternativeRoutes(
+        VertexId from, VertexId to, size_t max_count, double max_stretch, const RouteFilter& accept,
+        SearchStats* stats) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    // Кандидаты - пары (вес пути через вершину, вершина)
+    std::vector<std::pair<Weight, VertexId>> candidates;
+    std::vector<EdgeId> edges;
+    // Записывает в `edges` ребра пути from -> via -> to
+    std::function<void(VertexId)> collect_edges;
+
+    if (strategy_ == RouterStrategy::kAllPairs) {
+        const auto& shortest = routes_internal_data_[from][to];
+        if (!shortest) {
+            return {};
+        }
+        const Weight limit = shortest->weight * max_stretch;
+        for (VertexId via = 0; via < vertex_count; ++via) {
+            const auto& head = routes_internal_data_[from][via];
+            const auto& tail = routes_internal_data_[via][to];
+            if (head && tail && !(limit < head->weight + tail->weight)) {
+                candidates.emplace_back(head->weight + tail->weight, via);
+            }
+        }
+        collect_edges = [this, from, to, &edges](VertexId via) {
+            edges = BuildAllPairsRoute(from, via)->edges;
+            const auto tail = BuildAllPairsRoute(via, to)->edges;
+            edges.insert(edges.end(), tail.begin(), tail.end());
+        };
+    } else {
+        SearchWorkspace& workspace = GetWorkspace();
+        const uint32_t current = workspace.current_version;
+
+        using QueueItem = std::pair<Weight, VertexId>;
+        auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.first < lhs.first; };
+        size_t settled = 0;
+        std::optional<Weight> limit;
+        std::vector<VertexId> forward_settled;
+
+        // Поиск одного направления до извлечения вершины тяжелее `limit`. Прямой поиск задает `limit`, когда извлекает `to`
+        auto search = [&](int dir) {
+            SearchSide& side = workspace.sides[dir];
+            const VertexId source = dir == 0 ? from : to;
+            std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)> queue(greater);
+            side.version[source] = current;
+            side.distance[source] = ZERO_WEIGHT;
+            side.parent_edge[source] = kNoEdge;
+            queue.push({ZERO_WEIGHT, source});
+
+            while (!queue.empty()) {
+                const auto [dist, vertex] = queue.top();
+                queue.pop();
+                if (side.distance[vertex] < dist) {
+                    continue;
+                }
+                if (limit && *limit < dist) {
+                    break;
+                }
+                ++settled;
+                if (dir == 0) {
+                    forward_settled.push_back(vertex);
+                    if (vertex == to) {
+                        limit = dist * max_stretch;
+                    }
+                }
+
+                auto relax = [&](EdgeId edge_id, VertexId next) {
+                    const Weight candidate = dist + graph_.GetEdge(edge_id).weight;
+                    if (side.IsReached(next, current) && !(candidate < side.distance[next])) {
+                        return;
+                    }
+                    side.version[next] = current;
+                    side.distance[next] = candidate;
+                    side.parent_edge[next] = edge_id;
+                    queue.push({candidate, next});
+                };
+                if (dir == 0) {
+                    for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                        relax(edge_id, graph_.GetEdge(edge_id).to);
+                    }
+                } else {
+                    for (size_t i = incoming_offsets_[vertex]; i < incoming_offsets_[vertex + 1]; ++i) {
+                        relax(incoming_edges_[i], graph_.GetEdge(incoming_edges_[i]).from);
+                    }
+                }
+            }
+        };
+
+        search(0);
+        if (!limit) {
+            if (stats) {
+                stats->settled_vertices += settled;
+            }
+            return {};
+        }
+        search(1);
+        if (stats) {
+            stats->settled_vertices += settled;
+        }
+
+        // Вершины с окончательным весом не тяжелее `limit` извлечены обоими поисками, а у остальных достигнутых обратным
+        // поиском вершин вес больше `limit`, поэтому сумма отсекает их без отдельных отметок
+        const SearchSide& forward = workspace.sides[0];
+        const SearchSide& backward = workspace.sides[1];
+        for (const VertexId via : forward_settled) {
+            if (backward.IsReached(via, current)
+                && !(*limit < forward.distance[via] + backward.distance[via])) {
+                candidates.emplace_back(forward.distance[via] + backward.distance[via], via);
+            }
+        }
+        collect_edges = [this, from, to, &edges, &forward, &backward](VertexId via) {
+            edges.clear();
+            for (VertexId vertex = via; vertex != from;) {
+                const EdgeId edge_id = forward.parent_edge[vertex];
+                edges.push_back(edge_id);
+                vertex = graph_.GetEdge(edge_id).from;
+            }
+            std::reverse(edges.begin(), edges.end());
+            for (VertexId vertex = via; vertex != to;) {
+                const EdgeId edge_id = backward.parent_edge[vertex];
+                edges.push_back(edge_id);
+                vertex = graph_.GetEdge(edge_id).to;
+            }
+        };
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<RouteInfo> result;
+    std::vector<VertexId> covered;      // Вершины принятых путей, их немного, поэтому достаточно линейного поиска
+    std::vector<VertexId> vertices;
+    for (const auto& [weight, via] : candidates) {
+        if (result.size() >= max_count) {
+            break;
+        }
+        if (std::find(covered.begin(), covered.end(), via) != covered.end()) {
+            continue;
+        }
+
+        collect_edges(via);
+        vertices.assign(1, from);
+        for (const EdgeId edge_id : edges) {
+            vertices.push_back(graph_.GetEdge(edge_id).to);
+        }
+        std::sort(vertices.begin(), vertices.end());
+        if (std::adjacent_find(vertices.begin(), vertices.end()) != vertices.end()) {
+            continue;
+        }
+
+        RouteInfo route{weight, edges};
+        if (!accept(route)) {
+            continue;
+        }
+        covered.insert(covered.end(), vertices.begin(), vertices.end());
+        result.push_back(std::move(route));
+    }
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::vector<std::optional<Weight>>> Router<Weight>::BuildWeightMatrix(
+        const std::vector<VertexId>& sources, const std::vector<VertexId>& targets) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    auto check_vertex = [vertex_count](VertexId vertex) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    };
+    std::for_each(sources.begin(), sources.end(), check_vertex);
+    std::for_each(targets.begin(), targets.end(), check_vertex);
+
+    std::vector<std::vector<std::optional<Weight>>> result(sources.size());
+    parallel::For(sources.size(), parallel::GetThreadCount(sources.size()), [&](size_t idx) {
+        if (strategy_ != RouterStrategy::kAllPairs) {
+            result[idx] = BuildWeightsFrom(sources[idx], targets);
+            return;
+        }
+        auto& row = result[idx];
+        row.reserve(targets.size());
+        for (const VertexId target : targets) {
+            const auto& route_internal_data = routes_internal_data_[sources[idx]][target];
+            row.push_back(route_internal_data ? std::optional<Weight>(route_internal_data->weight) : std::nullopt);
+        }
+    });
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> Router<Weight>::FindReachableVertices(VertexId from, Weight max_weight,
+                                                                             SearchStats* stats) const {
+    if (from >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchWorkspace& workspace = GetWorkspace();
+    const uint32_t current = workspace.current_version;
+    SearchSide& side = workspace.sides[0];
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.first < lhs.first; };
+    std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)> queue(greater);
+
+    side.version[from] = current;
+    side.distance[from] = ZERO_WEIGHT;
+    queue.push({ZERO_WEIGHT, from});
+
+    std::vector<std::pair<VertexId, Weight>> result;
+    while (!queue.empty()) {
+        const auto [dist, vertex] = queue.top();
+        queue.pop();
+        if (side.distance[vertex] < dist) {
+            continue;
+        }
+        result.emplace_back(vertex, dist);
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate = dist + edge.weight;
+            // Вершины за пределами бюджета в очередь не попадают
+            if (max_weight < candidate
+                || (side.IsReached(edge.to, current) && !(candidate < side.distance[edge.to]))) {
+                continue;
+            }
+            side.version[edge.to] = current;
+            side.distance[edge.to] = candidate;
+            queue.push({candidate, edge.to});
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices += result.size();
+    }
+    return result;
+}
+
+template <typename Weight>
+size_t Router<Weight>::SettleTargetsFrom(SearchWorkspace& workspace, VertexId from, const std::vector<VertexId>& targets,
+                                         bool track_parents) const {
+    const uint32_t current = workspace.current_version;
+    SearchSide& side = workspace.sides[0];
+    // Вторая сторона рабочего пространства отмечает цели, которые еще не извлечены
+    SearchSide& pending = workspace.sides[1];
+
+    size_t pending_count = 0;
+    for (const VertexId target : targets) {
+        if (!pending.IsReached(target, current)) {
+            pending.version[target] = current;
+            ++pending_count;
+        }
+    }
+
+    // Элементы сравниваются только по расстоянию, как в BuildAStarRoute с нулевой оценкой, поэтому дерево путей
+    // до извлеченных вершин то же. Ключ оценки не хранится: без оценки он равен расстоянию
+    struct QueueItem {
+        Weight distance;
+        VertexId vertex;
+    };
+    auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.distance < lhs.distance; };
+    std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)> queue(greater);
+
+    side.version[from] = current;
+    side.distance[from] = ZERO_WEIGHT;
+    if (track_parents) {
+        side.parent_edge[from] = kNoEdge;
+    }
+    queue.push({ZERO_WEIGHT, from});
+
+    size_t settled = 0;
+    while (!queue.empty() && pending_count > 0) {
+        const QueueItem item = queue.top();
+        queue.pop();
+        if (side.distance[item.vertex] < item.distance) {
+            continue;
+        }
+        ++settled;
+        if (pending.IsReached(item.vertex, current)) {
+            pending.version[item.vertex] = 0;
+            --pending_count;
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate = item.distance + edge.weight;
+            if (side.IsReached(edge.to, current) && !(candidate < side.distance[edge.to])) {
+                continue;
+            }
+            side.version[edge.to] = current;
+            side.distance[edge.to] = candidate;
+            if (track_parents) {
+                side.parent_edge[edge.to] = edge_id;
+            }
+            queue.push({candidate, edge.to});
+        }
+    }
+    return settled;
+}
+
+// Поиск Дейкстры без оценки, который останавливается, когда извлечены все цели
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildWeightsFrom(VertexId from,
+                                                                    const std::vector<VertexId>& targets) const {
+    SearchWorkspace& workspace = GetWorkspace();
+    SettleTargetsFrom(workspace, from, targets, false);
+
+    const uint32_t current = workspace.current_version;
+    const SearchSide& side = workspace.sides[0];
+    std::vector<std::optional<Weight>> result;
+    result.reserve(targets.size());
+    for (const VertexId target : targets) {
+        result.push_back(side.IsReached(target, current) ? std::optional<Weight>(side.distance[target]) : std::nullopt);
+    }
+    return result;
+}
+
+template <typename Weight>
+std::vector<std::optional<typename Router<Weight>::RouteInfo>> Router<Weight>::BuildRoutesFrom(
+        VertexId from, const std::vector<VertexId>& targets, SearchStats* stats) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    auto check_vertex = [vertex_count](VertexId vertex) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    };
+    check_vertex(from);
+    std::for_each(targets.begin(), targets.end(), check_vertex);
+
+    std::vector<std::optional<RouteInfo>> result;
+    result.reserve(targets.size());
+    if (strategy_ == RouterStrategy::kAllPairs) {
+        for (const VertexId target : targets) {
+            result.push_back(BuildAllPairsRoute(from, target));
+        }
+        return result;
+    }
+
+    SearchWorkspace& workspace = GetWorkspace();
+    const size_t settled = SettleTargetsFrom(workspace, from, targets, true);
+    const uint32_t current = workspace.current_version;
+    const SearchSide& side = workspace.sides[0];
+
+    if (stats) {
+        stats->settled_vertices += settled;
+    }
+
+    for (const VertexId target : targets) {
+        if (!side.IsReached(target, current)) {
+            result.push_back(std::nullopt);
+            continue;
+        }
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = target; vertex != from;) {
+            const EdgeId edge_id = side.parent_edge[vertex];
+            edges.push_back(edge_id);
+            vertex = graph_.GetEdge(edge_id).from;
+        }
+        std::reverse(edges.begin(), edges.end());
+        result.push_back(RouteInfo{side.distance[target], std::move(edges)});
+    }
+    return result;
+}
+
+template <typename Weight>
+void Router<Weight>::AddMemoryUsage(const std::string& prefix, memory::Report& report) const {
+    report.push_back(memory::MakeNestedUsage(prefix + ".routes_internal_data", routes_internal_data_));
+    report.push_back(memory::MakeUsage(prefix + ".incoming_offsets", incoming_offsets_));
+    report.push_back(memory::MakeUsage(prefix + ".incoming_edges", incoming_edges_));
+}
+
+template <typename Weight>
+void Router<Weight>::InitializeIncomingEdges() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    incoming_offsets_.assign(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        ++incoming_offsets_[graph_.GetEdge(edge_id).to + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        incoming_offsets_[vertex + 1] += incoming_offsets_[vertex];
+    }
+
+    incoming_edges_.resize(graph_.GetEdgeCount());
+    std::vector<size_t> positions(incoming_offsets_.begin(), incoming_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        incoming_edges_[positions[graph_.GetEdge(edge_id).to]++] = edge_id;
+    }
+}
+
+template <typename Weight>
+typename Router<Weight>::SearchWorkspace& Router<Weight>::GetWorkspace() const {
+    thread_local SearchWorkspace workspace;
+
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (workspace.sides[0].version.size() != vertex_count
+        || workspace.current_version == std::numeric_limits<uint32_t>::max()) {
+        for (SearchSide& side : workspace.sides) {
+            side.distance.assign(vertex_count, ZERO_WEIGHT);
+            side.parent_edge.assign(vertex_count, kNoEdge);
+            side.version.assign(vertex_count, 0);
+        }
+        workspace.current_version = 0;
+    }
+    ++workspace.current_version;
+    return workspace;
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildBidirectionalRoute(VertexId from, VertexId to,
+                                                                                          SearchStats* stats) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (from == to) {
+        return RouteInfo{ZERO_WEIGHT, {}};
+    }
+
+    SearchWorkspace& workspace = GetWorkspace();
+    const uint32_t current = workspace.current_version;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.first < lhs.first; };
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)>;
+    Queue queues[2] = {Queue(greater), Queue(greater)};
+
+    const VertexId sources[2] = {from, to};
+    for (int dir = 0; dir < 2; ++dir) {
+        SearchSide& side = workspace.sides[dir];
+        side.version[sources[dir]] = current;
+        side.distance[sources[dir]] = ZERO_WEIGHT;
+        side.parent_edge[sources[dir]] = kNoEdge;
+        queues[dir].push({ZERO_WEIGHT, sources[dir]});
+    }
+
+    std::optional<Weight> best;
+    VertexId meeting_vertex = from;
+    size_t settled = 0;
+
+    // Прямой поиск идет по исходящим ребрам, обратный - по входящим. Каждый шаг делает сторона с меньшим расстоянием.
+    // Путь через любую непросмотренную вершину не легче суммы расстояний в вершинах очередей, поэтому после этого
+    // поиск можно остановить
+    while (!queues[0].empty() && !queues[1].empty()) {
+        if (best && !(queues[0].top().first + queues[1].top().first < *best)) {
+            break;
+        }
+
+        const int dir = queues[1].top().first < queues[0].top().first ? 1 : 0;
+        const auto [dist, vertex] = queues[dir].top();
+        queues[dir].pop();
+
+        SearchSide& side = workspace.sides[dir];
+        const SearchSide& other = workspace.sides[1 - dir];
+        if (side.distance[vertex] < dist) {
+            continue;
+        }
+        ++settled;
+
+        auto relax = [&](EdgeId edge_id, VertexId next) {
+            const Weight candidate = dist + graph_.GetEdge(edge_id).weight;
+            if (side.IsReached(next, current) && !(candidate < side.distance[next])) {
+                return;
+            }
+            side.version[next] = current;
+            side.distance[next] = candidate;
+            side.parent_edge[next] = edge_id;
+            queues[dir].push({candidate, next});
+
+            if (other.IsReached(next, current)) {
+                const Weight total = candidate + other.distance[next];
+                if (!best || total < *best) {
+                    best = total;
+                    meeting_vertex = next;
+                }
+            }
+        };
+
+        if (dir == 0) {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                relax(edge_id, graph_.GetEdge(edge_id).to);
+            }
+        } else {
+            for (size_t i = incoming_offsets_[vertex]; i < incoming_offsets_[vertex + 1]; ++i) {
+                relax(incoming_edges_[i], graph_.GetEdge(incoming_edges_[i]).from);
+            }
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices += settled;
+    }
+    if (!best) {
+        return std::nullopt;
+    }
+
+    // Ребра от from до точки встречи восстанавливаются в обратном порядке, от точки встречи до to - в прямом
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = meeting_vertex; vertex != from;) {
+        const EdgeId edge_id = workspace.sides[0].parent_edge[vertex];
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin(), edges.end());
+    for (VertexId vertex = meeting_vertex; vertex != to;) {
+        const EdgeId edge_id = workspace.sides[1].parent_edge[vertex];
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).to;
+    }
+
+    return RouteInfo{*best, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildAStarRoute(VertexId from, VertexId to,
+                                                                                  SearchStats* stats) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    SearchWorkspace& workspace = GetWorkspace();
+    const uint32_t current = workspace.current_version;
+    SearchSide& side = workspace.sides[0];
+
+    // Вершины извлекаются по сумме пройденного веса и оценки оставшегося
+    struct QueueItem {
+        Weight key;
+        Weight distance;
+        VertexId vertex;
+    };
+    auto greater = [](const QueueItem& lhs, const QueueItem& rhs) { return rhs.key < lhs.key; };
+    std::priority_queue<QueueItem, std::vector<QueueItem>, decltype(greater)> queue(greater);
+
+    side.version[from] = current;
+    side.distance[from] = ZERO_WEIGHT;
+    side.parent_edge[from] = kNoEdge;
+    queue.push({potential_(from, to), ZERO_WEIGHT, from});
+
+    size_t settled = 0;
+    bool found = false;
+    while (!queue.empty()) {
+        const QueueItem item = queue.top();
+        queue.pop();
+        if (side.distance[item.vertex] < item.distance) {
+            continue;
+        }
+        ++settled;
+        // При согласованной оценке вес пути до извлеченной вершины окончательный
+        if (item.vertex == to) {
+            found = true;
+            break;
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate = item.distance + edge.weight;
+            if (side.IsReached(edge.to, current) && !(candidate < side.distance[edge.to])) {
+                continue;
+            }
+            side.version[edge.to] = current;
+            side.distance[edge.to] = candidate;
+            side.parent_edge[edge.to] = edge_id;
+            queue.push({candidate + potential_(edge.to, to), candidate, edge.to});
+        }
+    }
+
+    if (stats) {
+        stats->settled_vertices += settled;
+    }
+    if (!found) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = to; vertex != from;) {
+        const EdgeId edge_id = side.parent_edge[vertex];
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{side.distance[to], std::move(edges)};
+}
+
 }  // namespace graph
\ No newline at end of file
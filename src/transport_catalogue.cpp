@@ -1,13 +1,20 @@
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "parallel.h"
 
 using namespace std;
 using Bus = domain::Bus;
 using Stop = domain::Stop;
 using BusStat = domain::BusStat;
+using BusDistances = domain::BusDistances;
+using BusSegmentStat = domain::BusSegmentStat;
 using BusesTable = TransportCatalogue::BusesTable;
 
 void TransportCatalogue::AddBus(string_view bus_name, const vector<string_view>& route, bool is_roundtrip) {
+    ++version_;
     vector<const Stop*> final_route;
     final_route.reserve(route.size());
 
@@ -20,7 +27,7 @@ void TransportCatalogue::AddBus(string_view bus_name, const vector<string_view>&
     
     // Bus bus{string(bus_name), move(final_route), is_roundtrip};
     // all_buses_.push_back(move(bus));
-    all_buses_.emplace_back(string(bus_name), move(final_route), is_roundtrip);
+    all_buses_.emplace_back(string(bus_name), move(final_route), is_roundtrip, vector<double>{}, nullopt);
 
     Bus* bus_ptr = &all_buses_.back();
     buses_map_.emplace(bus_ptr->name, bus_ptr);
@@ -28,9 +35,12 @@ void TransportCatalogue::AddBus(string_view bus_name, const vector<string_view>&
     for (auto stop_ptr : bus_ptr->stops) {
         stop_to_buses_[stop_ptr->name].insert(bus_ptr);
     }
+
+    bus_distances_.emplace(bus_ptr, ComputeBusDistances(*bus_ptr));
 }
 
 void TransportCatalogue::AddStop(string_view stop_name, geo::Coordinates coord) {
+    ++version_;
     // Так как остановка может фигурировать как "соседняя" при создании другой ради указания географического маршрута,
     // эта "соседняя" остановка могла быть создана до ее официального создания через AddStop.
     // поэтому при официальном создании через AddStop проверяется, была ли создана остановка ранее или нет
@@ -38,11 +48,120 @@ void TransportCatalogue::AddStop(string_view stop_name, geo::Coordinates coord)
     // Stop stop{string(stop_name), coord};
     // all_stops_.push_back(move(stop));
 
-    all_stops_.emplace_back(string(stop_name), coord);
+    all_stops_.emplace_back(string(stop_name), coord, nullopt);
     Stop* stop_ptr = &all_stops_.back();
     stops_map_.emplace(stop_ptr->name, stop_ptr);
 }
 
+namespace {
+
+// Минимальное количество названий остановок на поток при их параллельном разрешении в указатели
+constexpr size_t kNamesPerThread = 1 << 12;
+
+} // namespace
+
+void TransportCatalogue::AddStops(const vector<domain::dto::StopDescription>& stops) {
+    ++version_;
+    // Остановки могут добавляться частями, поэтому резерв растет не меньше чем вдвое, иначе рехэширование было бы
+    // на каждой части
+    stops_map_.reserve(max(stops_map_.size() + stops.size(), 2 * stops_map_.size()));
+    for (const auto& [name, coordinates, wait_time] : stops) {
+        const Stop& stop = all_stops_.emplace_back(string(name), coordinates, wait_time);
+        stops_map_.emplace(stop.name, &stop);
+    }
+}
+
+void TransportCatalogue::SetRoadDistances(const vector<domain::dto::RoadDistanceDescription>& distances) {
+    ++version_;
+    // Поиск остановок только читает stops_map_, поэтому выполняется параллельно
+    // nullopt - одна из остановок не найдена, такое расстояние пропускается, как и в SetRoadDistance
+    vector<optional<StopsPair>> resolved(distances.size());
+    parallel::For(distances.size(), parallel::GetThreadCount(distances.size(), kNamesPerThread), [&](size_t idx) {
+        const Stop* from_ptr = FindStop(distances[idx].from);
+        const Stop* to_ptr = FindStop(distances[idx].to);
+        if (from_ptr != nullptr && to_ptr != nullptr) {
+            resolved[idx] = StopsPair{from_ptr->name, to_ptr->name};
+        }
+    });
+
+    stops_distances_.reserve(stops_distances_.size() + distances.size());
+    vector<const Stop*> changed_stops;
+    for (size_t idx = 0; idx < distances.size(); ++idx) {
+        if (resolved[idx].has_value() && stops_distances_.emplace(*resolved[idx], distances[idx].distance).second) {
+            changed_stops.push_back(FindStop(resolved[idx]->first));
+            changed_stops.push_back(FindStop(resolved[idx]->second));
+        }
+    }
+    UpdateBusDistances(changed_stops);
+}
+
+void TransportCatalogue::AddBuses(const vector<domain::dto::BusDescription>& buses) {
+    ++version_;
+    size_t total_stops = 0;
+    vector<size_t> offsets;
+    offsets.reserve(buses.size());
+    for (const auto& bus : buses) {
+        offsets.push_back(total_stops);
+        total_stops += bus.stops.size();
+    }
+
+    // Разрешение названий остановок всех маршрутов параллельно
+    vector<vector<const Stop*>> routes(buses.size());
+    parallel::For(buses.size(), parallel::GetThreadCount(total_stops, kNamesPerThread), [&](size_t idx) {
+        auto& route = routes[idx];
+        route.reserve(buses[idx].stops.size());
+        for (auto name : buses[idx].stops) {
+            route.push_back(FindStop(name));
+        }
+    });
+
+    buses_map_.reserve(buses_map_.size() + buses.size());
+    vector<const Bus*> added;
+    added.reserve(buses.size());
+    for (size_t idx = 0; idx < buses.size(); ++idx) {
+        const Bus& bus = all_buses_.emplace_back(string(buses[idx].name), move(routes[idx]), buses[idx].is_roundtrip,
+                                                 buses[idx].departures, buses[idx].velocity);
+        buses_map_.emplace(bus.name, &bus);
+        added.push_back(&bus);
+    }
+
+    // Расстояния разных автобусов независимы, поэтому считаются параллельно
+    vector<BusDistances> distances(added.size());
+    parallel::For(added.size(), parallel::GetThreadCount(total_stops, kNamesPerThread), [&](size_t idx) {
+        distances[idx] = ComputeBusDistances(*added[idx]);
+    });
+    bus_distances_.reserve(bus_distances_.size() + added.size());
+    for (size_t idx = 0; idx < added.size(); ++idx) {
+        bus_distances_.emplace(added[idx], move(distances[idx]));
+    }
+
+    // Пары (остановка, автобус) раскладываются по заранее вычисленным смещениям, сортируются и группируются по остановке,
+    // после чего множество автобусов каждой остановки заполняется одним диапазоном
+    using StopBus = pair<const Stop*, const Bus*>;
+    vector<StopBus> stop_bus_pairs(total_stops);
+    parallel::For(added.size(), parallel::GetThreadCount(total_stops, kNamesPerThread), [&](size_t idx) {
+        auto out = stop_bus_pairs.begin() + offsets[idx];
+        for (const Stop* stop : added[idx]->stops) {
+            *out++ = {stop, added[idx]};
+        }
+    });
+
+    parallel::Sort(stop_bus_pairs.begin(), stop_bus_pairs.end(), less<StopBus>{});
+    stop_bus_pairs.erase(unique(stop_bus_pairs.begin(), stop_bus_pairs.end()), stop_bus_pairs.end());
+
+    for (auto it = stop_bus_pairs.begin(); it != stop_bus_pairs.end();) {
+        auto group_end = find_if(it, stop_bus_pairs.end(), [stop = it->first](const StopBus& item) {
+            return item.first != stop;
+        });
+
+        BusesTable& table = stop_to_buses_[it->first->name];
+        table.reserve(table.size() + static_cast<size_t>(group_end - it));
+        for (; it != group_end; ++it) {
+            table.insert(it->second);
+        }
+    }
+}
+
 const Stop* TransportCatalogue::FindStop(string_view name) const {
     auto it = stops_map_.find(name);
     return it != stops_map_.end() ? it->second : nullptr;
@@ -65,50 +184,16 @@ optional<BusStat> TransportCatalogue::GetBusInfo(string_view bus_id) const {
         return {};
     }
 
-    unordered_set<const Stop*> uniq_stops;
     // Размер контейнера точно будет не больше количества остановок, но преждевременная резервация убережет от реаллокаций
-    uniq_stops.reserve(stops.size());
-    double total_geo_distance = 0.;
-    int total_road_distance = 0;
-    
-    const Stop* prev = stops.front();
-    uniq_stops.insert(stops.front());
+    unordered_set<const Stop*> uniq_stops(stops.begin(), stops.end(), stops.size());
 
-    for (size_t i = 1; i < stops.size(); ++i) {
-        const Stop* current = stops[i];
-        uniq_stops.insert(current);
-        // Для geo_distance проще напрямую вызывать ComputeDistance, чем GetGeographicalDistance,
-        // т.к. в GetGeographicalDistance из sv опять придется получить указатель на Stop и лишь потом
-        // получаются его координаты для рассчета растояния
-        auto geo_distance = ComputeDistance(prev->coordinates, current->coordinates);
-        total_geo_distance += geo_distance;
-
-        // Если GetRoadDistance вернул не nullopt, то это значение суммируется с total_road_distance
-        if (auto road_distance = GetRoadDistance(prev->name, current->name)) {
-            total_road_distance += *road_distance;
-        } else { // иначе дорожным расстоянием считается географическое
-            total_road_distance += geo_distance;
-        }
-
-        prev = current;
-    }
-
-    // Рассчет расстояния в обратном направлении для некольцевого направления
-    // Опять приходится обходить все остановки, так как расстояние от A до B может быть не равно расстоянию от B до A
+    // Полная длина маршрута - последние элементы накопленных расстояний, для некольцевого маршрута в обе стороны
+    const BusDistances& distances = GetBusDistances(bus);
+    double total_geo_distance = distances.forward_geo.back();
+    int total_road_distance = distances.forward_road.back();
     if (!bus->is_roundtrip) {
-        for (size_t i = stops.size() - 1; i-- > 0;) {
-            const Stop* current = stops[i];
-            auto geo_distance = ComputeDistance(prev->coordinates, current->coordinates);
-            total_geo_distance += geo_distance;
-
-            if (auto road_distance = GetRoadDistance(prev->name, current->name)) {
-                total_road_distance += *road_distance;
-            } else {
-                total_road_distance += geo_distance;
-            }
-
-            prev = current;
-        }
+        total_geo_distance += distances.backward_geo.back();
+        total_road_distance += distances.backward_road.back();
     }
 
     int stop_count = bus->is_roundtrip ? stops.size() : stops.size() * 2 - 1;
@@ -131,6 +216,7 @@ optional<const BusesTable> TransportCatalogue::GetStopStat(string_view stop_name
 }
 
 void TransportCatalogue::SetRoadDistance(string_view from, string_view to, int distance) {
+    ++version_;
     // Необходимо создать пару string_view, которые ссылаются на оригинальные строки класса,
     // а не из стека, на которые ссылаются параметры функции
     const Stop* from_ptr = FindStop(from);
@@ -141,7 +227,9 @@ void TransportCatalogue::SetRoadDistance(string_view from, string_view to, int d
     }
 
     StopsPair stops_pair = {from_ptr->name, to_ptr->name};
-    stops_distances_.emplace(stops_pair, distance);
+    if (stops_distances_.emplace(stops_pair, distance).second) {
+        UpdateBusDistances({from_ptr, to_ptr});
+    }
 }
 
 std::optional<int> TransportCatalogue::GetGeographicalDistance(string_view from, string_view to) const {
@@ -178,4 +266,138 @@ const std::deque<Stop>& TransportCatalogue::GetAllStops() const noexcept {
 
 const std::deque<Bus>& TransportCatalogue::GetAllBuses() const noexcept {
     return all_buses_;
-}
\ No newline at end of file
+}
+
+const BusDistances& TransportCatalogue::GetBusDistances(const Bus* bus) const {
+    return bus_distances_.at(bus);
+}
+
+int TransportCatalogue::GetSegmentDistance(const Stop* from, const Stop* to) const {
+    if (auto road_distance = GetRoadDistance(from->name, to->name)) {
+        return *road_distance;
+    }
+    return static_cast<int>(ComputeDistance(from->coordinates, to->coordinates));
+}
+
+BusDistances TransportCatalogue::ComputeBusDistances(const Bus& bus) const {
+    const auto& stops = bus.stops;
+    BusDistances result;
+    if (stops.empty()) {
+        return result;
+    }
+
+    result.forward_road.resize(stops.size(), 0);
+    result.forward_geo.resize(stops.size(), 0.);
+    for (size_t i = 1; i < stops.size(); ++i) {
+        result.forward_road[i] = result.forward_road[i - 1] + GetSegmentDistance(stops[i - 1], stops[i]);
+        result.forward_geo[i] = result.forward_geo[i - 1] + ComputeDistance(stops[i - 1]->coordinates, stops[i]->coordinates);
+    }
+
+    // Географическое расстояние симметрично, а дорожное от A до B может быть не равно расстоянию от B до A
+    if (!bus.is_roundtrip) {
+        result.backward_road.resize(stops.size(), 0);
+        result.backward_geo = result.forward_geo;
+        for (size_t i = 1; i < stops.size(); ++i) {
+            result.backward_road[i] = result.backward_road[i - 1] + GetSegmentDistance(stops[i], stops[i - 1]);
+        }
+    }
+
+    result.stop_positions.reserve(stops.size());
+    for (uint32_t i = 0; i < stops.size(); ++i) {
+        result.stop_positions.emplace_back(stops[i], i);
+    }
+    sort(result.stop_positions.begin(), result.stop_positions.end());
+
+    return result;
+}
+
+optional<BusSegmentStat> TransportCatalogue::GetBusSegment(string_view bus_name, string_view from, string_view to) const {
+    const Bus* bus = FindBus(bus_name);
+    const Stop* from_stop = FindStop(from);
+    const Stop* to_stop = FindStop(to);
+    if (bus == nullptr || from_stop == nullptr || to_stop == nullptr) {
+        return nullopt;
+    }
+
+    // Позиции остановки - непрерывный диапазон отсортированных пар (остановка, позиция)
+    const BusDistances& distances = GetBusDistances(bus);
+    const auto& positions = distances.stop_positions;
+    auto find_positions = [&positions](const Stop* stop) {
+        using Position = pair<const Stop*, uint32_t>;
+        return pair{lower_bound(positions.begin(), positions.end(), Position{stop, 0}),
+                    upper_bound(positions.begin(), positions.end(), Position{stop, numeric_limits<uint32_t>::max()})};
+    };
+    const auto [from_first, from_last] = find_positions(from_stop);
+    const auto [to_first, to_last] = find_positions(to_stop);
+
+    optional<BusSegmentStat> best;
+    auto update = [&best](int road_distance, int span_count) {
+        if (!best || road_distance < best->road_distance
+            || (road_distance == best->road_distance && span_count < best->span_count)) {
+            best = BusSegmentStat{road_distance, span_count};
+        }
+    };
+
+    // Позиций у остановки обычно одна-две, поэтому перебираются все пары
+    for (auto from_it = from_first; from_it != from_last; ++from_it) {
+        for (auto to_it = to_first; to_it != to_last; ++to_it) {
+            const uint32_t i = from_it->second;
+            const uint32_t j = to_it->second;
+            if (i <= j) {
+                update(distances.forward_road[j] - distances.forward_road[i], static_cast<int>(j - i));
+            } else if (!bus->is_roundtrip) {
+                update(distances.backward_road[i] - distances.backward_road[j], static_cast<int>(i - j));
+            }
+        }
+    }
+
+    return best;
+}
+
+void TransportCatalogue::UpdateBusDistances(const vector<const Stop*>& stops) {
+    unordered_set<const Bus*> buses;
+    for (const Stop* stop : stops) {
+        if (auto it = stop_to_buses_.find(stop->name); it != stop_to_buses_.end()) {
+            buses.insert(it->second.begin(), it->second.end());
+        }
+    }
+    for (const Bus* bus : buses) {
+        bus_distances_[bus] = ComputeBusDistances(*bus);
+    }
+}
+
+uint64_t TransportCatalogue::GetVersion() const noexcept {
+    return version_;
+}
+
+void TransportCatalogue::AddMemoryUsage(memory::Report& report) const {
+    size_t stop_names = 0;
+    for (const Stop& stop : all_stops_) {
+        stop_names += memory::HeapBytes(stop.name);
+    }
+    report.push_back(memory::MakeUsage("catalogue.stops", all_stops_, stop_names));
+
+    size_t bus_data = 0;
+    for (const Bus& bus : all_buses_) {
+        bus_data += memory::HeapBytes(bus.name) + memory::HeapBytes(bus.stops) + memory::HeapBytes(bus.departures);
+    }
+    report.push_back(memory::MakeUsage("catalogue.buses", all_buses_, bus_data));
+
+    report.push_back(memory::MakeHashTableUsage("catalogue.stops_map", stops_map_));
+    report.push_back(memory::MakeHashTableUsage("catalogue.buses_map", buses_map_));
+
+    size_t buses_tables = 0;
+    for (const auto& [stop, buses] : stop_to_buses_) {
+        buses_tables += memory::HashTableHeapBytes(buses);
+    }
+    report.push_back(memory::MakeHashTableUsage("catalogue.stop_to_buses", stop_to_buses_, buses_tables));
+    report.push_back(memory::MakeHashTableUsage("catalogue.stops_distances", stops_distances_));
+
+    size_t distances = 0;
+    for (const auto& [bus, bus_distances] : bus_distances_) {
+        distances += memory::HeapBytes(bus_distances.forward_road) + memory::HeapBytes(bus_distances.forward_geo)
+            + memory::HeapBytes(bus_distances.backward_road) + memory::HeapBytes(bus_distances.backward_geo)
+            + memory::HeapBytes(bus_distances.stop_positions);
+    }
+    report.push_back(memory::MakeHashTableUsage("catalogue.bus_distances", bus_distances_, distances));
+}
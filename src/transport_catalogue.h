@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
 #include <vector>
 #include <optional>
@@ -10,6 +11,7 @@
 
 #include "domain.h"
 #include "geo.h"
+#include "memory_usage.h"
 
 class TransportCatalogue {
 
@@ -20,11 +22,21 @@ public:
 	using Bus = domain::Bus;
 	using BusesTable = std::unordered_set<const Bus*>;
 	using BusStat = domain::BusStat;
+	using BusDistances = domain::BusDistances;
+	using BusSegmentStat = domain::BusSegmentStat;
 	using Stop = domain::Stop;
 
 	void AddBus(string_view bus_name, const std::vector<string_view>& route, bool is_roundtrip);
 	void AddStop(string_view stop_name, geo::Coordinates coord);
 
+	/**
+	 * Пакетная загрузка. Хэш-таблицы резервируются под весь пакет сразу, названия остановок разрешаются
+	 * в указатели параллельно, а `stop_to_buses_` строится через параллельную сортировку пар (остановка, автобус)
+	 */
+	void AddStops(const std::vector<domain::dto::StopDescription>& stops);
+	void SetRoadDistances(const std::vector<domain::dto::RoadDistanceDescription>& distances);
+	void AddBuses(const std::vector<domain::dto::BusDescription>& buses);
+
 	/**
 	 * Поиск автобуса. При отсутсвии возвращает `nullptr`
 	 */
@@ -57,9 +69,33 @@ public:
 	 */
 	std::optional<int> GetGeographicalDistance(string_view from, string_view to) const;
 
+	/**
+	 * Накопленные дорожные и географические расстояния вдоль маршрута. Строятся один раз при добавлении автобуса
+	 * и перестраиваются, если позже задано дорожное расстояние между остановками маршрута. `bus` - автобус этого каталога
+	 */
+	const BusDistances& GetBusDistances(const Bus* bus) const;
+
+	/**
+	 * Кратчайший участок маршрута `bus_name` от `from` до `to` по ходу движения автобуса, для некольцевого маршрута -
+	 * в любом из двух направлений. Позиции остановок ищутся бинарным поиском, расстояние - разность накопленных расстояний.
+	 * nullopt, если автобус или остановки не найдены или автобус не проезжает от `from` до `to`
+	 */
+	[[nodiscard]] std::optional<BusSegmentStat> GetBusSegment(string_view bus_name, string_view from, string_view to) const;
+
 	const std::deque<Stop>& GetAllStops() const noexcept;
 	const std::deque<Bus>& GetAllBuses() const noexcept;
 
+	/**
+	 * Версия данных каталога. Увеличивается при каждом изменении, поэтому по ней можно проверить,
+	 * что закэшированный ответ получен на текущих данных
+	 */
+	uint64_t GetVersion() const noexcept;
+
+	/**
+	 * Добавляет в `report` память остановок, автобусов, индексов по названию, расстояний и автобусов остановок
+	 */
+	void AddMemoryUsage(memory::Report& report) const;
+
 private:
 	std::deque<Stop> all_stops_;
 	std::deque<Bus> all_buses_;
@@ -85,4 +121,14 @@ private:
 	};
 
 	std::unordered_map<StopsPair, int, StopPairHasher> stops_distances_ ;
+
+	std::unordered_map<const Bus*, BusDistances> bus_distances_;
+
+	uint64_t version_ = 0;
+
+	// Дорожное расстояние перегона, а если оно не задано - географическое, округленное вниз до метра
+	int GetSegmentDistance(const Stop* from, const Stop* to) const;
+	BusDistances ComputeBusDistances(const Bus& bus) const;
+	// Перестраивает накопленные расстояния автобусов, проходящих через `stops`
+	void UpdateBusDistances(const std::vector<const Stop*>& stops);
 };
\ No newline at end of file
@@ -1,5 +1,13 @@
 #include "transport_router.h"
 
+#include "instrumentation.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
 using Bus = TransportRouter::Bus;
 using Stop = TransportRouter::Stop;
 using RouteResponse = TransportRouter::RouteResponse;
@@ -7,29 +15,74 @@ using RouteItem = TransportRouter::RouteItem;
 using Waiting = TransportRouter::Waiting;
 using Trip = TransportRouter::Trip;
 using Time = TransportRouter::Time;
-using GraphData = TransportRouter::GraphData;
+using EdgeData = TransportRouter::EdgeData;
+using ParetoRoute = TransportRouter::ParetoRoute;
+using RouteInfo = TransportRouter::RouteInfo;
 using Graph = TransportRouter::Graph;
 
 using namespace std;
 using namespace graph;
 
-
-TransportRouter::TransportRouter(TransportCatalogue& db, domain::dto::RoutingSettings settings)
+TransportRouter::TransportRouter(const TransportCatalogue& db, domain::dto::RoutingSettings settings)
     : db_(db),
       settings_(settings),
       all_stops_(db_.GetAllStops()),
-      vertices_id_(VerticesIdInitialization()),
-      graph_(all_stops_.size()) {
+      vertices_id_(VerticesIdInitialization()) {
+        BlocksInitialization();
+        TimetableInitialization();
+        PositionsInitialization();
+
+        // Плотный граф иерархии сжатия не нужен: и поиск, и ответы строятся по ride_graph_, а роутер поиска Дейкстры
+        // для Isochrone и Alternatives строится по нему же при первом таком запросе
+        if (settings_.strategy == domain::dto::RoutingStrategy::kContractionHierarchy) {
+            RideGraphInitialization();
+            TC_COUNTER_ADD("graph.vertices", ride_graph_.GetVertexCount());
+            TC_COUNTER_ADD("graph.edges_added", ride_graph_.GetEdgeCount());
+            TC_SCOPED_TIMER("transport_router.router_build");
+            contraction_hierarchy_.emplace(ride_graph_);
+            TC_COUNTER_ADD("graph.shortcuts_added", contraction_hierarchy_->GetShortcutCount());
+            return;
+        }
+
         GraphInitialization();
+        TC_COUNTER_ADD("graph.vertices", graph_.GetVertexCount());
+        TC_COUNTER_ADD("graph.edges_added", graph_.GetEdgeCount());
+
         // Роутер зависит от инициализации графа, поэтому инициализируется только после полной инициализации графа
-        router_.emplace(graph_);
+        TC_SCOPED_TIMER("transport_router.router_build");
+        switch (settings_.strategy) {
+            case domain::dto::RoutingStrategy::kDijkstra:
+                router_.emplace(graph_, RouterStrategy::kDijkstra);
+                break;
+            case domain::dto::RoutingStrategy::kBidirectionalDijkstra:
+                router_.emplace(graph_, RouterStrategy::kBidirectionalDijkstra);
+                break;
+            case domain::dto::RoutingStrategy::kAStar:
+                router_.emplace(graph_, RouterStrategy::kAStar, MakeGeographicPotential());
+                break;
+            default:
+                router_.emplace(graph_);
+                break;
+        }
       }
 
-optional<RouteResponse> TransportRouter::GetRoute(string_view from, string_view to) const {
-    VertexId from_id = vertices_id_.at(db_.FindStop(from));
-    VertexId to_id = vertices_id_.at(db_.FindStop(to));
+optional<RouteResponse> TransportRouter::GetRoute(string_view from, string_view to, SearchStats* stats) const {
+    const auto vertices = FindVertices({from, to});
+    if (!vertices) {
+        return std::nullopt;
+    }
+    const VertexId from_id = (*vertices)[0];
+    const VertexId to_id = (*vertices)[1];
+
+    if (contraction_hierarchy_) {
+        auto route = contraction_hierarchy_->FindRoute(from_id, to_id, stats);
+        if (!route.has_value()) {
+            return std::nullopt;
+        }
+        return BuildRouteResponse(RouteInfo{route->weight, move(route->edges)});
+    }
 
-    auto route = router_->BuildRoute(from_id, to_id);
+    auto route = router_->BuildRoute(from_id, to_id, stats);
 
     if (!route.has_value()) {
         return std::nullopt;
@@ -38,6 +91,318 @@ optional<RouteResponse> TransportRouter::GetRoute(string_view from, string_view
     return BuildRouteResponse(*route);
 }
 
+optional<vector<optional<RouteResponse>>> TransportRouter::GetRoutesFrom(string_view from,
+                                                                         const vector<string_view>& targets,
+                                                                         SearchStats* stats) const {
+    TC_SCOPED_TIMER("transport_router.routes_from");
+    const auto from_id = FindVertices({from});
+    const auto target_ids = FindVertices(targets);
+    if (!from_id || !target_ids) {
+        return std::nullopt;
+    }
+
+    vector<optional<RouteResponse>> result;
+    result.reserve(targets.size());
+    // Запрос к иерархии сжатия просматривает малую часть графа, поэтому каждая цель ищется отдельно
+    // и роутер поиска Дейкстры не строится
+    if (contraction_hierarchy_) {
+        for (const VertexId target : *target_ids) {
+            auto route = contraction_hierarchy_->FindRoute(from_id->front(), target, stats);
+            result.push_back(route ? optional(BuildRouteResponse(RouteInfo{route->weight, move(route->edges)})) : nullopt);
+        }
+        return result;
+    }
+
+    for (const auto& route : router_->BuildRoutesFrom(from_id->front(), *target_ids, stats)) {
+        result.push_back(route ? optional(BuildRouteResponse(*route)) : nullopt);
+    }
+    return result;
+}
+
+optional<RouteResponse> TransportRouter::GetRouteAt(string_view from, string_view to, Time departure_time,
+                                                    SearchStats* stats) const {
+    if (!timetable_) {
+        return GetRoute(from, to, stats);
+    }
+
+    TC_SCOPED_TIMER("transport_router.timetable_route");
+    const auto vertices = FindVertices({from, to});
+    if (!vertices) {
+        return std::nullopt;
+    }
+    const auto from_id = static_cast<transit::StopId>((*vertices)[0]);
+    const auto to_id = static_cast<transit::StopId>((*vertices)[1]);
+    auto journey = timetable_->FindEarliestArrival(from_id, to_id, departure_time, stats);
+    if (!journey.has_value()) {
+        return std::nullopt;
+    }
+    return BuildRouteResponse(*journey, departure_time);
+}
+
+optional<vector<RouteResponse>> TransportRouter::GetAlternativeRoutes(string_view from, string_view to, size_t count,
+                                                                      SearchStats* stats) const {
+    TC_SCOPED_TIMER("transport_router.alternative_routes");
+    const auto vertices = FindVertices({from, to});
+    if (!vertices) {
+        return std::nullopt;
+    }
+
+    // Фильтр сохраняет принятые маршруты, поэтому результат роутера не нужен. Для contraction_hierarchy
+    // пути проходят по ребрам ride_graph_
+    vector<RouteInfo> accepted;
+    vector<vector<Span>> accepted_spans;
+    auto accept = [this, &accepted, &accepted_spans](const RouteInfo& route) {
+        vector<Span> spans = GetRouteSpans(GetRouteLegs(route));
+        vector<Span> shared;
+        for (const auto& other : accepted_spans) {
+            shared.clear();
+            set_intersection(spans.begin(), spans.end(), other.begin(), other.end(), back_inserter(shared));
+            if (static_cast<double>(shared.size()) > kMaxSharedSpans * static_cast<double>(spans.size())
+                || (spans.empty() && other.empty())) {
+                return false;
+            }
+        }
+        accepted.push_back(route);
+        accepted_spans.push_back(move(spans));
+        return true;
+    };
+    GetRouter().BuildAlternativeRoutes((*vertices)[0], (*vertices)[1], count, kAlternativeStretch, accept, stats);
+
+    vector<RouteResponse> result;
+    result.reserve(accepted.size());
+    for (const RouteInfo& route : accepted) {
+        result.push_back(BuildRouteResponse(route));
+    }
+    return result;
+}
+
+optional<vector<ParetoRoute>> TransportRouter::GetParetoRoutes(string_view from, string_view to, SearchStats* stats) const {
+    TC_SCOPED_TIMER("transport_router.pareto_routes");
+    const auto vertices = FindVertices({from, to});
+    if (!vertices) {
+        return std::nullopt;
+    }
+    const VertexId source = (*vertices)[0];
+    const VertexId target = (*vertices)[1];
+    if (source == target) {
+        return vector<ParetoRoute>{{RouteResponse{{}, 0.0}, 0}};
+    }
+
+    // Поиск по раундам (RAPTOR без расписаний): раунд k просматривает блоки, проходящие через остановки, улучшенные
+    // в раунде k - 1, от первой такой позиции. Посадка в позиции j возможна с прибытием раунда k - 1 плюс ожидание,
+    // высадка улучшает метку раунда k, если она лучше всех прежних прибытий на остановку и в `target`.
+    // Каждое улучшение `target` - новая точка множества Парето
+    RoundsWorkspace& workspace = GetRoundsWorkspace();
+    const uint32_t current = workspace.current_version;
+    const size_t stop_count = all_stops_.size();
+    constexpr Time kInfinity = numeric_limits<Time>::infinity();
+
+    auto has_label = [&](size_t round, VertexId stop) {
+        return workspace.label_versions[round * stop_count + stop] == current;
+    };
+    auto best = [&](VertexId stop) {
+        return workspace.best_versions[stop] == current ? workspace.best[stop] : kInfinity;
+    };
+    auto set_label = [&](size_t round, VertexId stop, RoundLabel label) {
+        workspace.label_versions[round * stop_count + stop] = current;
+        workspace.labels[round * stop_count + stop] = label;
+        workspace.best_versions[stop] = current;
+        workspace.best[stop] = label.arrival;
+    };
+    // Прибытие не больше чем за `round` поездок - метка последнего раунда, в котором остановка была улучшена
+    auto arrival_until = [&](size_t round, VertexId stop) {
+        for (size_t r = round + 1; r-- > 0;) {
+            if (has_label(r, stop)) {
+                return workspace.labels[r * stop_count + stop].arrival;
+            }
+        }
+        return kInfinity;
+    };
+
+    set_label(0, source, {0.0, 0, 0});
+    vector<VertexId> marked{source};
+    vector<VertexId> next_marked;
+    vector<uint32_t> blocks;
+    vector<size_t> front_rounds;
+    size_t scanned = 0;
+
+    for (size_t round = 1; round <= kMaxParetoRides && !marked.empty(); ++round) {
+        if (++workspace.block_version == numeric_limits<uint32_t>::max()) {
+            fill(workspace.block_versions.begin(), workspace.block_versions.end(), 0);
+            workspace.block_version = 1;
+        }
+        const uint32_t block_version = workspace.block_version;
+
+        blocks.clear();
+        for (const VertexId stop : marked) {
+            for (uint32_t i = stop_positions_offsets_[stop]; i < stop_positions_offsets_[stop + 1]; ++i) {
+                const auto [block, position] = stop_positions_[i];
+                if (workspace.block_versions[block] != block_version) {
+                    workspace.block_versions[block] = block_version;
+                    workspace.block_starts[block] = position;
+                    blocks.push_back(block);
+                } else {
+                    workspace.block_starts[block] = min(workspace.block_starts[block], position);
+                }
+            }
+        }
+
+        next_marked.clear();
+        for (const uint32_t block_id : blocks) {
+            const EdgesBlock& block = edge_blocks_[block_id];
+            const size_t base = block.ride_vertex_offset - stop_count;
+            const size_t n = block.bus->stops.size();
+            const double velocity = GetVelocity(*block.bus);
+
+            optional<size_t> board;
+            Time board_time = 0.0;
+            for (size_t j = workspace.block_starts[block_id]; j < n; ++j) {
+                ++scanned;
+                const VertexId stop = position_stops_[base + j];
+                Time arrival = kInfinity;
+                if (board) {
+                    arrival = board_time + CalculateTime(position_distances_[base + j] - position_distances_[base + *board], velocity);
+                    if (arrival < best(stop) && arrival < best(target)) {
+                        if (!has_label(round, stop)) {
+                            next_marked.push_back(stop);
+                        }
+                        set_label(round, stop, {arrival, static_cast<uint32_t>(base + *board), static_cast<uint32_t>(base + j)});
+                    }
+                }
+
+                const Time departure = arrival_until(round - 1, stop) + GetWaitTime(all_stops_[stop]);
+                if (departure < arrival) {
+                    board = j;
+                    board_time = departure;
+                }
+            }
+        }
+
+        if (has_label(round, target)) {
+            front_rounds.push_back(round);
+        }
+        swap(marked, next_marked);
+    }
+
+    if (stats) {
+        stats->settled_vertices += scanned;
+    }
+
+    vector<ParetoRoute> result;
+    result.reserve(front_rounds.size());
+    for (const size_t round : front_rounds) {
+        // Поездки восстанавливаются с конца: остановка посадки достигнута не больше чем за на одну поездку меньше
+        vector<RoundLabel> legs;
+        VertexId stop = target;
+        for (size_t r = round; stop != source; --r) {
+            while (!has_label(r, stop)) {
+                --r;
+            }
+            const RoundLabel& label = workspace.labels[r * stop_count + stop];
+            legs.push_back(label);
+            stop = position_stops_[label.board];
+        }
+        reverse(legs.begin(), legs.end());
+
+        vector<RouteItem> items;
+        items.reserve(legs.size() * 2);
+        for (const RoundLabel& leg : legs) {
+            auto block = prev(upper_bound(edge_blocks_.begin(), edge_blocks_.end(), leg.board + stop_count,
+                                          [](size_t vertex, const EdgesBlock& item) { return vertex < item.ride_vertex_offset; }));
+            const Stop& board_stop = all_stops_[position_stops_[leg.board]];
+            items.emplace_back(Waiting{
+                .stop_name = board_stop.name,
+                .time = static_cast<double>(GetWaitTime(board_stop))
+            });
+            items.emplace_back(Trip{
+                .bus = block->bus->name,
+                .time = CalculateTime(position_distances_[leg.alight] - position_distances_[leg.board], GetVelocity(*block->bus)),
+                .span_count = static_cast<int>(leg.alight - leg.board)
+            });
+        }
+
+        result.push_back({
+            .route = RouteResponse{
+                .items = move(items),
+                .total_time = workspace.labels[round * stop_count + target].arrival
+            },
+            .transfers = static_cast<int>(legs.size()) - 1
+        });
+    }
+    return result;
+}
+
+optional<vector<vector<optional<TransportRouter::Time>>>> TransportRouter::GetTravelTimes(
+        const vector<string_view>& sources, const vector<string_view>& targets) const {
+    TC_SCOPED_TIMER("transport_router.travel_times");
+    auto source_ids = FindVertices(sources);
+    auto target_ids = FindVertices(targets);
+    if (!source_ids || !target_ids) {
+        return std::nullopt;
+    }
+
+    if (contraction_hierarchy_) {
+        return contraction_hierarchy_->BuildWeightMatrix(*source_ids, *target_ids);
+    }
+    return router_->BuildWeightMatrix(*source_ids, *target_ids);
+}
+
+optional<vector<TransportRouter::ReachableStop>> TransportRouter::GetReachableStops(string_view from, Time max_time,
+                                                                                  SearchStats* stats) const {
+    TC_SCOPED_TIMER("transport_router.reachable_stops");
+    const Stop* from_stop = db_.FindStop(from);
+    if (!from_stop) {
+        return std::nullopt;
+    }
+
+    vector<ReachableStop> result;
+    for (const auto& [vertex, time] : GetRouter().FindReachableVertices(vertices_id_.at(from_stop), max_time, stats)) {
+        // В ride_graph_ кроме остановок есть вершины позиций на маршрутах, их id не меньше количества остановок
+        if (vertex < all_stops_.size()) {
+            result.push_back({&all_stops_[vertex], time});
+        }
+    }
+    return result;
+}
+
+void TransportRouter::AddMemoryUsage(memory::Report& report) const {
+    report.push_back(memory::MakeHashTableUsage("router.vertices_id", vertices_id_));
+    report.push_back(memory::MakeUsage("router.edge_blocks", edge_blocks_));
+    graph_.AddMemoryUsage("router.graph", report);
+    report.push_back(memory::MakeUsage("router.edges_data", edges_data_));
+    {
+        lock_guard lock(router_mutex_);
+        if (router_) {
+            router_->AddMemoryUsage("router.search", report);
+        }
+    }
+    ride_graph_.AddMemoryUsage("router.ride_graph", report);
+    if (contraction_hierarchy_) {
+        contraction_hierarchy_->AddMemoryUsage("router.contraction_hierarchy", report);
+    }
+    if (timetable_) {
+        timetable_->AddMemoryUsage("router.timetable", report);
+    }
+    report.push_back(memory::MakeUsage("router.trip_buses", trip_buses_));
+    report.push_back(memory::MakeUsage("router.position_stops", position_stops_));
+    report.push_back(memory::MakeUsage("router.position_distances", position_distances_));
+    report.push_back(memory::MakeUsage("router.stop_positions_offsets", stop_positions_offsets_));
+    report.push_back(memory::MakeUsage("router.stop_positions", stop_positions_));
+}
+
+optional<vector<VertexId>> TransportRouter::FindVertices(const vector<string_view>& stop_names) const {
+    vector<VertexId> result;
+    result.reserve(stop_names.size());
+    for (string_view name : stop_names) {
+        const Stop* stop = db_.FindStop(name);
+        if (!stop) {
+            return std::nullopt;
+        }
+        result.push_back(vertices_id_.at(stop));
+    }
+    return result;
+}
+
 unordered_map<const Stop*, VertexId> TransportRouter::VerticesIdInitialization() const {
     std::unordered_map<const Stop*, VertexId> result;
     result.reserve(all_stops_.size());
@@ -49,123 +414,437 @@ unordered_map<const Stop*, VertexId> TransportRouter::VerticesIdInitialization()
     return result;
 }
 
-void TransportRouter::GraphInitialization() {
+void TransportRouter::BlocksInitialization() {
     const auto& all_buses = db_.GetAllBuses();
 
-    for (const auto& bus : all_buses) {
-        const vector<const Stop*>& bus_route = bus.stops;
-        
-        AddEdgesInGraph(bus_route, bus);
+    // Маршрут из n остановок дает n * (n - 1) / 2 ребер, поэтому размер каждого блока известен заранее,
+    // и по префиксным суммам каждый блок получает свой отрезок массива ребер
+    auto& blocks = edge_blocks_;
+    blocks.reserve(all_buses.size() * 2);
+    size_t edge_count = 0;
+    size_t ride_vertex_count = all_stops_.size();
+
+    auto add_block = [&blocks, &edge_count, &ride_vertex_count](const Bus& bus, bool is_reversed) {
+        const size_t stop_count = bus.stops.size();
+        blocks.push_back({&bus, is_reversed, edge_count, ride_vertex_count});
+        edge_count += stop_count * (stop_count - min<size_t>(stop_count, 1)) / 2;
+        ride_vertex_count += stop_count;
+    };
 
+    for (const auto& bus : all_buses) {
+        add_block(bus, false);
         if (!bus.is_roundtrip) {
-            AddEdgesInGraph({bus_route.rbegin(), bus_route.rend()}, bus);
+            add_block(bus, true);
         }
     }
 }
 
-void TransportRouter::AddEdgesInGraph(const vector<const Stop*>& stops_on_route, const Bus& bus) {
-    // Вектор префиксных сумм времени, потраченного на путь из начала до конца маршрута
-    vector<Time> travel_times = CreateTravelTimesVector(stops_on_route);
+void TransportRouter::GraphInitialization() {
+    TC_SCOPED_TIMER("transport_router.graph_build");
+    const auto& blocks = edge_blocks_;
+    size_t edge_count = 0;
+    if (!blocks.empty()) {
+        const size_t stop_count = blocks.back().bus->stops.size();
+        edge_count = blocks.back().offset + stop_count * (stop_count - min<size_t>(stop_count, 1)) / 2;
+    }
+
+    // Блоки независимы друг от друга, поэтому заполняются параллельно без блокировок
+    vector<Edge<Time>> edges(edge_count);
+    edges_data_.resize(edge_count);
+    parallel::For(blocks.size(), parallel::GetThreadCount(edge_count, kEdgesPerThread), [this, &blocks, &edges](size_t idx) {
+        const EdgesBlock& block = blocks[idx];
+        FillEdges(block, edges.data() + block.offset, edges_data_.data() + block.offset);
+    });
+
+    graph_ = Graph(all_stops_.size(), move(edges));
+}
+
+void TransportRouter::RideGraphInitialization() {
+    TC_SCOPED_TIMER("transport_router.ride_graph_build");
+    const size_t stop_count = all_stops_.size();
+
+    vector<Edge<Time>> edges;
+    size_t vertex_count = stop_count;
+    for (const EdgesBlock& block : edge_blocks_) {
+        const vector<const Stop*> stops = GetBlockStops(block);
+        const vector<int> distances = GetBlockDistances(block);
+        const double velocity = GetVelocity(*block.bus);
+        vertex_count = block.ride_vertex_offset + stops.size();
+
+        for (size_t i = 0; i < stops.size(); ++i) {
+            const VertexId stop_vertex = vertices_id_.at(stops[i]);
+            const VertexId ride_vertex = block.ride_vertex_offset + i;
+            if (i + 1 < stops.size()) {
+                edges.push_back({stop_vertex, ride_vertex, static_cast<Time>(GetWaitTime(*stops[i]))});
+                edges.push_back({ride_vertex, ride_vertex + 1, CalculateTime(distances[i + 1] - distances[i], velocity)});
+            }
+            if (i > 0) {
+                edges.push_back({ride_vertex, stop_vertex, 0.0});
+            }
+        }
+    }
+
+    ride_graph_ = graph::DirectedWeightedGraph<Time>(vertex_count, move(edges));
+}
+
+void TransportRouter::TimetableInitialization() {
+    TC_SCOPED_TIMER("transport_router.timetable_build");
+    // Время от первой остановки блока до каждой следующей одинаково для всех рейсов, поэтому считается один раз на блок
+    vector<transit::Connection> connections;
+    for (const EdgesBlock& block : edge_blocks_) {
+        const auto& departures = block.bus->departures;
+        const size_t n = block.bus->stops.size();
+        if (departures.empty() || n < 2) {
+            continue;
+        }
+
+        const vector<const Stop*> stops = GetBlockStops(block);
+        const vector<int> distances = GetBlockDistances(block);
+        const double velocity = GetVelocity(*block.bus);
+        vector<Time> offsets(n);
+        for (size_t i = 0; i < n; ++i) {
+            offsets[i] = CalculateTime(distances[i], velocity);
+        }
+
+        connections.reserve(connections.size() + departures.size() * (n - 1));
+        for (const Time start : departures) {
+            const auto trip = static_cast<transit::TripId>(trip_buses_.size());
+            trip_buses_.push_back(block.bus);
+            for (size_t i = 0; i + 1 < n; ++i) {
+                connections.push_back({
+                    .from = static_cast<transit::StopId>(vertices_id_.at(stops[i])),
+                    .to = static_cast<transit::StopId>(vertices_id_.at(stops[i + 1])),
+                    .trip = trip,
+                    .position = static_cast<uint32_t>(i),
+                    .departure = start + offsets[i],
+                    .arrival = start + offsets[i + 1]
+                });
+            }
+        }
+    }
+
+    if (trip_buses_.empty()) {
+        return;
+    }
+    TC_COUNTER_ADD("timetable.connections", connections.size());
+    timetable_.emplace(all_stops_.size(), trip_buses_.size(), move(connections));
+}
+
+void TransportRouter::PositionsInitialization() {
+    TC_SCOPED_TIMER("transport_router.positions_build");
+    const size_t stop_count = all_stops_.size();
+    size_t position_count = 0;
+    if (!edge_blocks_.empty()) {
+        const EdgesBlock& last = edge_blocks_.back();
+        position_count = last.ride_vertex_offset - stop_count + last.bus->stops.size();
+    }
+
+    position_stops_.resize(position_count);
+    position_distances_.resize(position_count);
+    stop_positions_offsets_.assign(stop_count + 1, 0);
+    for (const EdgesBlock& block : edge_blocks_) {
+        const vector<const Stop*> stops = GetBlockStops(block);
+        const vector<int> distances = GetBlockDistances(block);
+        const size_t base = block.ride_vertex_offset - stop_count;
+        for (size_t i = 0; i < stops.size(); ++i) {
+            position_stops_[base + i] = vertices_id_.at(stops[i]);
+            position_distances_[base + i] = distances[i];
+            ++stop_positions_offsets_[position_stops_[base + i] + 1];
+        }
+    }
+
+    // Позиции раскладываются по остановкам подсчетом, как входящие ребра в graph::Router
+    for (size_t stop = 0; stop < stop_count; ++stop) {
+        stop_positions_offsets_[stop + 1] += stop_positions_offsets_[stop];
+    }
+    stop_positions_.resize(position_count);
+    vector<uint32_t> cursors(stop_positions_offsets_.begin(), stop_positions_offsets_.end() - 1);
+    for (size_t block_id = 0; block_id < edge_blocks_.size(); ++block_id) {
+        const EdgesBlock& block = edge_blocks_[block_id];
+        const size_t base = block.ride_vertex_offset - stop_count;
+        for (size_t i = 0; i < block.bus->stops.size(); ++i) {
+            stop_positions_[cursors[position_stops_[base + i]]++] = {static_cast<uint32_t>(block_id), static_cast<uint32_t>(i)};
+        }
+    }
+}
+
+TransportRouter::RoundsWorkspace& TransportRouter::GetRoundsWorkspace() const {
+    thread_local RoundsWorkspace workspace;
+
+    const size_t stop_count = all_stops_.size();
+    const size_t label_count = (kMaxParetoRides + 1) * stop_count;
+    if (workspace.labels.size() != label_count || workspace.block_versions.size() != edge_blocks_.size()
+        || workspace.current_version == numeric_limits<uint32_t>::max()) {
+        workspace.labels.assign(label_count, {});
+        workspace.label_versions.assign(label_count, 0);
+        workspace.best.assign(stop_count, 0.0);
+        workspace.best_versions.assign(stop_count, 0);
+        workspace.block_starts.assign(edge_blocks_.size(), 0);
+        workspace.block_versions.assign(edge_blocks_.size(), 0);
+        workspace.current_version = 0;
+        workspace.block_version = 0;
+    }
+    ++workspace.current_version;
+    return workspace;
+}
+
+const Router<Time>& TransportRouter::GetRouter() const {
+    lock_guard lock(router_mutex_);
+    if (!router_) {
+        // Вершины остановок в ride_graph_ имеют те же id, что и в graph_, поэтому поиск Дейкстры по разреженному
+        // графу находит те же пути, что и по плотному
+        TC_SCOPED_TIMER("transport_router.ride_router_build");
+        router_.emplace(ride_graph_, RouterStrategy::kDijkstra);
+    }
+    return *router_;
+}
+
+vector<const Stop*> TransportRouter::GetBlockStops(const EdgesBlock& block) const {
+    const auto& stops = block.bus->stops;
+    if (block.is_reversed) {
+        return {stops.rbegin(), stops.rend()};
+    }
+    return stops;
+}
+
+vector<int> TransportRouter::GetBlockDistances(const EdgesBlock& block) const {
+    const auto& distances = db_.GetBusDistances(block.bus);
+    if (!block.is_reversed) {
+        return distances.forward_road;
+    }
+
+    // Позиция i обратного направления - остановка n - 1 - i прямого, путь до нее проходит перегоны в обратную сторону
+    const auto& backward = distances.backward_road;
+    const size_t n = backward.size();
+    vector<int> result(n);
+    for (size_t i = 0; i < n; ++i) {
+        result[i] = backward.back() - backward[n - 1 - i];
+    }
+    return result;
+}
+
+void TransportRouter::FillEdges(const EdgesBlock& block, Edge<Time>* out, EdgeData* data_out) const {
+    const vector<const Stop*> stops_on_route = GetBlockStops(block);
+    // Время проезда от i до j считается по разности накопленных расстояний, которая вычисляется в целых числах точно
+    const vector<int> distances = GetBlockDistances(block);
+    const double velocity = GetVelocity(*block.bus);
+
+    vector<VertexId> vertices;
+    vertices.reserve(stops_on_route.size());
+    for (const Stop* stop : stops_on_route) {
+        vertices.push_back(vertices_id_.at(stop));
+    }
 
     // Добавление всех отрезков пути в граф, где всего 1 ожидание и возможность проехать от 1-ой до всех остановок маршрута
     for (int i = 0; i < static_cast<int>(stops_on_route.size()); ++i) {
-        const Stop* from_ptr = stops_on_route[i];
-        VertexId from_id = vertices_id_.at(from_ptr);
-
+        const int wait_time = GetWaitTime(*stops_on_route[i]);
         for (int j = i + 1; j < static_cast<int>(stops_on_route.size()); ++j) {
-            const Stop* to_ptr = stops_on_route[j];
-            VertexId to_id = vertices_id_.at(to_ptr);
-
-            Time time = travel_times[j] - travel_times[i];
-            int span_count = j - i;
-
-            GraphData data {
-                .start_stop = from_ptr,
-                .bus = &bus,
-                .spans_time = time,
-                .wait_time = settings_.wait_time,
-                .span_count = span_count
+            const EdgeData data {
+                .start_stop = stops_on_route[i],
+                .bus = block.bus,
+                .spans_time = CalculateTime(distances[j] - distances[i], velocity),
+                .wait_time = wait_time,
+                .span_count = j - i
             };
-            
-            Edge<GraphData> edge{
-                .from = from_id,
-                .to = to_id,
-                .weight = data
+
+            *out++ = Edge<Time>{
+                .from = vertices[i],
+                .to = vertices[j],
+                .weight = data.spans_time + data.wait_time
             };
-            
-            graph_.AddEdge(edge);
+            *data_out++ = data;
         }
     }
 }
 
+double TransportRouter::CalculateTime(double distance, double velocity) noexcept {
+    // velocity - дистанция в метрах, velocity преобразуется из км/ч в м/мин -> n мин
+    return distance / (velocity * kMetersPerMinuteFactor);
+}
 
-vector<Time> TransportRouter::CreateTravelTimesVector(const vector<const Stop*>& stops_on_route) const {
-    // Префиксные суммы времени, необходимого для проезда по всему маршруту
-    // Дальнейший доступ j - i даст время, необходимое потратить для проезда
-    // из i в j
-    // travel_time[j] - travel_time[i] = время на поездку из bus_route[i] в bus_route[j]
-    vector<Time> travel_time(stops_on_route.size(), 0);
+double TransportRouter::GetVelocity(const Bus& bus) const noexcept {
+    return bus.velocity.value_or(settings_.velocity);
+}
 
-    for (size_t i = 1; i < stops_on_route.size(); ++i) {
-        size_t from_idx = i - 1;
-        size_t to_idx = i;
+int TransportRouter::GetWaitTime(const Stop& stop) const noexcept {
+    return stop.wait_time.value_or(settings_.wait_time);
+}
 
-        const Stop* from_ptr = stops_on_route[from_idx];
-        const Stop* to_ptr = stops_on_route[to_idx];
 
-        double distance = GetDistance(from_ptr, to_ptr);
-        Time time = CalculateTime(distance);
-        travel_time[to_idx] = travel_time[from_idx] + time;
+vector<TransportRouter::RouteLeg> TransportRouter::GetRouteLegs(const RouteInfo& route) const {
+    vector<RouteLeg> result;
+    result.reserve(route.edges.size());
+
+    if (!contraction_hierarchy_) {
+        for (const EdgeId edge_id : route.edges) {
+            // Блок ребра - последний блок, начинающийся не позже ребра. Пустые блоки имеют то же смещение, что и следующий
+            auto block = prev(upper_bound(edge_blocks_.begin(), edge_blocks_.end(), edge_id,
+                                          [](EdgeId edge, const EdgesBlock& item) { return edge < item.offset; }));
+            const size_t n = block->bus->stops.size();
+
+            // Обратное к порядку FillEdges: для позиции i в блоке n - 1 - i ребер
+            size_t local = edge_id - block->offset;
+            size_t i = 0;
+            while (local >= n - 1 - i) {
+                local -= n - 1 - i;
+                ++i;
+            }
+            result.push_back({&*block, i, i + 1 + local});
+        }
+        return result;
     }
 
-    return travel_time;
+    const size_t stop_count = all_stops_.size();
+    VertexId boarding_vertex = 0;
+    for (const EdgeId ride_edge_id : route.edges) {
+        const auto& ride_edge = ride_graph_.GetEdge(ride_edge_id);
+        if (ride_edge.from < stop_count) {
+            boarding_vertex = ride_edge.to;
+            continue;
+        }
+        if (ride_edge.to >= stop_count) {
+            continue;
+        }
+
+        // Высадка: блок определяется по вершине посадки, позиции посадки и высадки - по смещению от начала блока
+        auto block = prev(upper_bound(edge_blocks_.begin(), edge_blocks_.end(), boarding_vertex,
+                                      [](VertexId vertex, const EdgesBlock& item) { return vertex < item.ride_vertex_offset; }));
+        const size_t i = boarding_vertex - block->ride_vertex_offset;
+        const size_t j = ride_edge.from - block->ride_vertex_offset;
+        if (j <= i) {
+            continue;           // Высадка на остановке посадки возможна только при нулевом ожидании и ничего не меняет
+        }
+        result.push_back({&*block, i, j});
+    }
+    return result;
 }
 
-double TransportRouter::CalculateTime(double distance) const noexcept {
-    // velocity - дистанция в метрах, velocity преобразуется из км/ч в м/мин -> n мин
-    return distance / (settings_.velocity * kMetersPerMinuteFactor);
+vector<TransportRouter::Span> TransportRouter::GetRouteSpans(const vector<RouteLeg>& legs) const {
+    vector<Span> result;
+    for (const auto& [block, board, alight] : legs) {
+        const auto& stops = block->bus->stops;
+        const size_t n = stops.size();
+        auto stop_at = [&stops, n, block](size_t position) {
+            return block->is_reversed ? stops[n - 1 - position] : stops[position];
+        };
+        for (size_t k = board; k < alight; ++k) {
+            result.emplace_back(block->bus, stop_at(k), stop_at(k + 1));
+        }
+    }
+    sort(result.begin(), result.end());
+    return result;
 }
 
+Router<Time>::Potential TransportRouter::MakeGeographicPotential() const {
+    // Дорожные расстояния во входных данных бывают короче расстояния по прямой, поэтому расстояние по прямой
+    // умножается на наименьшее отношение дорожного расстояния перегона к географическому, и оценка остается нижней
+    double road_factor = numeric_limits<double>::infinity();
+    auto update_factor = [&road_factor](const Stop* from, const Stop* to, int road_distance) {
+        const double geo_distance = geo::ComputeDistance(from->coordinates, to->coordinates);
+        if (geo_distance > 0.0) {
+            road_factor = min(road_factor, road_distance / geo_distance);
+        }
+    };
 
-int TransportRouter::GetDistance(const Stop* from, const Stop* to) const {
-    auto distance = db_.GetRoadDistance(from->name, to->name);
-    
-    // Если дорожную дистанцию не удалось найти, находим географическую
-    if (!distance.has_value()) { 
-        distance = db_.GetGeographicalDistance(from->name, to->name);
+    double max_velocity = settings_.velocity;
+    for (const auto& bus : db_.GetAllBuses()) {
+        max_velocity = max(max_velocity, GetVelocity(bus));
+        const auto& distances = db_.GetBusDistances(&bus);
+        for (size_t i = 1; i < bus.stops.size(); ++i) {
+            update_factor(bus.stops[i - 1], bus.stops[i], distances.forward_road[i] - distances.forward_road[i - 1]);
+            if (!bus.is_roundtrip) {
+                update_factor(bus.stops[i], bus.stops[i - 1], distances.backward_road[i] - distances.backward_road[i - 1]);
+            }
+        }
+    }
+    if (isinf(road_factor)) {
+        road_factor = 0.0;
     }
 
-    // т.к. работать приходится с существующими остановками, в distance какое то значение точно будет, можно на nullopt не проверять
-    return *distance;
+    // Любой путь между разными остановками начинается с ожидания на первой из них, а проехать быстрее самого быстрого
+    // автобуса нельзя
+    const double minutes_per_meter = road_factor / (max_velocity * kMetersPerMinuteFactor);
+    return [this, minutes_per_meter](VertexId from, VertexId to) -> Time {
+        if (from == to) {
+            return 0.0;
+        }
+        const double geo_distance = geo::ComputeDistance(all_stops_[from].coordinates, all_stops_[to].coordinates);
+        return GetWaitTime(all_stops_[from]) + geo_distance * minutes_per_meter;
+    };
 }
 
-RouteResponse TransportRouter::BuildRouteResponse(const Router<GraphData>::RouteInfo& route) const {
+RouteResponse TransportRouter::BuildRouteResponse(const RouteInfo& route) const {
     vector<RouteItem> items;
-    const auto& edges = route.edges;
-    
-    for (auto edge_id : edges) {
-        const auto& edge = graph_.GetEdge(edge_id);
-        const GraphData& gd = edge.weight;
-
-        Waiting waiting{
-            .stop_name = gd.start_stop->name,
-            .time = static_cast<int>(gd.wait_time)
+    items.reserve(route.edges.size() * 2);
+
+    if (!contraction_hierarchy_) {
+        for (const EdgeId edge_id : route.edges) {
+            const EdgeData& gd = edges_data_[edge_id];
+            items.emplace_back(Waiting{
+                .stop_name = gd.start_stop->name,
+                .time = static_cast<double>(gd.wait_time)
+            });
+            items.emplace_back(Trip{
+                .bus = gd.bus->name,
+                .time = gd.spans_time,
+                .span_count = gd.span_count
+            });
+        }
+        return RouteResponse{
+            .items = std::move(items),
+            .total_time = route.weight
         };
+    }
 
-        items.emplace_back(std::move(waiting));
+    // Поездка по ride_graph_ собирается из посадки, перегонов и высадки, поэтому время считается так же, как вес
+    // ребра плотного графа: по разности накопленных расстояний между позициями посадки и высадки
+    const size_t stop_count = all_stops_.size();
+    Time total_time = 0.0;
+    for (const auto& [block, board, alight] : GetRouteLegs(route)) {
+        const size_t base = block->ride_vertex_offset - stop_count;
+        const Stop& stop = all_stops_[position_stops_[base + board]];
+        const int wait_time = GetWaitTime(stop);
+        const Time spans_time = CalculateTime(position_distances_[base + alight] - position_distances_[base + board],
+                                              GetVelocity(*block->bus));
+        total_time += spans_time + wait_time;
+
+        items.emplace_back(Waiting{
+            .stop_name = stop.name,
+            .time = static_cast<double>(wait_time)
+        });
+        items.emplace_back(Trip{
+            .bus = block->bus->name,
+            .time = spans_time,
+            .span_count = static_cast<int>(alight - board)
+        });
+    }
 
-        Trip trip{
-            .bus = gd.bus->name,
-            .time = gd.spans_time,
-            .span_count = gd.span_count
-        };
+    return RouteResponse{
+        .items = std::move(items),
+        .total_time = total_time
+    };
+}
 
-        items.emplace_back(std::move(trip));
+RouteResponse TransportRouter::BuildRouteResponse(const transit::Journey& journey, Time departure_time) const {
+    vector<RouteItem> items;
+    items.reserve(journey.legs.size() * 2);
+
+    Time current = departure_time;
+    for (const auto& leg : journey.legs) {
+        items.emplace_back(Waiting{
+            .stop_name = all_stops_[leg.from].name,
+            .time = leg.departure - current
+        });
+        items.emplace_back(Trip{
+            .bus = trip_buses_[leg.trip]->name,
+            .time = leg.arrival - leg.departure,
+            .span_count = static_cast<int>(leg.span_count)
+        });
+        current = leg.arrival;
     }
 
-
     return RouteResponse{
         .items = std::move(items),
-        .total_time = route.weight.spans_time +  route.weight.wait_time
+        .total_time = journey.arrival - departure_time
     };
 }
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <deque>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include "domain.h"
+#include "memory_usage.h"
 #include "transport_catalogue.h"
+#include "connection_scan.h"
+#include "contraction_hierarchy.h"
 #include "router.h"
 
 
@@ -19,59 +25,170 @@ using RouteResponse = domain::dto::RouteResponse;
 using RouteItem = domain::dto::RouteItem;
 using Waiting = domain::dto::Waiting;
 using Trip = domain::dto::Trip;
+using ReachableStop = domain::dto::ReachableStop;
+using ParetoRoute = domain::dto::ParetoRoute;
 
 using Time = double;
 
-// Структура для веса граней графа поможет хранить информацию о пройденных остановках и затраченного на это времени
-struct GraphData {
+// Сведения о ребре графа, нужные только для построения ответа. Хранятся в отдельном массиве по id ребра,
+// а вес ребра в графе - просто время, поэтому при поиске пути сравниваются и складываются числа
+struct EdgeData {
     const Stop* start_stop; // Фактически от этих указателей нужна строка, но 16 байт на 2 указателя легче, чем 32 на 2 string_view
     const Bus* bus;
     Time spans_time;
-    int wait_time;          // Из условия задачи "ожидание" - целое число, к тому же int легче double
+    int wait_time;          // Из условия задачи "ожидание" - целое число, к тому же int легче double.
+                            // Ожидание на start_stop с учетом ее переопределения, поэтому отдельно оно не хранится
     int span_count;
-
-
-    constexpr bool operator<(const GraphData& rhs) const noexcept {
-        return (spans_time + wait_time) < (rhs.spans_time + rhs.wait_time);
-    }
-
-    constexpr bool operator>(const GraphData& rhs) const noexcept {
-        return (spans_time + wait_time) > (rhs.spans_time + rhs.wait_time);
-    }
-
-    GraphData operator+(const GraphData& rhs) const noexcept {
-        return {
-            .start_stop = nullptr,                      // В контексте суммирования объектов start_stop и bus
-            .bus = nullptr,                             // не несут никакую смысловую нагрузку и их лучше занулить
-            .spans_time = spans_time + rhs.spans_time,
-            .wait_time = wait_time + rhs.wait_time,
-            .span_count = span_count + rhs.span_count
-        };
-    }
 };
 
-using Graph = graph::DirectedWeightedGraph<GraphData>;
+using Graph = graph::DirectedWeightedGraph<Time>;
+using RouteInfo = graph::Router<Time>::RouteInfo;
 
 public:
-    explicit TransportRouter(TransportCatalogue& db, domain::dto::RoutingSettings settings);
-    std::optional<RouteResponse> GetRoute(std::string_view from, std::string_view to) const;
+    explicit TransportRouter(const TransportCatalogue& db, domain::dto::RoutingSettings settings);
+    // nullopt - одна из остановок не найдена или пути нет.
+    // Если передан `stats`, в него добавляется количество просмотренных поиском вершин
+    std::optional<RouteResponse> GetRoute(std::string_view from, std::string_view to,
+                                          graph::SearchStats* stats = nullptr) const;
+    // Маршруты из `from` в каждую остановку `targets` одним поиском из `from` (для all_pairs - по таблице).
+    // nullopt в ячейке - пути нет, nullopt вместо вектора - одна из остановок не найдена
+    std::optional<std::vector<std::optional<RouteResponse>>> GetRoutesFrom(std::string_view from,
+                                                                           const std::vector<std::string_view>& targets,
+                                                                           graph::SearchStats* stats = nullptr) const;
+    // Маршрут с самым ранним прибытием при отправлении из `from` в `departure_time` минут от начала суток.
+    // Используются только автобусы с расписанием, ожидание - время до отправления рейса. Если расписаний нет
+    // ни у одного автобуса, маршрут строится по статической модели с ожиданием bus_wait_time
+    std::optional<RouteResponse> GetRouteAt(std::string_view from, std::string_view to, Time departure_time,
+                                            graph::SearchStats* stats = nullptr) const;
+    // До `count` заметно различающихся маршрутов по возрастанию времени, первый - кратчайший. Маршрут принимается,
+    // если с каждым уже принятым у него общих не больше kMaxSharedSpans перегонов на тех же автобусах.
+    // nullopt - одна из остановок не найдена, пустой вектор - пути нет
+    std::optional<std::vector<RouteResponse>> GetAlternativeRoutes(std::string_view from, std::string_view to, size_t count,
+                                                                   graph::SearchStats* stats = nullptr) const;
+    // Множество Парето по (времени в пути, количеству пересадок) по возрастанию пересадок: каждый следующий маршрут
+    // строго быстрее предыдущего. Рассматриваются маршруты не больше чем из kMaxParetoRides поездок.
+    // nullopt - одна из остановок не найдена, пустой вектор - пути нет. Если передан `stats`, в него добавляется
+    // количество просмотренных позиций маршрутов
+    std::optional<std::vector<ParetoRoute>> GetParetoRoutes(std::string_view from, std::string_view to,
+                                                            graph::SearchStats* stats = nullptr) const;
+    // Время в пути из каждой остановки `sources` до каждой остановки `targets` без построения маршрутов.
+    // nullopt в ячейке - пути нет, nullopt вместо матрицы - одна из остановок не найдена
+    std::optional<std::vector<std::vector<std::optional<Time>>>> GetTravelTimes(
+            const std::vector<std::string_view>& sources, const std::vector<std::string_view>& targets) const;
+    // Остановки, до которых из `from` можно доехать не дольше чем за `max_time` минут, по возрастанию времени.
+    // nullopt - остановка `from` не найдена
+    std::optional<std::vector<ReachableStop>> GetReachableStops(std::string_view from, Time max_time,
+                                                                graph::SearchStats* stats = nullptr) const;
+    // Добавляет в `report` память графов, таблиц и индексов роутера (имена начинаются с "router.")
+    void AddMemoryUsage(memory::Report& report) const;
 
 private:
+    // Блок ребер - все ребра одного направления одного автобуса
+    struct EdgesBlock {
+        const Bus* bus;
+        bool is_reversed;
+        size_t offset;              // Индекс первого ребра блока в graph_
+        size_t ride_vertex_offset;  // Индекс вершины первой позиции маршрута в ride_graph_
+    };
+
+    // Участок маршрута на одном автобусе: блок и позиции посадки и высадки в нем
+    struct RouteLeg {
+        const EdgesBlock* block;
+        size_t board;
+        size_t alight;
+    };
+
     const TransportCatalogue& db_;
     domain::dto::RoutingSettings settings_;
     const std::deque<Stop>& all_stops_;
     std::unordered_map<const Stop*, graph::VertexId> vertices_id_;
-    graph::DirectedWeightedGraph<GraphData> graph_;
-    std::optional<graph::Router<GraphData>> router_;
+    std::vector<EdgesBlock> edge_blocks_;
+    // Плотный граф и сведения о его ребрах. Для contraction_hierarchy не строятся: поиск и ответы идут по ride_graph_
+    Graph graph_;
+    std::vector<EdgeData> edges_data_;      // Индекс - id ребра в graph_
+    // Для contraction_hierarchy строится над ride_graph_ при первом запросе Isochrone или Alternatives (GetRouter)
+    mutable std::optional<graph::Router<Time>> router_;
+    mutable std::mutex router_mutex_;
+
+    // Разреженный граф для иерархии сжатия. Вершины - остановки и позиции на маршрутах автобусов,
+    // ребра - посадка на автобус (ожидание), перегон между соседними позициями и высадка.
+    // В graph_ каждая пара остановок маршрута соединена ребром, и при сжатии такого графа сокращений слишком много
+    graph::DirectedWeightedGraph<Time> ride_graph_;
+    std::optional<graph::ContractionHierarchy<Time>> contraction_hierarchy_;
+
+    // Перегоны всех рейсов автобусов с расписанием. Остановки пронумерованы так же, как вершины graph_
+    std::optional<transit::ConnectionScan> timetable_;
+    std::vector<const Bus*> trip_buses_;    // Индекс - номер рейса в timetable_
+
+    // Позиции всех блоков подряд для поиска по раундам (GetParetoRoutes), который просматривает маршруты автобусов,
+    // а не ребра graph_. Позиция k блока имеет номер block.ride_vertex_offset - all_stops_.size() + k
+    std::vector<graph::VertexId> position_stops_;
+    std::vector<int> position_distances_;       // Накопленное дорожное расстояние от начала блока
+    // Пары (номер блока, позиция в блоке) для остановки v - stop_positions_[stop_positions_offsets_[v]..[v + 1])
+    std::vector<uint32_t> stop_positions_offsets_;
+    std::vector<std::pair<uint32_t, uint32_t>> stop_positions_;
+
+    // Метка остановки в раунде k поиска по раундам - самое раннее прибытие не больше чем за k поездок.
+    // Последняя поездка задается номерами позиций посадки и высадки, блок восстанавливается по номеру позиции
+    struct RoundLabel {
+        Time arrival;
+        uint32_t board;
+        uint32_t alight;
+    };
+    // Метки всех раундов лежат в одном массиве (раунд * количество остановок + остановка) и переиспользуются между
+    // запросами потока, метки версий заменяют их очистку
+    struct RoundsWorkspace {
+        std::vector<RoundLabel> labels;
+        std::vector<uint32_t> label_versions;
+        std::vector<Time> best;                 // Лучшее прибытие на остановку за все раунды
+        std::vector<uint32_t> best_versions;
+        std::vector<uint32_t> block_starts;     // Первая отмеченная позиция блока в текущем раунде
+        std::vector<uint32_t> block_versions;
+        uint32_t current_version = 0;
+        uint32_t block_version = 0;             // Увеличивается каждый раунд
+    };
 
     static constexpr double kMetersPerMinuteFactor = 1000.0 / 60.0;
+    // Наибольшее количество поездок (пересадок плюс один) в маршрутах множества Парето
+    static constexpr size_t kMaxParetoRides = 10;
+    // Альтернативный маршрут не дольше кратчайшего в kAlternativeStretch раз
+    static constexpr double kAlternativeStretch = 1.5;
+    // Наибольшая доля перегонов альтернативного маршрута, общих с другим принятым маршрутом
+    static constexpr double kMaxSharedSpans = 0.75;
+    // Минимальное количество ребер на поток при параллельном построении графа
+    static constexpr size_t kEdgesPerThread = 1 << 14;
 
 
     std::unordered_map<const Stop*, graph::VertexId> VerticesIdInitialization() const;
+    std::optional<std::vector<graph::VertexId>> FindVertices(const std::vector<std::string_view>& stop_names) const;
+    // Блоки всех автобусов: смещения их ребер в graph_ и позиций в ride_graph_
+    void BlocksInitialization();
     void GraphInitialization();
-    void AddEdgesInGraph(const std::vector<const Stop*>& stops_on_route, const Bus& bus);
-    std::vector<Time> CreateTravelTimesVector(const std::vector<const Stop*>& stops_on_route) const;
-    double CalculateTime(double distance) const noexcept;
-    int GetDistance(const Stop* from, const Stop* to) const;
-    RouteResponse BuildRouteResponse(const graph::Router<GraphData>::RouteInfo& route) const;
+    void RideGraphInitialization();
+    void TimetableInitialization();
+    void PositionsInitialization();
+    RoundsWorkspace& GetRoundsWorkspace() const;
+    // Роутер поиска по графу. Для contraction_hierarchy строится при первом обращении
+    const graph::Router<Time>& GetRouter() const;
+    std::vector<const Stop*> GetBlockStops(const EdgesBlock& block) const;
+    // Накопленные дорожные расстояния в порядке остановок блока: расстояние от i до j - distances[j] - distances[i]
+    std::vector<int> GetBlockDistances(const EdgesBlock& block) const;
+    // Записывает ребра блока в `out`, а сведения о них - в `data_out`. Количество ребер - n * (n - 1) / 2 для n остановок
+    void FillEdges(const EdgesBlock& block, graph::Edge<Time>* out, EdgeData* data_out) const;
+    // Время проезда `distance` метров со скоростью `velocity` км/ч
+    static double CalculateTime(double distance, double velocity) noexcept;
+    // Скорость автобуса и ожидание на остановке с учетом переопределений из base_requests
+    double GetVelocity(const Bus& bus) const noexcept;
+    int GetWaitTime(const Stop& stop) const noexcept;
+    graph::Router<Time>::Potential MakeGeographicPotential() const;
+    // Участки пути по ребрам graph_ или, для contraction_hierarchy, по ребрам ride_graph_
+    std::vector<RouteLeg> GetRouteLegs(const RouteInfo& route) const;
+    // Перегон - автобус и пара соседних остановок в направлении движения. Маршрут может проходить одну остановку
+    // несколько раз, поэтому перегоны сравниваются по остановкам, а не по позициям в маршруте
+    using Span = std::tuple<const Bus*, const Stop*, const Stop*>;
+    // Перегоны маршрута по возрастанию (с повторами)
+    std::vector<Span> GetRouteSpans(const std::vector<RouteLeg>& legs) const;
+    // Путь по ребрам graph_ или, для contraction_hierarchy, по ребрам ride_graph_
+    RouteResponse BuildRouteResponse(const RouteInfo& route) const;
+    RouteResponse BuildRouteResponse(const transit::Journey& journey, Time departure_time) const;
 };
\ No newline at end of file